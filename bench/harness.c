@@ -0,0 +1,423 @@
+#define _GNU_SOURCE
+
+#include "harness.h"
+
+#include <linux/perf_event.h>
+
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * @brief Read the monotonic clock in nanoseconds.
+ */
+uint64_t bench_now(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((uint64_t)now.tv_sec * 1000000000UL) + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * @brief Read the resident set size of this process in bytes.
+ */
+size_t bench_rss(void)
+{
+  unsigned long size = 0;
+  unsigned long resident = 0;
+  FILE *fp = NULL;
+
+  if (NULL == (fp = fopen("/proc/self/statm", "r")))
+  {
+    return 0;
+  }
+
+  if (2 != fscanf(fp, "%lu %lu", &size, &resident))
+  {
+    resident = 0;
+  }
+
+  fclose(fp);
+  return resident * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+/**
+ * @brief Parse a comma separated list of unsigned integers. Sizes may carry
+ *        a K, M or G suffix.
+ * @return The number of values parsed, at most max.
+ */
+size_t bench_parse_list(const char *arg, size_t *values, const size_t max)
+{
+  size_t n = 0;
+  char *end = NULL;
+
+  while (arg != NULL && *arg != '\0' && n < max)
+  {
+    size_t value = strtoul(arg, &end, 0);
+
+    switch (toupper((unsigned char)*end))
+    {
+      case 'G': value <<= 10; /* fall through */
+      case 'M': value <<= 10; /* fall through */
+      case 'K': value <<= 10; end++; break;
+      default: break;
+    }
+
+    if (end == arg)
+    {
+      fprintf(stderr, "%s(): %s: %s\n", __func__, "not a number", arg);
+      exit(EXIT_FAILURE);
+    }
+
+    values[n++] = value;
+    arg = (*end == ',') ? (end + 1) : end;
+  }
+
+  return n;
+}
+
+/**
+ * @brief Determine whether name is one of the entries of a comma separated
+ *        list. A NULL list selects everything.
+ */
+bool bench_selected(const char *list, const char *name)
+{
+  const size_t len = strlen(name);
+
+  if (list == NULL)
+  {
+    return true;
+  }
+
+  while (list != NULL)
+  {
+    const char *end = strchr(list, ',');
+    const size_t n = (end != NULL) ? (size_t)(end - list) : strlen(list);
+
+    if (n == len && 0 == strncmp(list, name, len))
+    {
+      return true;
+    }
+
+    list = (end != NULL) ? (end + 1) : NULL;
+  }
+
+  return false;
+}
+
+/**
+ * @brief Pin the calling thread to one CPU.
+ * @return Whether or not the thread was pinned.
+ */
+bool bench_pin(const int cpu)
+{
+  cpu_set_t set;
+
+  if (cpu < 0)
+  {
+    return false;
+  }
+
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+
+  return 0 == pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+/**
+ * @brief Summarize a series of trial results.
+ */
+struct bench_stats bench_summarize(const double *samples, const size_t n)
+{
+  struct bench_stats stats = { 0 };
+  size_t i;
+
+  if (n == 0)
+  {
+    return stats;
+  }
+
+  stats.min = samples[0];
+  stats.max = samples[0];
+
+  for (i = 0; i < n; i++)
+  {
+    stats.mean += samples[i];
+    stats.min = (samples[i] < stats.min) ? samples[i] : stats.min;
+    stats.max = (samples[i] > stats.max) ? samples[i] : stats.max;
+  }
+  stats.mean /= (double)n;
+
+  for (i = 0; i < n; i++)
+  {
+    stats.stddev += (samples[i] - stats.mean) * (samples[i] - stats.mean);
+  }
+  stats.stddev = (n > 1) ? sqrt(stats.stddev / (double)(n - 1)) : 0.0;
+
+  return stats;
+}
+
+static void bench_print_value(FILE *fp, const enum bench_format format, const struct bench_field *field)
+{
+  switch (field->type)
+  {
+    case BENCH_INT:
+      fprintf(fp, "%" PRIu64, field->value.i);
+      break;
+    case BENCH_REAL:
+      fprintf(fp, "%.2f", field->value.r);
+      break;
+    case BENCH_STR:
+      fprintf(fp, (format == BENCH_JSON) ? "\"%s\"" : "%s", field->value.s);
+      break;
+  }
+}
+
+static bool bench_first_row = true;
+
+void bench_report_begin(FILE *fp, const enum bench_format format, const struct bench_field *fields, const size_t n)
+{
+  size_t i;
+
+  bench_first_row = true;
+
+  if (format == BENCH_JSON)
+  {
+    fprintf(fp, "[\n");
+    return;
+  }
+
+  for (i = 0; i < n; i++)
+  {
+    fprintf(fp, "%s%s", (i == 0) ? "" : ",", fields[i].name);
+  }
+  fprintf(fp, "\n");
+}
+
+void bench_report_row(FILE *fp, const enum bench_format format, const struct bench_field *fields, const size_t n)
+{
+  size_t i;
+
+  if (format == BENCH_JSON)
+  {
+    fprintf(fp, "%s  {", (true == bench_first_row) ? "" : ",\n");
+
+    for (i = 0; i < n; i++)
+    {
+      fprintf(fp, "%s\"%s\": ", (i == 0) ? "" : ", ", fields[i].name);
+      bench_print_value(fp, format, &fields[i]);
+    }
+
+    fprintf(fp, "}");
+  }
+  else
+  {
+    for (i = 0; i < n; i++)
+    {
+      fprintf(fp, "%s", (i == 0) ? "" : ",");
+      bench_print_value(fp, format, &fields[i]);
+    }
+
+    fprintf(fp, "\n");
+  }
+
+  bench_first_row = false;
+  fflush(fp);
+}
+
+void bench_report_end(FILE *fp, const enum bench_format format)
+{
+  if (format == BENCH_JSON)
+  {
+    fprintf(fp, "%s]\n", (true == bench_first_row) ? "" : "\n");
+  }
+}
+
+void bench_gate_init(struct bench_gate *self, const size_t parties)
+{
+  pthread_mutex_init(&self->lock, NULL);
+  pthread_cond_init(&self->cond, NULL);
+  self->waiting = 0;
+  self->parties = parties;
+  self->start = 0;
+}
+
+/**
+ * @brief Block until every party has arrived. The last party to arrive
+ *        records the start time of the trial.
+ */
+void bench_gate_wait(struct bench_gate *self)
+{
+  pthread_mutex_lock(&self->lock);
+
+  if (++self->waiting == self->parties)
+  {
+    self->start = bench_now();
+    pthread_cond_broadcast(&self->cond);
+  }
+  else
+  {
+    while (self->waiting < self->parties)
+    {
+      pthread_cond_wait(&self->cond, &self->lock);
+    }
+  }
+
+  pthread_mutex_unlock(&self->lock);
+}
+
+void bench_gate_fini(struct bench_gate *self)
+{
+  pthread_cond_destroy(&self->cond);
+  pthread_mutex_destroy(&self->lock);
+}
+
+/**
+ * @brief Return the report column name of a counter.
+ */
+const char *bench_counter_name(const enum bench_counter counter)
+{
+  static const char *names[BENCH_COUNTERS] = {
+    [BENCH_CYCLES]           = "cycles",
+    [BENCH_INSTRUCTIONS]     = "instructions",
+    [BENCH_BRANCH_MISSES]    = "branch_misses",
+    [BENCH_L1D_MISSES]       = "l1d_misses",
+    [BENCH_LLC_MISSES]       = "llc_misses",
+    [BENCH_CONTEXT_SWITCHES] = "context_switches",
+  };
+
+  if (counter >= BENCH_COUNTERS)
+  {
+    return "unknown";
+  }
+
+  return names[counter];
+}
+
+static int bench_counter_open(const uint32_t type, const uint64_t config)
+{
+  struct perf_event_attr attr;
+  int fd;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.inherit = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+
+  if (fd < 0 && (errno == EACCES || errno == EPERM))
+  {
+    attr.exclude_kernel = 1;
+    fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+
+  return fd;
+}
+
+/**
+ * @brief Open the counters, stopped and zeroed. Kernel events are counted
+ *        when perf_event_paranoid allows, otherwise user space only.
+ * @return Whether or not any counter could be opened.
+ */
+bool bench_counters_open(struct bench_counters *self)
+{
+  static const struct { uint32_t type; uint64_t config; } events[BENCH_COUNTERS] = {
+    [BENCH_CYCLES]           = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    [BENCH_INSTRUCTIONS]     = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    [BENCH_BRANCH_MISSES]    = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    [BENCH_L1D_MISSES]       = { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    [BENCH_LLC_MISSES]       = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    [BENCH_CONTEXT_SWITCHES] = { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+  };
+
+  bool opened = false;
+  int i;
+
+  for (i = 0; i < BENCH_COUNTERS; i++)
+  {
+    self->fd[i] = bench_counter_open(events[i].type, events[i].config);
+    self->value[i] = 0;
+    opened = opened || (self->fd[i] >= 0);
+  }
+
+  return opened;
+}
+
+/**
+ * @brief Zero and start the counters. The ioctls reach the counters of
+ *        threads that inherited them as well.
+ */
+void bench_counters_start(struct bench_counters *self)
+{
+  int i;
+
+  for (i = 0; i < BENCH_COUNTERS; i++)
+  {
+    self->value[i] = 0;
+
+    if (self->fd[i] >= 0)
+    {
+      ioctl(self->fd[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(self->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+}
+
+/**
+ * @brief Stop and read the counters. Counts of threads that have exited
+ *        are already folded into the counters read here, so join the
+ *        threads of a run first.
+ */
+void bench_counters_stop(struct bench_counters *self)
+{
+  uint64_t buffer[3];
+  int i;
+
+  for (i = 0; i < BENCH_COUNTERS; i++)
+  {
+    if (self->fd[i] < 0)
+    {
+      continue;
+    }
+
+    ioctl(self->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+
+    if (sizeof(buffer) != read(self->fd[i], buffer, sizeof(buffer)) || buffer[2] == 0)
+    {
+      continue;
+    }
+
+    // buffer holds the count, the time enabled and the time running.
+    self->value[i] = (buffer[2] < buffer[1]) ? (uint64_t)((double)buffer[0] * ((double)buffer[1] / (double)buffer[2])) : buffer[0];
+  }
+}
+
+void bench_counters_close(struct bench_counters *self)
+{
+  int i;
+
+  for (i = 0; i < BENCH_COUNTERS; i++)
+  {
+    if (self->fd[i] >= 0)
+    {
+      close(self->fd[i]);
+      self->fd[i] = -1;
+    }
+  }
+}
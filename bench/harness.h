@@ -0,0 +1,157 @@
+#ifndef TURNPIKE__BENCH_HARNESS_H
+#define TURNPIKE__BENCH_HARNESS_H
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * @brief The output formats of a benchmark report.
+ */
+enum bench_format
+{
+  BENCH_CSV,
+  BENCH_JSON,
+};
+
+/**
+ * @brief The summary of a series of trials of one benchmark configuration.
+ */
+struct bench_stats
+{
+  double mean;
+  double stddev;
+  double min;
+  double max;
+};
+
+/**
+ * @brief One column of a benchmark report row. A column holds either an
+ *        integer, a floating point number or a string.
+ */
+struct bench_field
+{
+  const char *name;
+  enum { BENCH_INT, BENCH_REAL, BENCH_STR } type;
+  union
+  {
+    uint64_t i;
+    double r;
+    const char *s;
+  } value;
+};
+
+#define BENCH_FIELD_INT(n, v)  ((struct bench_field){ .name = (n), .type = BENCH_INT,  .value.i = (uint64_t)(v) })
+#define BENCH_FIELD_REAL(n, v) ((struct bench_field){ .name = (n), .type = BENCH_REAL, .value.r = (double)(v) })
+#define BENCH_FIELD_STR(n, v)  ((struct bench_field){ .name = (n), .type = BENCH_STR,  .value.s = (v) })
+
+/**
+ * @brief Read the monotonic clock in nanoseconds.
+ */
+uint64_t bench_now(void);
+
+/**
+ * @brief Read the resident set size of this process in bytes.
+ */
+size_t bench_rss(void);
+
+/**
+ * @brief Parse a comma separated list of unsigned integers. Sizes may carry
+ *        a K, M or G suffix.
+ * @return The number of values parsed, at most max.
+ */
+size_t bench_parse_list(const char *arg, size_t *values, const size_t max);
+
+/**
+ * @brief Determine whether name is one of the entries of a comma separated
+ *        list, compared whole. A NULL list selects everything.
+ */
+bool bench_selected(const char *list, const char *name);
+
+/**
+ * @brief Pin the calling thread to one CPU.
+ * @return Whether or not the thread was pinned.
+ */
+bool bench_pin(const int cpu);
+
+/**
+ * @brief Summarize a series of trial results.
+ */
+struct bench_stats bench_summarize(const double *samples, const size_t n);
+
+/**
+ * @brief Print the report header, one row per configuration and the report
+ *        footer in the chosen format.
+ */
+void bench_report_begin(FILE *fp, const enum bench_format format, const struct bench_field *fields, const size_t n);
+void bench_report_row(FILE *fp, const enum bench_format format, const struct bench_field *fields, const size_t n);
+void bench_report_end(FILE *fp, const enum bench_format format);
+
+/**
+ * @brief The hardware and software events counted around a run when the
+ *        benchmark is started in counter mode.
+ */
+enum bench_counter
+{
+  BENCH_CYCLES,
+  BENCH_INSTRUCTIONS,
+  BENCH_BRANCH_MISSES,
+  BENCH_L1D_MISSES,
+  BENCH_LLC_MISSES,
+  BENCH_CONTEXT_SWITCHES,
+  BENCH_COUNTERS,
+};
+
+/**
+ * @brief A set of perf_event_open() counters. The counters follow the
+ *        calling thread and every thread it creates after they are opened.
+ *        A counter the kernel refused to open has a descriptor of -1 and
+ *        always reads as zero.
+ */
+struct bench_counters
+{
+  int fd[BENCH_COUNTERS];
+  uint64_t value[BENCH_COUNTERS];
+};
+
+/**
+ * @brief Return the report column name of a counter.
+ */
+const char *bench_counter_name(const enum bench_counter counter);
+
+/**
+ * @brief Open the counters, stopped and zeroed. Kernel events are counted
+ *        when perf_event_paranoid allows, otherwise user space only.
+ * @return Whether or not any counter could be opened.
+ */
+bool bench_counters_open(struct bench_counters *self);
+
+/**
+ * @brief Zero and start, or stop and read, the counters. The values read
+ *        are scaled up when the kernel had to multiplex the counters.
+ */
+void bench_counters_start(struct bench_counters *self);
+void bench_counters_stop(struct bench_counters *self);
+
+void bench_counters_close(struct bench_counters *self);
+
+/**
+ * @brief A barrier that releases every thread of a trial at once so that
+ *        thread start-up is not measured.
+ */
+struct bench_gate
+{
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  size_t waiting;
+  size_t parties;
+  uint64_t start;
+};
+
+void bench_gate_init(struct bench_gate *self, const size_t parties);
+void bench_gate_wait(struct bench_gate *self);
+void bench_gate_fini(struct bench_gate *self);
+
+#endif/*TURNPIKE__BENCH_HARNESS_H*/
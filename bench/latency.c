@@ -0,0 +1,494 @@
+/**
+ * @brief Core-to-core round-trip latency benchmark for the turnpike queues.
+ *
+ *        Two threads, each pinned to a chosen CPU, bounce items through a
+ *        pair of queues: the initiator sends on the first queue and the
+ *        echo thread returns every item on the second. The round trip is
+ *        timed with the TSC on x86-64 (calibrated against the monotonic
+ *        clock) or with clock_gettime() elsewhere or on request, and the
+ *        one-way handoff latency is reported as half of it.
+ *
+ *        In the default closed-loop mode the initiator sends the next item
+ *        only once the previous one came back. In open-loop mode (-r) items
+ *        are sent on a fixed schedule regardless of replies and latency is
+ *        measured from the time an item was scheduled to be sent, not from
+ *        when it actually was, so a stall is charged to every item it
+ *        delayed instead of being hidden by coordinated omission.
+ */
+#include "bipartite.h"
+#include "histogram.h"
+#include "spsc.h"
+
+#include "harness.h"
+
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_TSC
+#endif
+
+#define BENCH_MAX_LIST 32
+
+/**
+ * @brief A uniform view of one queue used as a one-way channel.
+ */
+struct bench_channel
+{
+  const char *name;
+  void *(*create)(const size_t cap, const size_t len);
+  bool (*send)(void *queue, const void *item);
+  bool (*recv)(void *queue, void *item, const size_t len);
+  void (*destroy)(void *queue);
+};
+
+static void *bipartite_create(const size_t cap, const size_t len) { return bipartite_queue_new(cap, len); }
+static bool bipartite_send(void *queue, const void *item) { return bipartite_queue_enqueue(queue, item); }
+static void bipartite_drop(void *queue) { bipartite_queue_t *q = queue; bipartite_queue_destroy(q); }
+
+static bool bipartite_recv(void *queue, void *item, const size_t len)
+{
+  void *data = bipartite_queue_dequeue(queue);
+
+  if (data == NULL)
+  {
+    return false;
+  }
+
+  memcpy(item, data, len);
+  free(data);
+  return true;
+}
+
+static void *spsc_create(const size_t cap, const size_t len) { return spsc_queue_new(cap, len); }
+static bool spsc_send(void *queue, const void *item) { return spsc_queue_enqueue(queue, item); }
+static bool spsc_recv(void *queue, void *item, const size_t len) { return spsc_queue_pop(queue, item); }
+static void spsc_drop(void *queue) { spsc_queue_t *q = queue; spsc_queue_destroy(q); }
+
+static const struct bench_channel channels[] = {
+  { "bipartite", bipartite_create, bipartite_send, bipartite_recv, bipartite_drop },
+  { "spsc",      spsc_create,      spsc_send,      spsc_recv,      spsc_drop      },
+};
+
+#define NCHANNELS (sizeof(channels) / sizeof(channels[0]))
+
+/**
+ * @brief The clock the round trips are timed with. Ticks are converted to
+ *        nanoseconds only when a latency is recorded.
+ */
+static bool use_tsc = false;
+static double ns_per_tick = 1.0;
+
+static inline uint64_t ticks(void)
+{
+#ifdef BENCH_HAVE_TSC
+  if (true == use_tsc)
+  {
+    return __rdtsc();
+  }
+#endif/*BENCH_HAVE_TSC*/
+  return bench_now();
+}
+
+static inline uint64_t ticks_to_ns(const uint64_t t)
+{
+  return (uint64_t)((double)t * ns_per_tick);
+}
+
+/**
+ * @brief Measure the TSC frequency against the monotonic clock.
+ */
+static void calibrate(void)
+{
+#ifdef BENCH_HAVE_TSC
+  if (true == use_tsc)
+  {
+    const uint64_t n0 = bench_now();
+    const uint64_t t0 = __rdtsc();
+
+    while ((bench_now() - n0) < 100000000UL);
+
+    const uint64_t n1 = bench_now();
+    const uint64_t t1 = __rdtsc();
+
+    ns_per_tick = (double)(n1 - n0) / (double)(t1 - t0);
+  }
+#endif/*BENCH_HAVE_TSC*/
+}
+
+/**
+ * @brief Busy-wait politely. Yielding now and then keeps the benchmark
+ *        usable when both threads share a CPU.
+ */
+static inline void relax(size_t *spins)
+{
+  if ((++(*spins) & 1023) == 0)
+  {
+    sched_yield();
+  }
+#ifdef BENCH_HAVE_TSC
+  else
+  {
+    _mm_pause();
+  }
+#endif/*BENCH_HAVE_TSC*/
+}
+
+/**
+ * @brief The state shared by the two threads of one run.
+ */
+struct run
+{
+  const struct bench_channel *ops;
+  void *ping;
+  void *pong;
+  size_t len;
+  size_t total;
+  int echo_cpu;
+  struct bench_gate gate;
+};
+
+/**
+ * @brief Return every item received on the ping queue on the pong queue.
+ *        The first word of an item is the time it was stamped with and is
+ *        passed back untouched.
+ */
+static void *echo(void *arg)
+{
+  struct run *run = arg;
+  uint8_t *item = calloc(1, run->len);
+  size_t spins = 0;
+  size_t i;
+
+  if (run->echo_cpu >= 0)
+  {
+    bench_pin(run->echo_cpu);
+  }
+
+  bench_gate_wait(&run->gate);
+
+  for (i = 0; i < run->total; i++)
+  {
+    while (false == run->ops->recv(run->ping, item, run->len))
+    {
+      relax(&spins);
+    }
+
+    while (false == run->ops->send(run->pong, item))
+    {
+      relax(&spins);
+    }
+  }
+
+  free(item);
+  return NULL;
+}
+
+/**
+ * @brief Send one item at a time and wait for it to come back.
+ */
+static void closed_loop(struct run *run, struct histogram *histogram, const size_t warmup)
+{
+  uint8_t *item = calloc(1, run->len);
+  size_t spins = 0;
+  size_t i;
+
+  for (i = 0; i < run->total; i++)
+  {
+    const uint64_t sent = ticks();
+    memcpy(item, &sent, sizeof(sent));
+
+    while (false == run->ops->send(run->ping, item))
+    {
+      relax(&spins);
+    }
+
+    while (false == run->ops->recv(run->pong, item, run->len))
+    {
+      relax(&spins);
+    }
+
+    const uint64_t now = ticks();
+
+    if (i >= warmup)
+    {
+      histogram_record(histogram, ticks_to_ns(now - sent) / 2);
+    }
+  }
+
+  free(item);
+}
+
+/**
+ * @brief Send items on a fixed schedule of one per interval and collect
+ *        replies as they arrive. Every item carries the time it was due to
+ *        be sent, so an item held back by a full queue or a stalled echo
+ *        is charged the whole delay.
+ */
+static void open_loop(struct run *run, struct histogram *histogram, const size_t warmup, const uint64_t interval)
+{
+  uint8_t *item = calloc(1, run->len);
+  size_t sent = 0;
+  size_t received = 0;
+  size_t spins = 0;
+  uint64_t due = ticks();
+
+  while (received < run->total)
+  {
+    const uint64_t now = ticks();
+
+    if (sent < run->total && now >= due)
+    {
+      memcpy(item, &due, sizeof(due));
+
+      if (true == run->ops->send(run->ping, item))
+      {
+        due += interval;
+        sent++;
+      }
+    }
+
+    if (true == run->ops->recv(run->pong, item, run->len))
+    {
+      uint64_t intended;
+      memcpy(&intended, item, sizeof(intended));
+
+      if (received >= warmup)
+      {
+        histogram_record(histogram, ticks_to_ns(ticks() - intended) / 2);
+      }
+
+      received++;
+      continue;
+    }
+
+    relax(&spins);
+  }
+
+  free(item);
+}
+
+static void usage(const char *prog)
+{
+  fprintf(stderr,
+    "usage: %s [options]\n"
+    "  -q LIST   structures: bipartite,spsc (default all)\n"
+    "  -a A,B    CPUs of the initiator and the echo thread (default 0,1)\n"
+    "  -s N      item size in bytes, at least 8 (default 64)\n"
+    "  -k N      capacity of each queue in bytes (default 64K)\n"
+    "  -n N      measured round trips (default 1000000)\n"
+    "  -w N      warmup round trips (default 10000)\n"
+    "  -r N      open-loop mode at N round trips per second (default closed loop)\n"
+    "  -T CLOCK  tsc or clock (default tsc where available)\n"
+    "  -D        print the full percentile distribution instead of a summary\n"
+    "  -f FMT    output format: csv or json (default csv)\n",
+    prog);
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+  size_t cpus[BENCH_MAX_LIST] = { 0, 1 };
+  size_t ncpus = 2;
+  size_t len = 64;
+  size_t cap = 64 * 1024;
+  size_t items = 1000000;
+  size_t warmup = 10000;
+  size_t rate = 0;
+  bool distribution = false;
+  enum bench_format format = BENCH_CSV;
+  const char *selected = NULL;
+  int opt;
+
+#ifdef BENCH_HAVE_TSC
+  use_tsc = true;
+#endif/*BENCH_HAVE_TSC*/
+
+  while (-1 != (opt = getopt(argc, argv, "q:a:s:k:n:w:r:T:Df:h")))
+  {
+    switch (opt)
+    {
+      case 'q': selected = optarg; break;
+      case 'a': ncpus = bench_parse_list(optarg, cpus, BENCH_MAX_LIST); break;
+      case 's': bench_parse_list(optarg, &len, 1); break;
+      case 'k': bench_parse_list(optarg, &cap, 1); break;
+      case 'n': bench_parse_list(optarg, &items, 1); break;
+      case 'w': bench_parse_list(optarg, &warmup, 1); break;
+      case 'r': bench_parse_list(optarg, &rate, 1); break;
+      case 'D': distribution = true; break;
+      case 'T':
+        if (0 == strcmp(optarg, "clock")) { use_tsc = false; }
+        else if (0 != strcmp(optarg, "tsc")) { usage(argv[0]); }
+        break;
+      case 'f':
+        if (0 == strcmp(optarg, "json")) { format = BENCH_JSON; }
+        else if (0 == strcmp(optarg, "csv")) { format = BENCH_CSV; }
+        else { usage(argv[0]); }
+        break;
+      default: usage(argv[0]);
+    }
+  }
+
+  if (len < sizeof(uint64_t) || cap < len || items == 0)
+  {
+    usage(argv[0]);
+  }
+
+  calibrate();
+
+  const int initiator_cpu = (ncpus > 0) ? (int)cpus[0] : -1;
+  const int echo_cpu = (ncpus > 1) ? (int)cpus[1] : -1;
+  const char *mode = (rate == 0) ? "closed" : "open";
+
+  const struct bench_field summary[] = {
+    BENCH_FIELD_STR("queue", ""),
+    BENCH_FIELD_STR("mode", ""),
+    BENCH_FIELD_INT("item_size", 0),
+    BENCH_FIELD_INT("rate", 0),
+    BENCH_FIELD_INT("count", 0),
+    BENCH_FIELD_INT("p50_ns", 0),
+    BENCH_FIELD_INT("p90_ns", 0),
+    BENCH_FIELD_INT("p99_ns", 0),
+    BENCH_FIELD_INT("p999_ns", 0),
+    BENCH_FIELD_INT("p9999_ns", 0),
+    BENCH_FIELD_INT("max_ns", 0),
+  };
+
+  const struct bench_field spectrum[] = {
+    BENCH_FIELD_STR("queue", ""),
+    BENCH_FIELD_STR("mode", ""),
+    BENCH_FIELD_REAL("quantile", 0),
+    BENCH_FIELD_INT("one_in", 0),
+    BENCH_FIELD_INT("latency_ns", 0),
+  };
+
+  if (true == distribution)
+  {
+    bench_report_begin(stdout, format, spectrum, sizeof(spectrum) / sizeof(spectrum[0]));
+  }
+  else
+  {
+    bench_report_begin(stdout, format, summary, sizeof(summary) / sizeof(summary[0]));
+  }
+
+  size_t q;
+
+  for (q = 0; q < NCHANNELS; q++)
+  {
+    const struct bench_channel *ops = &channels[q];
+
+    if (false == bench_selected(selected, ops->name))
+    {
+      continue;
+    }
+
+    struct run run = {
+      .ops = ops,
+      .ping = ops->create(cap, len),
+      .pong = ops->create(cap, len),
+      .len = len,
+      .total = warmup + items,
+      .echo_cpu = echo_cpu,
+    };
+
+    struct histogram *histogram = histogram_new();
+    pthread_t thread;
+
+    bench_gate_init(&run.gate, 2);
+
+    if (pthread_create(&thread, NULL, echo, &run) != 0)
+    {
+      fprintf(stderr, "%s(): %s\n", __func__, "could not create thread");
+      exit(EXIT_FAILURE);
+    }
+
+    if (initiator_cpu >= 0)
+    {
+      bench_pin(initiator_cpu);
+    }
+
+    bench_gate_wait(&run.gate);
+
+    if (rate == 0)
+    {
+      closed_loop(&run, histogram, warmup);
+    }
+    else
+    {
+      const uint64_t interval = (uint64_t)((1e9 / (double)rate) / ns_per_tick);
+      open_loop(&run, histogram, warmup, (interval != 0) ? interval : 1);
+    }
+
+    pthread_join(thread, NULL);
+    bench_gate_fini(&run.gate);
+
+    latency_snapshot_t snapshot;
+    histogram_latency(histogram, &snapshot);
+
+    if (true == distribution)
+    {
+      // Halve the distance to 100% at every step, as HdrHistogram does, so
+      // that the tail is resolved as finely as the body.
+      double remaining = 1.0;
+
+      while (remaining > (1.0 / (double)items))
+      {
+        const double quantile = 1.0 - remaining;
+
+        const struct bench_field row[] = {
+          BENCH_FIELD_STR("queue", ops->name),
+          BENCH_FIELD_STR("mode", mode),
+          BENCH_FIELD_REAL("quantile", quantile),
+          BENCH_FIELD_INT("one_in", 1.0 / remaining),
+          BENCH_FIELD_INT("latency_ns", histogram_percentile(histogram, quantile)),
+        };
+
+        bench_report_row(stdout, format, row, sizeof(row) / sizeof(row[0]));
+        remaining /= 2.0;
+      }
+
+      const struct bench_field last[] = {
+        BENCH_FIELD_STR("queue", ops->name),
+        BENCH_FIELD_STR("mode", mode),
+        BENCH_FIELD_REAL("quantile", 1.0),
+        BENCH_FIELD_INT("one_in", snapshot.count),
+        BENCH_FIELD_INT("latency_ns", snapshot.max),
+      };
+
+      bench_report_row(stdout, format, last, sizeof(last) / sizeof(last[0]));
+    }
+    else
+    {
+      const struct bench_field row[] = {
+        BENCH_FIELD_STR("queue", ops->name),
+        BENCH_FIELD_STR("mode", mode),
+        BENCH_FIELD_INT("item_size", len),
+        BENCH_FIELD_INT("rate", rate),
+        BENCH_FIELD_INT("count", snapshot.count),
+        BENCH_FIELD_INT("p50_ns", snapshot.p50),
+        BENCH_FIELD_INT("p90_ns", histogram_percentile(histogram, 0.90)),
+        BENCH_FIELD_INT("p99_ns", snapshot.p99),
+        BENCH_FIELD_INT("p999_ns", snapshot.p999),
+        BENCH_FIELD_INT("p9999_ns", histogram_percentile(histogram, 0.9999)),
+        BENCH_FIELD_INT("max_ns", snapshot.max),
+      };
+
+      bench_report_row(stdout, format, row, sizeof(row) / sizeof(row[0]));
+    }
+
+    histogram_destroy(histogram);
+    ops->destroy(run.ping);
+    ops->destroy(run.pong);
+  }
+
+  bench_report_end(stdout, format);
+  return EXIT_SUCCESS;
+}
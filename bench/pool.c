@@ -0,0 +1,235 @@
+/**
+ * @brief Scheduling benchmark for the turnpike worker pools.
+ *
+ *        Runs a fork-join workload on a work-stealing pool and on a pool
+ *        whose workers share one bipartite queue, across thread counts.
+ *        Every task of the tree submits its two children until the leaves,
+ *        which spin for a configurable number of iterations; the finer the
+ *        leaves, the more the cost of handing tasks out dominates.
+ *
+ *        With -F the tasks are instead all submitted from the main thread
+ *        as one flat batch, which measures the injector rather than the
+ *        deques.
+ */
+#include "pool.h"
+
+#include "harness.h"
+
+#include <getopt.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_MAX_LIST 32
+
+static const struct
+{
+  const char *name;
+  enum pool_kind kind;
+} pools[] = {
+  { "stealing", POOL_STEALING },
+  { "shared",   POOL_SHARED   },
+};
+
+#define NPOOLS (sizeof(pools) / sizeof(pools[0]))
+
+static pool_t *current;
+static size_t spin;
+static atomic_ulong leaves;
+
+static void leaf(void *arg)
+{
+  volatile size_t i;
+
+  for (i = 0; i < spin; i++)
+  {
+  }
+
+  atomic_fetch_add_explicit(&leaves, 1UL, memory_order_relaxed);
+}
+
+/**
+ * @brief A node of the tree. The depth left to go is carried in the
+ *        argument itself, so the workload allocates nothing of its own and
+ *        what is measured is the pool handing tasks out.
+ */
+static void node(void *arg)
+{
+  const uintptr_t depth = (uintptr_t)arg;
+
+  if (depth == 0)
+  {
+    leaf(arg);
+    return;
+  }
+
+  pool_submit(current, &node, (void *)(depth - 1));
+  pool_submit(current, &node, (void *)(depth - 1));
+}
+
+static void usage(const char *prog)
+{
+  fprintf(stderr,
+    "usage: %s [options]\n"
+    "  -q LIST   pools: stealing,shared (default all)\n"
+    "  -t LIST   worker thread counts (default 1,2,4)\n"
+    "  -d N      depth of the task tree, 2^N leaves (default 16)\n"
+    "  -s N      spin iterations per leaf (default 100)\n"
+    "  -k N      injector capacity in tasks (default 64K)\n"
+    "  -F        submit the leaves flat from the main thread\n"
+    "  -w N      warmup trials (default 1)\n"
+    "  -n N      measured trials (default 5)\n"
+    "  -f FMT    output format: csv or json (default csv)\n",
+    prog);
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+  size_t threads[BENCH_MAX_LIST] = { 1, 2, 4 };
+  size_t nthreads = 3;
+  size_t depth = 16;
+  size_t cap = 64 * 1024;
+  size_t warmup = 1;
+  size_t trials = 5;
+  bool flat = false;
+  enum bench_format format = BENCH_CSV;
+  const char *selected = NULL;
+  int opt;
+
+  spin = 100;
+
+  while (-1 != (opt = getopt(argc, argv, "q:t:d:s:k:Fw:n:f:h")))
+  {
+    switch (opt)
+    {
+      case 'q': selected = optarg; break;
+      case 't': nthreads = bench_parse_list(optarg, threads, BENCH_MAX_LIST); break;
+      case 'd': bench_parse_list(optarg, &depth, 1); break;
+      case 's': bench_parse_list(optarg, &spin, 1); break;
+      case 'k': bench_parse_list(optarg, &cap, 1); break;
+      case 'F': flat = true; break;
+      case 'w': bench_parse_list(optarg, &warmup, 1); break;
+      case 'n': bench_parse_list(optarg, &trials, 1); break;
+      case 'f':
+        if (0 == strcmp(optarg, "json")) { format = BENCH_JSON; }
+        else if (0 == strcmp(optarg, "csv")) { format = BENCH_CSV; }
+        else { usage(argv[0]); }
+        break;
+      default: usage(argv[0]);
+    }
+  }
+
+  if (depth > 30 || cap == 0 || trials == 0)
+  {
+    usage(argv[0]);
+  }
+
+  double *samples = calloc(trials, sizeof(double));
+  const size_t expected = (size_t)1 << depth;
+  const size_t tasks = (true == flat) ? expected : ((expected * 2) - 1);
+
+  const struct bench_field header[] = {
+    BENCH_FIELD_STR("pool", ""),
+    BENCH_FIELD_STR("workload", ""),
+    BENCH_FIELD_INT("threads", 0),
+    BENCH_FIELD_INT("tasks", 0),
+    BENCH_FIELD_INT("spin", 0),
+    BENCH_FIELD_INT("trials", 0),
+    BENCH_FIELD_REAL("tasks_per_sec", 0),
+    BENCH_FIELD_REAL("stddev", 0),
+    BENCH_FIELD_REAL("min", 0),
+    BENCH_FIELD_REAL("max", 0),
+    BENCH_FIELD_REAL("stolen_per_trial", 0),
+  };
+
+  bench_report_begin(stdout, format, header, sizeof(header) / sizeof(header[0]));
+
+  size_t p, n, t, i;
+
+  for (p = 0; p < NPOOLS; p++)
+  {
+    if (false == bench_selected(selected, pools[p].name))
+    {
+      continue;
+    }
+
+    for (n = 0; n < nthreads; n++)
+    {
+      if (threads[n] == 0)
+      {
+        continue;
+      }
+
+      current = pool_new((unsigned)threads[n], pools[p].kind, cap);
+      struct pool_stats before, after;
+      pool_stats(current, &before);
+
+      for (t = 0; t < (warmup + trials); t++)
+      {
+        if (t == warmup)
+        {
+          pool_stats(current, &before);
+        }
+
+        atomic_store(&leaves, 0UL);
+        const uint64_t start = bench_now();
+
+        if (true == flat)
+        {
+          for (i = 0; i < expected; i++)
+          {
+            pool_submit(current, &leaf, NULL);
+          }
+        }
+        else
+        {
+          pool_submit(current, &node, (void *)(uintptr_t)depth);
+        }
+
+        pool_wait(current);
+        const uint64_t elapsed = bench_now() - start;
+
+        if (atomic_load(&leaves) != expected)
+        {
+          fprintf(stderr, "%s: ran %lu of %zu leaves\n", pools[p].name, atomic_load(&leaves), expected);
+          exit(EXIT_FAILURE);
+        }
+
+        if (t >= warmup)
+        {
+          samples[t - warmup] = ((double)tasks * 1e9) / (double)((elapsed != 0) ? elapsed : 1);
+        }
+      }
+
+      pool_stats(current, &after);
+      pool_destroy(current);
+
+      const struct bench_stats stats = bench_summarize(samples, trials);
+
+      const struct bench_field row[] = {
+        BENCH_FIELD_STR("pool", pools[p].name),
+        BENCH_FIELD_STR("workload", (true == flat) ? "flat" : "tree"),
+        BENCH_FIELD_INT("threads", threads[n]),
+        BENCH_FIELD_INT("tasks", tasks),
+        BENCH_FIELD_INT("spin", spin),
+        BENCH_FIELD_INT("trials", trials),
+        BENCH_FIELD_REAL("tasks_per_sec", stats.mean),
+        BENCH_FIELD_REAL("stddev", stats.stddev),
+        BENCH_FIELD_REAL("min", stats.min),
+        BENCH_FIELD_REAL("max", stats.max),
+        BENCH_FIELD_REAL("stolen_per_trial", (double)(after.stolen - before.stolen) / (double)trials),
+      };
+
+      bench_report_row(stdout, format, row, sizeof(row) / sizeof(row[0]));
+    }
+  }
+
+  bench_report_end(stdout, format);
+  free(samples);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,368 @@
+/**
+ * @brief Replay a recorded workload against the turnpike queues.
+ *
+ *        Reads a recording made with a recorder_t attached to a live queue
+ *        and drives each structure with the same operations at the same
+ *        inter-arrival times, optionally sped up or slowed down. Refused
+ *        enqueues in the recording are arrivals too and are replayed as
+ *        enqueues.
+ *
+ *        queue_t and bipbuf_t are not thread-safe, so one thread performs
+ *        every operation in recorded order. For bipartite_queue_t and
+ *        spsc_queue_t a producer thread replays the enqueues and a consumer
+ *        thread replays the dequeues, each on its own schedule.
+ *
+ *        Items of at least eight bytes carry the time they were enqueued,
+ *        so the report includes the dwell-time of every item as well as
+ *        how far behind schedule the replay fell.
+ */
+#include "bipartite.h"
+#include "bipbuf.h"
+#include "histogram.h"
+#include "queue.h"
+#include "recorder.h"
+#include "spsc.h"
+
+#include "harness.h"
+
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief A uniform view of one turnpike structure.
+ */
+struct replay_queue
+{
+  const char *name;
+  bool concurrent;
+  void *(*create)(const size_t cap, const size_t len);
+  bool (*enqueue)(void *queue, const void *item, const size_t size);
+  void *(*dequeue)(void *queue, const size_t size);
+  void (*destroy)(void *queue);
+};
+
+static void *queue_create(const size_t cap, const size_t len) { return queue_new(cap, len); }
+static bool queue_put(void *queue, const void *item, const size_t size) { return queue_enqueue(queue, item); }
+static void *queue_get(void *queue, const size_t size) { return queue_dequeue(queue); }
+static void queue_drop(void *queue) { queue_t *q = queue; queue_destroy(q); }
+
+static void *bipbuf_create(const size_t cap, const size_t len) { return bipbuf_new(cap); }
+static bool bipbuf_put(void *queue, const void *item, const size_t size) { return bipbuf_offer(queue, item, size); }
+static void *bipbuf_get(void *queue, const size_t size) { return bipbuf_poll(queue, size); }
+static void bipbuf_drop(void *queue) { bipbuf_t *q = queue; bipbuf_destroy(q); }
+
+static void *bipartite_create(const size_t cap, const size_t len) { return bipartite_queue_new(cap, len); }
+static bool bipartite_put(void *queue, const void *item, const size_t size) { return bipartite_queue_enqueue(queue, item); }
+static void *bipartite_get(void *queue, const size_t size) { return bipartite_queue_dequeue(queue); }
+static void bipartite_drop(void *queue) { bipartite_queue_t *q = queue; bipartite_queue_destroy(q); }
+
+static void *spsc_create(const size_t cap, const size_t len) { return spsc_queue_new(cap, len); }
+static bool spsc_put(void *queue, const void *item, const size_t size) { return spsc_queue_enqueue(queue, item); }
+static void *spsc_get(void *queue, const size_t size) { return spsc_queue_dequeue(queue); }
+static void spsc_drop(void *queue) { spsc_queue_t *q = queue; spsc_queue_destroy(q); }
+
+static const struct replay_queue queues[] = {
+  { "queue",     false, queue_create,     queue_put,     queue_get,     queue_drop     },
+  { "bipbuf",    false, bipbuf_create,    bipbuf_put,    bipbuf_get,    bipbuf_drop    },
+  { "bipartite", true,  bipartite_create, bipartite_put, bipartite_get, bipartite_drop },
+  { "spsc",      true,  spsc_create,      spsc_put,      spsc_get,      spsc_drop      },
+};
+
+#define NQUEUES (sizeof(queues) / sizeof(queues[0]))
+
+/**
+ * @brief The outcome of replaying the events of one side.
+ */
+struct replay_counts
+{
+  uint64_t enqueued;
+  uint64_t full;
+  uint64_t dequeued;
+  uint64_t empty;
+};
+
+/**
+ * @brief The state of one replay. Each thread only replays the events it
+ *        is given by the mask of operations.
+ */
+struct replay
+{
+  const struct replay_queue *ops;
+  void *queue;
+  const struct recorder_event *events;
+  size_t count;
+  size_t len;
+  double speed;
+  struct histogram *dwell;
+  struct histogram *lag;
+  struct bench_gate gate;
+};
+
+struct replayer
+{
+  struct replay *replay;
+  unsigned mask;
+  struct replay_counts counts;
+};
+
+#define REPLAY_PRODUCER ((1U << RECORDER_ENQUEUE) | (1U << RECORDER_FULL))
+#define REPLAY_CONSUMER (1U << RECORDER_DEQUEUE)
+
+/**
+ * @brief Perform the operations selected by the mask, each once its
+ *        scaled time since the start of the replay has come.
+ */
+static void *replayer(void *arg)
+{
+  struct replayer *self = arg;
+  struct replay *replay = self->replay;
+  uint8_t *item = calloc(1, replay->len);
+  size_t i;
+
+  bench_gate_wait(&replay->gate);
+
+  const uint64_t start = replay->gate.start;
+
+  for (i = 0; i < replay->count; i++)
+  {
+    const struct recorder_event *event = &replay->events[i];
+
+    if (0 == (self->mask & (1U << event->op)))
+    {
+      continue;
+    }
+
+    const uint64_t due = start + (uint64_t)((double)event->time / replay->speed);
+    uint64_t now;
+
+    // Sleep through long gaps so that the other side of a threaded replay
+    // gets the CPU, and spin through short ones.
+    while ((now = bench_now()) < due)
+    {
+      if ((due - now) > 50000)
+      {
+        sched_yield();
+      }
+    }
+
+    histogram_record(replay->lag, now - due);
+
+    const size_t size = (event->size != 0 && event->size <= replay->len) ? event->size : replay->len;
+
+    if (event->op == RECORDER_DEQUEUE)
+    {
+      uint8_t *data = replay->ops->dequeue(replay->queue, size);
+
+      if (data == NULL)
+      {
+        self->counts.empty++;
+        continue;
+      }
+
+      if (size >= sizeof(uint64_t))
+      {
+        uint64_t stamp;
+        memcpy(&stamp, data, sizeof(stamp));
+        histogram_record(replay->dwell, bench_now() - stamp);
+      }
+
+      self->counts.dequeued++;
+      free(data);
+    }
+    else
+    {
+      if (size >= sizeof(uint64_t))
+      {
+        memcpy(item, &now, sizeof(now));
+      }
+
+      if (true == replay->ops->enqueue(replay->queue, item, size))
+      {
+        self->counts.enqueued++;
+      }
+      else
+      {
+        self->counts.full++;
+      }
+    }
+  }
+
+  free(item);
+  return NULL;
+}
+
+static void usage(const char *prog)
+{
+  fprintf(stderr,
+    "usage: %s [options] RECORDING\n"
+    "  -q LIST   structures: queue,bipbuf,bipartite,spsc (default all)\n"
+    "  -k N      capacity in bytes (default 16M)\n"
+    "  -x SPEED  replay speed, 2 replays twice as fast (default 1)\n"
+    "  -f FMT    output format: csv or json (default csv)\n",
+    prog);
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+  size_t cap = 16 * 1024 * 1024;
+  double speed = 1.0;
+  enum bench_format format = BENCH_CSV;
+  const char *selected = NULL;
+  int opt;
+
+  while (-1 != (opt = getopt(argc, argv, "q:k:x:f:h")))
+  {
+    switch (opt)
+    {
+      case 'q': selected = optarg; break;
+      case 'k': bench_parse_list(optarg, &cap, 1); break;
+      case 'x': speed = strtod(optarg, NULL); break;
+      case 'f':
+        if (0 == strcmp(optarg, "json")) { format = BENCH_JSON; }
+        else if (0 == strcmp(optarg, "csv")) { format = BENCH_CSV; }
+        else { usage(argv[0]); }
+        break;
+      default: usage(argv[0]);
+    }
+  }
+
+  if (optind != (argc - 1) || speed <= 0.0)
+  {
+    usage(argv[0]);
+  }
+
+  size_t count = 0;
+  struct recorder_event *events = recorder_load(argv[optind], &count);
+
+  if (events == NULL)
+  {
+    fprintf(stderr, "%s: %s: %s\n", argv[0], argv[optind], "not a readable recording");
+    exit(EXIT_FAILURE);
+  }
+
+  // Fixed-size queues are created with the largest item of the recording.
+  size_t len = sizeof(uint64_t);
+  size_t i;
+
+  for (i = 0; i < count; i++)
+  {
+    len = (events[i].size > len) ? events[i].size : len;
+  }
+
+  if (cap < len)
+  {
+    usage(argv[0]);
+  }
+
+  const uint64_t duration = (count > 0) ? events[count - 1].time : 0;
+
+  const struct bench_field header[] = {
+    BENCH_FIELD_STR("queue", ""),
+    BENCH_FIELD_INT("events", 0),
+    BENCH_FIELD_REAL("speed", 0),
+    BENCH_FIELD_REAL("recorded_ms", 0),
+    BENCH_FIELD_REAL("replayed_ms", 0),
+    BENCH_FIELD_INT("enqueued", 0),
+    BENCH_FIELD_INT("full", 0),
+    BENCH_FIELD_INT("dequeued", 0),
+    BENCH_FIELD_INT("empty", 0),
+    BENCH_FIELD_INT("dwell_p50_ns", 0),
+    BENCH_FIELD_INT("dwell_p99_ns", 0),
+    BENCH_FIELD_INT("dwell_max_ns", 0),
+    BENCH_FIELD_INT("lag_p99_ns", 0),
+    BENCH_FIELD_INT("lag_max_ns", 0),
+  };
+
+  bench_report_begin(stdout, format, header, sizeof(header) / sizeof(header[0]));
+
+  size_t q;
+
+  for (q = 0; q < NQUEUES; q++)
+  {
+    const struct replay_queue *ops = &queues[q];
+
+    if (false == bench_selected(selected, ops->name))
+    {
+      continue;
+    }
+
+    struct replay replay = {
+      .ops = ops,
+      .queue = ops->create(cap, len),
+      .events = events,
+      .count = count,
+      .len = len,
+      .speed = speed,
+      .dwell = histogram_new(),
+      .lag = histogram_new(),
+    };
+
+    struct replayer producer = { .replay = &replay, .mask = REPLAY_PRODUCER };
+    struct replayer consumer = { .replay = &replay, .mask = REPLAY_CONSUMER };
+    pthread_t thread;
+
+    if (true == ops->concurrent)
+    {
+      bench_gate_init(&replay.gate, 2);
+
+      if (pthread_create(&thread, NULL, replayer, &consumer) != 0)
+      {
+        fprintf(stderr, "%s(): %s\n", __func__, "could not create thread");
+        exit(EXIT_FAILURE);
+      }
+
+      replayer(&producer);
+      pthread_join(thread, NULL);
+    }
+    else
+    {
+      bench_gate_init(&replay.gate, 1);
+      producer.mask |= REPLAY_CONSUMER;
+      replayer(&producer);
+    }
+
+    const uint64_t elapsed = bench_now() - replay.gate.start;
+    bench_gate_fini(&replay.gate);
+
+    latency_snapshot_t dwell;
+    latency_snapshot_t lag;
+
+    histogram_latency(replay.dwell, &dwell);
+    histogram_latency(replay.lag, &lag);
+
+    const struct bench_field row[] = {
+      BENCH_FIELD_STR("queue", ops->name),
+      BENCH_FIELD_INT("events", count),
+      BENCH_FIELD_REAL("speed", speed),
+      BENCH_FIELD_REAL("recorded_ms", (double)duration / 1e6),
+      BENCH_FIELD_REAL("replayed_ms", (double)elapsed / 1e6),
+      BENCH_FIELD_INT("enqueued", producer.counts.enqueued),
+      BENCH_FIELD_INT("full", producer.counts.full),
+      BENCH_FIELD_INT("dequeued", producer.counts.dequeued + consumer.counts.dequeued),
+      BENCH_FIELD_INT("empty", producer.counts.empty + consumer.counts.empty),
+      BENCH_FIELD_INT("dwell_p50_ns", dwell.p50),
+      BENCH_FIELD_INT("dwell_p99_ns", dwell.p99),
+      BENCH_FIELD_INT("dwell_max_ns", dwell.max),
+      BENCH_FIELD_INT("lag_p99_ns", lag.p99),
+      BENCH_FIELD_INT("lag_max_ns", lag.max),
+    };
+
+    bench_report_row(stdout, format, row, sizeof(row) / sizeof(row[0]));
+
+    histogram_destroy(replay.dwell);
+    histogram_destroy(replay.lag);
+    ops->destroy(replay.queue);
+  }
+
+  bench_report_end(stdout, format);
+
+  recorder_events_free(events);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,562 @@
+/**
+ * @brief Throughput benchmark for the turnpike queues.
+ *
+ *        Measures items per second for every structure across producer and
+ *        consumer counts, item sizes and capacities, with optional thread
+ *        pinning, warmup trials and repeated measured trials. Results are
+ *        written as CSV or JSON on stdout so that runs can be diffed and
+ *        tracked for regressions.
+ *
+ *        queue_t, bipbuf_t and ts_queue_t are not safe to share between
+ *        threads, so they are driven from a single thread that alternates
+ *        between filling and draining the ring; only the 1x1 configuration
+ *        is reported for them.
+ *
+ *        With -P every run is also measured with hardware performance
+ *        counters and the cycles, instructions, branch misses, cache misses
+ *        and context switches per item are reported next to the
+ *        throughput, to tell what a change in items per second came from.
+ *
+ *        With -B consumers of the structures that support it drain in
+ *        batches, and -K sets how far ahead those batches prefetch; use a
+ *        capacity well above the L2 cache to see the effect on backlogs.
+ *
+ *        Building the library with TURNPIKE_DEFS="-DTURNPIKE_LATENCY" (or
+ *        any other instrumentation flag) and comparing against a default
+ *        build measures the overhead of that instrumentation.
+ */
+#include "bipartite.h"
+#include "bipbuf.h"
+#include "percpu.h"
+#include "queue.h"
+#include "sharded.h"
+#include "tsqueue.h"
+
+#include "harness.h"
+
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_MAX_LIST 32
+#define BENCH_COLUMNS  14
+
+/**
+ * @brief A uniform view of one turnpike structure.
+ */
+struct bench_queue
+{
+  const char *name;
+  bool concurrent;
+  void *(*create)(const size_t cap, const size_t len);
+  bool (*enqueue)(void *queue, const void *item, const size_t len);
+  void *(*dequeue)(void *queue, const size_t len);
+  void (*destroy)(void *queue);
+  size_t (*dequeue_batch)(void *queue, void *items, const size_t max);
+  void (*set_prefetch)(void *queue, const size_t items);
+};
+
+static void *queue_create(const size_t cap, const size_t len) { return queue_new(cap, len); }
+static bool queue_put(void *queue, const void *item, const size_t len) { return queue_enqueue(queue, item); }
+static void *queue_get(void *queue, const size_t len) { return queue_dequeue(queue); }
+static void queue_drop(void *queue) { queue_t *q = queue; queue_destroy(q); }
+static size_t queue_get_batch(void *queue, void *items, const size_t max) { return queue_dequeue_batch(queue, items, max); }
+static void queue_prefetch(void *queue, const size_t items) { queue_set_prefetch(queue, items); }
+
+static void *bipbuf_create(const size_t cap, const size_t len) { return bipbuf_new(cap); }
+static bool bipbuf_put(void *queue, const void *item, const size_t len) { return bipbuf_offer(queue, item, len); }
+static void *bipbuf_get(void *queue, const size_t len) { return bipbuf_poll(queue, len); }
+static void bipbuf_drop(void *queue) { bipbuf_t *q = queue; bipbuf_destroy(q); }
+
+static void *bipartite_create(const size_t cap, const size_t len) { return bipartite_queue_new(cap, len); }
+static bool bipartite_put(void *queue, const void *item, const size_t len) { return bipartite_queue_enqueue(queue, item); }
+static void *bipartite_get(void *queue, const size_t len) { return bipartite_queue_dequeue(queue); }
+static void bipartite_drop(void *queue) { bipartite_queue_t *q = queue; bipartite_queue_destroy(q); }
+static size_t bipartite_get_batch(void *queue, void *items, const size_t max) { return bipartite_queue_dequeue_batch(queue, items, max); }
+static void bipartite_prefetch(void *queue, const size_t items) { bipartite_queue_set_prefetch(queue, items); }
+
+static void *percpu_create(const size_t cap, const size_t len) { return percpu_queue_new(cap, len); }
+static bool percpu_put(void *queue, const void *item, const size_t len) { return percpu_queue_enqueue(queue, item); }
+static void *percpu_get(void *queue, const size_t len) { return percpu_queue_dequeue(queue); }
+static void percpu_drop(void *queue) { percpu_queue_t *q = queue; percpu_queue_destroy(q); }
+static size_t percpu_get_batch(void *queue, void *items, const size_t max) { return percpu_queue_dequeue_batch(queue, items, max); }
+
+static void *sharded_create(const size_t cap, const size_t len) { return sharded_queue_new(cap, len); }
+static bool sharded_put(void *queue, const void *item, const size_t len) { return sharded_queue_enqueue(queue, item); }
+static void *sharded_get(void *queue, const size_t len) { return sharded_queue_dequeue(queue); }
+static void sharded_drop(void *queue) { sharded_queue_t *q = queue; sharded_queue_destroy(q); }
+static size_t sharded_get_batch(void *queue, void *items, const size_t max) { return sharded_queue_dequeue_batch(queue, items, max); }
+
+static void *ts_queue_create(const size_t cap, const size_t len) { return ts_queue_new(cap, len); }
+static bool ts_queue_put(void *queue, const void *item, const size_t len) { return ts_queue_enqueue(queue, item); }
+static void *ts_queue_get(void *queue, const size_t len) { return ts_queue_dequeue(queue); }
+static void ts_queue_drop(void *queue) { ts_queue_t *q = queue; ts_queue_destroy(q); }
+
+static const struct bench_queue queues[] = {
+  { "queue",     false, queue_create,     queue_put,     queue_get,     queue_drop,     queue_get_batch,     queue_prefetch     },
+  { "bipbuf",    false, bipbuf_create,    bipbuf_put,    bipbuf_get,    bipbuf_drop,    NULL,                NULL               },
+  { "bipartite", true,  bipartite_create, bipartite_put, bipartite_get, bipartite_drop, bipartite_get_batch, bipartite_prefetch },
+  { "percpu",    true,  percpu_create,    percpu_put,    percpu_get,    percpu_drop,    percpu_get_batch,    NULL               },
+  { "sharded",   true,  sharded_create,   sharded_put,   sharded_get,   sharded_drop,   sharded_get_batch,   NULL               },
+  { "ts_queue",  false, ts_queue_create,  ts_queue_put,  ts_queue_get,  ts_queue_drop,  NULL,                NULL               },
+};
+
+#define NQUEUES (sizeof(queues) / sizeof(queues[0]))
+
+/**
+ * @brief The state shared by the threads of one trial.
+ */
+struct trial
+{
+  const struct bench_queue *ops;
+  void *queue;
+  size_t len;
+  size_t items;
+  size_t total;
+  size_t batch;
+  atomic_ulong consumed;
+  struct bench_gate gate;
+  const size_t *cpus;
+  size_t ncpus;
+};
+
+struct worker
+{
+  struct trial *trial;
+  size_t index;
+};
+
+static void *producer(void *arg)
+{
+  struct worker *worker = arg;
+  struct trial *trial = worker->trial;
+  size_t i;
+
+  if (trial->ncpus > 0)
+  {
+    bench_pin((int)trial->cpus[worker->index % trial->ncpus]);
+  }
+
+  uint8_t *item = calloc(1, trial->len);
+  bench_gate_wait(&trial->gate);
+
+  for (i = 0; i < trial->items; i++)
+  {
+    while (false == trial->ops->enqueue(trial->queue, item, trial->len))
+    {
+      sched_yield();
+    }
+  }
+
+  free(item);
+  return NULL;
+}
+
+/**
+ * @brief Remove the next items, one at a time or in a batch when the
+ *        structure supports it.
+ * @return The number of items removed.
+ */
+static size_t drain(struct trial *trial, uint8_t *items)
+{
+  if (trial->batch > 1 && trial->ops->dequeue_batch != NULL)
+  {
+    return trial->ops->dequeue_batch(trial->queue, items, trial->batch);
+  }
+
+  void *item = trial->ops->dequeue(trial->queue, trial->len);
+
+  if (item == NULL)
+  {
+    return 0;
+  }
+
+  free(item);
+  return 1;
+}
+
+static void *consumer(void *arg)
+{
+  struct worker *worker = arg;
+  struct trial *trial = worker->trial;
+  uint8_t *items = calloc(trial->batch, trial->len);
+  size_t n = 0;
+
+  if (trial->ncpus > 0)
+  {
+    bench_pin((int)trial->cpus[worker->index % trial->ncpus]);
+  }
+
+  bench_gate_wait(&trial->gate);
+
+  while (atomic_load_explicit(&trial->consumed, memory_order_relaxed) < trial->total)
+  {
+    if (0 == (n = drain(trial, items)))
+    {
+      sched_yield();
+      continue;
+    }
+
+    atomic_fetch_add_explicit(&trial->consumed, n, memory_order_relaxed);
+  }
+
+  free(items);
+  return NULL;
+}
+
+/**
+ * @brief Run one trial with producer and consumer threads.
+ * @return The elapsed time of the trial in nanoseconds.
+ */
+static uint64_t run_threaded(struct trial *trial, const size_t producers, const size_t consumers)
+{
+  pthread_t threads[2 * BENCH_MAX_LIST];
+  struct worker workers[2 * BENCH_MAX_LIST];
+  size_t i;
+
+  bench_gate_init(&trial->gate, producers + consumers);
+
+  for (i = 0; i < (producers + consumers); i++)
+  {
+    workers[i].trial = trial;
+    workers[i].index = i;
+
+    if (pthread_create(&threads[i], NULL, (i < producers) ? producer : consumer, &workers[i]) != 0)
+    {
+      fprintf(stderr, "%s(): %s\n", __func__, "could not create thread");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  for (i = 0; i < (producers + consumers); i++)
+  {
+    pthread_join(threads[i], NULL);
+  }
+
+  const uint64_t elapsed = bench_now() - trial->gate.start;
+  bench_gate_fini(&trial->gate);
+
+  return elapsed;
+}
+
+/**
+ * @brief Run one trial on the calling thread, alternately filling and
+ *        draining the ring.
+ * @return The elapsed time of the trial in nanoseconds, or zero when the
+ *         queue stopped accepting or returning items.
+ */
+static uint64_t run_single(struct trial *trial)
+{
+  uint8_t *item = calloc(1, trial->len);
+  uint8_t *items = calloc(trial->batch, trial->len);
+  size_t produced = 0;
+  size_t consumed = 0;
+  size_t n = 0;
+
+  if (trial->ncpus > 0)
+  {
+    bench_pin((int)trial->cpus[0]);
+  }
+
+  const uint64_t start = bench_now();
+
+  while (consumed < trial->total)
+  {
+    const size_t before = produced + consumed;
+
+    while (produced < trial->total && true == trial->ops->enqueue(trial->queue, item, trial->len))
+    {
+      produced++;
+    }
+
+    while (0 != (n = drain(trial, items)))
+    {
+      consumed += n;
+    }
+
+    if (before == (produced + consumed))
+    {
+      free(item);
+      free(items);
+      return 0;
+    }
+  }
+
+  const uint64_t elapsed = bench_now() - start;
+
+  free(item);
+  free(items);
+  return elapsed;
+}
+
+static void usage(const char *prog)
+{
+  fprintf(stderr,
+    "usage: %s [options]\n"
+    "  -q LIST   structures: queue,bipbuf,bipartite,percpu,sharded,ts_queue (default all)\n"
+    "  -p LIST   producer counts (default 1,2,4)\n"
+    "  -c LIST   consumer counts (default 1,2,4)\n"
+    "  -s LIST   item sizes in bytes (default 4,64,1K,64K)\n"
+    "  -k LIST   capacities in bytes (default 64K,16M)\n"
+    "  -n N      items per producer (default 1000000)\n"
+    "  -b BYTES  byte budget per producer, caps -n for large items (default 256M)\n"
+    "  -t N      measured trials (default 5)\n"
+    "  -w N      warmup trials (default 1)\n"
+    "  -a LIST   CPUs to pin threads to, round-robin (default unpinned)\n"
+    "  -B N      dequeue in batches of N items where supported (default 1)\n"
+    "  -K N      prefetch distance in items for batches and enqueues (default 0)\n"
+    "  -P        count cycles, instructions, branch, L1D and LLC misses and\n"
+    "            context switches per item with perf_event_open()\n"
+    "  -f FMT    output format: csv or json (default csv)\n",
+    prog);
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+  size_t producers[BENCH_MAX_LIST] = { 1, 2, 4 };
+  size_t consumers[BENCH_MAX_LIST] = { 1, 2, 4 };
+  size_t sizes[BENCH_MAX_LIST] = { 4, 64, 1024, 65536 };
+  size_t caps[BENCH_MAX_LIST] = { 64 * 1024, 16 * 1024 * 1024 };
+  size_t cpus[BENCH_MAX_LIST] = { 0 };
+
+  size_t nproducers = 3;
+  size_t nconsumers = 3;
+  size_t nsizes = 4;
+  size_t ncaps = 2;
+  size_t ncpus = 0;
+
+  size_t items = 1000000;
+  size_t budget = 256 * 1024 * 1024;
+  size_t trials = 5;
+  size_t warmup = 1;
+  size_t batch = 1;
+  size_t prefetch = SIZE_MAX;
+  bool counting = false;
+  enum bench_format format = BENCH_CSV;
+  const char *selected = NULL;
+  int opt;
+
+  while (-1 != (opt = getopt(argc, argv, "q:p:c:s:k:n:b:t:w:a:B:K:Pf:h")))
+  {
+    switch (opt)
+    {
+      case 'q': selected = optarg; break;
+      case 'p': nproducers = bench_parse_list(optarg, producers, BENCH_MAX_LIST); break;
+      case 'c': nconsumers = bench_parse_list(optarg, consumers, BENCH_MAX_LIST); break;
+      case 's': nsizes = bench_parse_list(optarg, sizes, BENCH_MAX_LIST); break;
+      case 'k': ncaps = bench_parse_list(optarg, caps, BENCH_MAX_LIST); break;
+      case 'n': bench_parse_list(optarg, &items, 1); break;
+      case 'b': bench_parse_list(optarg, &budget, 1); break;
+      case 't': bench_parse_list(optarg, &trials, 1); break;
+      case 'w': bench_parse_list(optarg, &warmup, 1); break;
+      case 'a': ncpus = bench_parse_list(optarg, cpus, BENCH_MAX_LIST); break;
+      case 'B': bench_parse_list(optarg, &batch, 1); break;
+      case 'K': bench_parse_list(optarg, &prefetch, 1); break;
+      case 'P': counting = true; break;
+      case 'f':
+        if (0 == strcmp(optarg, "json")) { format = BENCH_JSON; }
+        else if (0 == strcmp(optarg, "csv")) { format = BENCH_CSV; }
+        else { usage(argv[0]); }
+        break;
+      default: usage(argv[0]);
+    }
+  }
+
+  if (trials == 0 || trials > 1000 || batch == 0)
+  {
+    usage(argv[0]);
+  }
+
+  double samples[1000];
+  struct bench_counters counters = { 0 };
+  char names[BENCH_COUNTERS][32];
+  size_t i;
+
+  if (true == counting && false == bench_counters_open(&counters))
+  {
+    fprintf(stderr, "%s: %s\n", argv[0], "no performance counters available, see perf_event_paranoid");
+    exit(EXIT_FAILURE);
+  }
+
+  if (true == counting)
+  {
+    for (i = 0; i < BENCH_COUNTERS; i++)
+    {
+      if (counters.fd[i] < 0)
+      {
+        fprintf(stderr, "%s: %s is not available and reads as zero\n", argv[0], bench_counter_name(i));
+      }
+    }
+
+    bench_counters_close(&counters);
+  }
+
+  for (i = 0; i < BENCH_COUNTERS; i++)
+  {
+    snprintf(names[i], sizeof(names[i]), "%s_per_item", bench_counter_name(i));
+  }
+
+  const size_t ncolumns = BENCH_COLUMNS + ((true == counting) ? BENCH_COUNTERS : 0);
+
+  struct bench_field header[BENCH_COLUMNS + BENCH_COUNTERS] = {
+    BENCH_FIELD_STR("queue", ""),
+    BENCH_FIELD_INT("producers", 0),
+    BENCH_FIELD_INT("consumers", 0),
+    BENCH_FIELD_INT("item_size", 0),
+    BENCH_FIELD_INT("capacity", 0),
+    BENCH_FIELD_INT("items", 0),
+    BENCH_FIELD_INT("trials", 0),
+    BENCH_FIELD_INT("batch", 0),
+    BENCH_FIELD_INT("prefetch", 0),
+    BENCH_FIELD_REAL("items_per_sec", 0),
+    BENCH_FIELD_REAL("stddev", 0),
+    BENCH_FIELD_REAL("min", 0),
+    BENCH_FIELD_REAL("max", 0),
+    BENCH_FIELD_INT("rss_kb", 0),
+  };
+
+  for (i = 0; i < BENCH_COUNTERS; i++)
+  {
+    header[BENCH_COLUMNS + i] = BENCH_FIELD_REAL(names[i], 0);
+  }
+
+  bench_report_begin(stdout, format, header, ncolumns);
+
+  size_t q, p, c, s, k, t;
+
+  for (q = 0; q < NQUEUES; q++)
+  {
+    const struct bench_queue *ops = &queues[q];
+
+    if (false == bench_selected(selected, ops->name))
+    {
+      continue;
+    }
+
+    for (p = 0; p < nproducers; p++)
+    for (c = 0; c < nconsumers; c++)
+    for (s = 0; s < nsizes; s++)
+    for (k = 0; k < ncaps; k++)
+    {
+      const size_t np = producers[p];
+      const size_t nc = consumers[c];
+
+      if (np == 0 || nc == 0 || (np + nc) > (2 * BENCH_MAX_LIST) || caps[k] < sizes[s])
+      {
+        continue;
+      }
+
+      if (false == ops->concurrent && (np != 1 || nc != 1))
+      {
+        continue;
+      }
+
+      size_t n = items;
+      if ((n * sizes[s]) > budget)
+      {
+        n = (budget / sizes[s]) ? (budget / sizes[s]) : 1;
+      }
+
+      size_t rss = 0;
+      uint64_t counted[BENCH_COUNTERS] = { 0 };
+
+      for (t = 0; t < (warmup + trials); t++)
+      {
+        struct trial trial = {
+          .ops = ops,
+          .queue = ops->create(caps[k], sizes[s]),
+          .len = sizes[s],
+          .items = n,
+          .total = n * np,
+          .batch = batch,
+          .cpus = cpus,
+          .ncpus = ncpus,
+        };
+        atomic_init(&trial.consumed, 0UL);
+
+        if (prefetch != SIZE_MAX && ops->set_prefetch != NULL)
+        {
+          ops->set_prefetch(trial.queue, prefetch);
+        }
+
+        // The counters are opened afresh for every trial so that they are
+        // inherited by the threads the trial creates.
+        if (true == counting)
+        {
+          bench_counters_open(&counters);
+          bench_counters_start(&counters);
+        }
+
+        const uint64_t elapsed = (true == ops->concurrent) ? run_threaded(&trial, np, nc) : run_single(&trial);
+
+        if (true == counting)
+        {
+          bench_counters_stop(&counters);
+          bench_counters_close(&counters);
+        }
+
+        const size_t now = bench_rss();
+        rss = (now > rss) ? now : rss;
+
+        ops->destroy(trial.queue);
+
+        if (elapsed == 0)
+        {
+          break;
+        }
+
+        if (t >= warmup)
+        {
+          samples[t - warmup] = ((double)trial.total * 1e9) / (double)elapsed;
+
+          for (i = 0; true == counting && i < BENCH_COUNTERS; i++)
+          {
+            counted[i] += counters.value[i];
+          }
+        }
+      }
+
+      if (t < (warmup + trials))
+      {
+        fprintf(stderr, "%s: stalled with item size %zu and capacity %zu\n", ops->name, sizes[s], caps[k]);
+        continue;
+      }
+
+      const struct bench_stats stats = bench_summarize(samples, trials);
+
+      struct bench_field row[BENCH_COLUMNS + BENCH_COUNTERS] = {
+        BENCH_FIELD_STR("queue", ops->name),
+        BENCH_FIELD_INT("producers", np),
+        BENCH_FIELD_INT("consumers", nc),
+        BENCH_FIELD_INT("item_size", sizes[s]),
+        BENCH_FIELD_INT("capacity", caps[k]),
+        BENCH_FIELD_INT("items", n * np),
+        BENCH_FIELD_INT("trials", trials),
+        BENCH_FIELD_INT("batch", (ops->dequeue_batch != NULL) ? batch : 1),
+        BENCH_FIELD_INT("prefetch", (ops->set_prefetch == NULL) ? 0 : ((prefetch != SIZE_MAX) ? prefetch : QUEUE_PREFETCH)),
+        BENCH_FIELD_REAL("items_per_sec", stats.mean),
+        BENCH_FIELD_REAL("stddev", stats.stddev),
+        BENCH_FIELD_REAL("min", stats.min),
+        BENCH_FIELD_REAL("max", stats.max),
+        BENCH_FIELD_INT("rss_kb", rss / 1024),
+      };
+
+      for (i = 0; i < BENCH_COUNTERS; i++)
+      {
+        row[BENCH_COLUMNS + i] = BENCH_FIELD_REAL(names[i], (double)counted[i] / (double)(n * np * trials));
+      }
+
+      bench_report_row(stdout, format, row, ncolumns);
+    }
+  }
+
+  bench_report_end(stdout, format);
+  return EXIT_SUCCESS;
+}
@@ -2,21 +2,107 @@
 
 set -e
 
-/usr/bin/gcc -c -Iinclude -fPIC -o src/bipartite.o src/bipartite.c
-/usr/bin/gcc -c -Iinclude -fPIC -o src/bipbuf.o src/bipbuf.c
-/usr/bin/gcc -c -Iinclude -fPIC -o src/queue.o src/queue.c
+# Optional library features are switched on at compile time, for example
+# TURNPIKE_DEFS="-DTURNPIKE_METRICS -DTURNPIKE_LATENCY -DTURNPIKE_LOCK_PROFILE" ./compile.sh
+DEFS="${TURNPIKE_DEFS:-}"
+
+/usr/bin/gcc -c -Iinclude -fPIC $DEFS -o src/bipartite.o src/bipartite.c
+/usr/bin/gcc -c -Iinclude -fPIC $DEFS -o src/bipbuf.o src/bipbuf.c
+/usr/bin/gcc -c -Iinclude -fPIC $DEFS -o src/broadcast.o src/broadcast.c
+/usr/bin/gcc -c -Iinclude -fPIC $DEFS -o src/copy.o src/copy.c
+/usr/bin/gcc -c -Iinclude -fPIC $DEFS -o src/deque.o src/deque.c
+/usr/bin/gcc -c -Iinclude -fPIC $DEFS -o src/histogram.o src/histogram.c
+/usr/bin/gcc -c -Iinclude -fPIC $DEFS -o src/lockprof.o src/lockprof.c
+/usr/bin/gcc -c -Iinclude -fPIC $DEFS -o src/lossy.o src/lossy.c
+/usr/bin/gcc -c -Iinclude -fPIC $DEFS -o src/metrics.o src/metrics.c
+/usr/bin/gcc -c -Iinclude -fPIC $DEFS -o src/percpu.o src/percpu.c
+/usr/bin/gcc -c -Iinclude -fPIC $DEFS -o src/pipeline.o src/pipeline.c
+/usr/bin/gcc -c -Iinclude -fPIC $DEFS -o src/pool.o src/pool.c
+/usr/bin/gcc -c -Iinclude -fPIC $DEFS -o src/queue.o src/queue.c
+/usr/bin/gcc -c -Iinclude -fPIC $DEFS -o src/recorder.o src/recorder.c
+/usr/bin/gcc -c -Iinclude -fPIC $DEFS -o src/segqueue.o src/segqueue.c
+/usr/bin/gcc -c -Iinclude -fPIC $DEFS -o src/sharded.o src/sharded.c
+/usr/bin/gcc -c -Iinclude -fPIC $DEFS -o src/spsc.o src/spsc.c
+/usr/bin/gcc -c -Iinclude -fPIC $DEFS -o src/tsqueue.o src/tsqueue.c
+/usr/bin/gcc -c -Iinclude -fPIC $DEFS -o src/uring.o src/uring.c
+/usr/bin/gcc -c -Iinclude -fPIC $DEFS -o src/waitset.o src/waitset.c
 
 /usr/bin/gcc -shared -o libexec/libturnpike.so \
   src/bipartite.o \
   src/bipbuf.o \
-  src/queue.o
+  src/broadcast.o \
+  src/copy.o \
+  src/deque.o \
+  src/histogram.o \
+  src/lockprof.o \
+  src/lossy.o \
+  src/metrics.o \
+  src/percpu.o \
+  src/pipeline.o \
+  src/pool.o \
+  src/queue.o \
+  src/recorder.o \
+  src/segqueue.o \
+  src/sharded.o \
+  src/spsc.o \
+  src/tsqueue.o \
+  src/uring.o \
+  src/waitset.o
 
 /usr/bin/gcc -c -Iinclude -o test/bipartite_test.o test/bipartite_test.c
 /usr/bin/gcc -Llibexec -o bin/bipartite_test test/bipartite_test.o -lpthread -lcmocka -lturnpike -ljemalloc
 
+/usr/bin/gcc -c -Iinclude -o test/bipbuf_test.o test/bipbuf_test.c
+/usr/bin/gcc -Llibexec -o bin/bipbuf_test test/bipbuf_test.o -lpthread -lcmocka -lturnpike -ljemalloc
+
+/usr/bin/gcc -c -Iinclude -o test/broadcast_test.o test/broadcast_test.c
+/usr/bin/gcc -Llibexec -o bin/broadcast_test test/broadcast_test.o -lpthread -lcmocka -lturnpike -ljemalloc
+
+/usr/bin/gcc -c -Iinclude -o test/copy_test.o test/copy_test.c
+/usr/bin/gcc -Llibexec -o bin/copy_test test/copy_test.o -lpthread -lcmocka -lturnpike -ljemalloc
+
+/usr/bin/gcc -c -Iinclude -o test/deque_test.o test/deque_test.c
+/usr/bin/gcc -Llibexec -o bin/deque_test test/deque_test.o -lpthread -lcmocka -lturnpike -ljemalloc
+
+/usr/bin/gcc -c -Iinclude -o test/histogram_test.o test/histogram_test.c
+/usr/bin/gcc -Llibexec -o bin/histogram_test test/histogram_test.o -lpthread -lcmocka -lturnpike -ljemalloc
+
+/usr/bin/gcc -c -Iinclude -o test/lossy_test.o test/lossy_test.c
+/usr/bin/gcc -Llibexec -o bin/lossy_test test/lossy_test.o -lpthread -lcmocka -lturnpike -ljemalloc
+
+/usr/bin/gcc -c -Iinclude -o test/metrics_test.o test/metrics_test.c
+/usr/bin/gcc -Llibexec -o bin/metrics_test test/metrics_test.o -lpthread -lcmocka -lturnpike -ljemalloc
+
+/usr/bin/gcc -c -Iinclude -o test/percpu_test.o test/percpu_test.c
+/usr/bin/gcc -Llibexec -o bin/percpu_test test/percpu_test.o -lpthread -lcmocka -lturnpike -ljemalloc
+
+/usr/bin/gcc -c -Iinclude -o test/pipeline_test.o test/pipeline_test.c
+/usr/bin/gcc -Llibexec -o bin/pipeline_test test/pipeline_test.o -lpthread -lcmocka -lturnpike -ljemalloc
+
+/usr/bin/gcc -c -Iinclude -o test/pool_test.o test/pool_test.c
+/usr/bin/gcc -Llibexec -o bin/pool_test test/pool_test.o -lpthread -lcmocka -lturnpike -ljemalloc
+
 /usr/bin/gcc -c -Iinclude -o test/queue_test.o test/queue_test.c
 /usr/bin/gcc -Llibexec -o bin/queue_test test/queue_test.o -lpthread -lcmocka -lturnpike -ljemalloc
 
+/usr/bin/gcc -c -Iinclude -o test/recorder_test.o test/recorder_test.c
+/usr/bin/gcc -Llibexec -o bin/recorder_test test/recorder_test.o -lpthread -lcmocka -lturnpike -ljemalloc
+
+/usr/bin/gcc -c -Iinclude -o test/segqueue_test.o test/segqueue_test.c
+/usr/bin/gcc -Llibexec -o bin/segqueue_test test/segqueue_test.o -lpthread -lcmocka -lturnpike -ljemalloc
+
+/usr/bin/gcc -c -Iinclude -o test/sharded_test.o test/sharded_test.c
+/usr/bin/gcc -Llibexec -o bin/sharded_test test/sharded_test.o -lpthread -lcmocka -lturnpike -ljemalloc
+
+/usr/bin/gcc -c -Iinclude -o test/spsc_test.o test/spsc_test.c
+/usr/bin/gcc -Llibexec -o bin/spsc_test test/spsc_test.o -lpthread -lcmocka -lturnpike -ljemalloc
+
+/usr/bin/gcc -c -Iinclude -o test/uring_test.o test/uring_test.c
+/usr/bin/gcc -Llibexec -o bin/uring_test test/uring_test.o -lpthread -lcmocka -lturnpike -ljemalloc
+
+/usr/bin/gcc -c -Iinclude -o test/waitset_test.o test/waitset_test.c
+/usr/bin/gcc -Llibexec -o bin/waitset_test test/waitset_test.o -lpthread -lcmocka -lturnpike -ljemalloc
+
 # /usr/bin/gcc -c -Iinclude -o test/tsqueue_test.o test/tsqueue_test.c
 # /usr/bin/gcc -Llibexec -o bin/tsqueue_test test/tsqueue_test.o -lpthread -lcmocka -lturnpike -ljemalloc
 
@@ -30,4 +116,21 @@ set -e
 /usr/bin/gcc -c -Iinclude -s -o examples/thread_safety.o examples/thread_safety.c
 /usr/bin/gcc -Llibexec -o bin/thread_safety examples/thread_safety.o -lturnpike -ljemalloc
 
-rm -rf examples/*.o src/*.o test/*.o
+/usr/bin/gcc -c -Iinclude -s -o examples/trim.o examples/trim.c
+/usr/bin/gcc -Llibexec -o bin/trim examples/trim.o -lturnpike -ljemalloc
+
+/usr/bin/gcc -c -Iinclude -Ibench -O2 -o bench/harness.o bench/harness.c
+
+/usr/bin/gcc -c -Iinclude -Ibench -O2 -o bench/latency.o bench/latency.c
+/usr/bin/gcc -Llibexec -o bin/bench_latency bench/latency.o bench/harness.o -lpthread -lm -lturnpike -ljemalloc
+
+/usr/bin/gcc -c -Iinclude -Ibench -O2 -o bench/pool.o bench/pool.c
+/usr/bin/gcc -Llibexec -o bin/bench_pool bench/pool.o bench/harness.o -lpthread -lm -lturnpike -ljemalloc
+
+/usr/bin/gcc -c -Iinclude -Ibench -O2 -o bench/replay.o bench/replay.c
+/usr/bin/gcc -Llibexec -o bin/bench_replay bench/replay.o bench/harness.o -lpthread -lm -lturnpike -ljemalloc
+
+/usr/bin/gcc -c -Iinclude -Ibench -O2 -o bench/throughput.o bench/throughput.c
+/usr/bin/gcc -Llibexec -o bin/bench_throughput bench/throughput.o bench/harness.o -lpthread -lm -lturnpike -ljemalloc
+
+rm -rf bench/*.o examples/*.o src/*.o test/*.o
@@ -0,0 +1,67 @@
+#include "queue.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define QUEUE_CAPACITY       (256 * 1024 * 1024)
+#define QUEUE_SEGMENT_LENGTH 4096
+
+/**
+ * @brief Read the resident set size of this process from procfs.
+ */
+static size_t rss(void)
+{
+  unsigned long size = 0;
+  unsigned long resident = 0;
+  FILE *fp = NULL;
+
+  if (NULL == (fp = fopen("/proc/self/statm", "r")))
+  {
+    return 0;
+  }
+
+  if (2 != fscanf(fp, "%lu %lu", &size, &resident))
+  {
+    resident = 0;
+  }
+
+  fclose(fp);
+  return resident * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+int main(void)
+{
+  queue_t *queue = NULL;
+  size_t i;
+
+  static char item[QUEUE_SEGMENT_LENGTH];
+
+  queue = queue_new_lazy(QUEUE_CAPACITY, QUEUE_SEGMENT_LENGTH);
+  printf("created:  %zu KiB\n", rss() / 1024);
+
+  for (i = 0; i < (QUEUE_CAPACITY / QUEUE_SEGMENT_LENGTH); i++)
+  {
+    if (false == queue_enqueue(queue, item))
+    {
+      fprintf(stderr, "%s(): %s\n", __func__, "could not enqueue value");
+      exit(EXIT_FAILURE);
+    }
+  }
+  printf("burst:    %zu KiB\n", rss() / 1024);
+
+  void *data = NULL;
+
+  for (i = 0; i < ((QUEUE_CAPACITY / QUEUE_SEGMENT_LENGTH) - 16); i++)
+  {
+    data = queue_dequeue(queue);
+    free(data);
+  }
+  printf("drained:  %zu KiB\n", rss() / 1024);
+
+  printf("released: %zu KiB\n", queue_trim(queue) / 1024);
+  printf("trimmed:  %zu KiB\n", rss() / 1024);
+
+  queue_destroy(queue);
+  return EXIT_SUCCESS;
+}
@@ -1,12 +1,26 @@
 #ifndef TURNPIKE__BIPARTITE_H
 #define TURNPIKE__BIPARTITE_H
 
+#include "copy.h"
+#include "histogram.h"
+#include "lockprof.h"
+#include "metrics.h"
+#include "recorder.h"
+#include "waitset.h"
+
 #include <inttypes.h>
 #include <pthread.h>
 #include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
 
+/**
+ * @brief The default distance, in items, that the batch consumer and the
+ *        producer prefetch ahead of their position. Prefetching is off by
+ *        default: no measured run has shown it to help yet.
+ */
+#define BIPARTITE_QUEUE_PREFETCH 0
+
 /**
  * @brief A safe implementation of a Queue data structure. This data
  *        structure is based upon the Circular Buffer. It has a stateful
@@ -21,6 +35,19 @@ struct bipartite_queue
   atomic_ulong r;
   atomic_ulong w;
   pthread_mutex_t lock;
+  bool mapped;
+  copy_fn copy_in;
+  copy_fn copy_out;
+  size_t prefetch;
+  struct metrics *metrics;
+  lock_profile_t *profile;
+  struct histogram *latency;
+  uint64_t *stamps;
+  struct recorder *recorder;
+  int fd;
+  atomic_bool waiting;
+  waitset_t *waitset;
+  size_t slot;
 };
 
 /**
@@ -35,7 +62,31 @@ typedef struct bipartite_queue bipartite_queue_t;
 bipartite_queue_t *bipartite_queue_new(const size_t cap, const size_t len);
 
 /**
- * @brief Deallocate an existing Queue data structure from the heap.
+ * @brief Allocate a new Queue data structure whose buffer is committed
+ *        lazily by the operating system instead of being zeroed up front.
+ * @param cap The maximum capacity allow in the Queue data structure.
+ */
+bipartite_queue_t *bipartite_queue_new_lazy(const size_t cap, const size_t len);
+
+/**
+ * @brief Set up a Queue data structure over memory owned by the caller.
+ * @param self A pointer to the uninitialized Queue container.
+ * @param buffer A buffer of at least cap bytes.
+ * @param cap The maximum capacity allow in the Queue data structure.
+ */
+void bipartite_queue_init(bipartite_queue_t *self, void *buffer, const size_t cap, const size_t len);
+
+/**
+ * @brief Tear down a Queue set up by bipartite_queue_init(). Do not pass
+ *        such a Queue to bipartite_queue_destroy(). A Queue still in a
+ *        wait set is removed from it first.
+ * @param self A pointer to the Queue container.
+ */
+void bipartite_queue_fini(bipartite_queue_t *self);
+
+/**
+ * @brief Deallocate an existing Queue data structure from the heap. A
+ *        Queue still in a wait set is removed from it first.
  * @param self A double pointer to the Queue container.
  */
 void __bipartite_queue_destroy(bipartite_queue_t **self);
@@ -61,6 +112,17 @@ void __bipartite_queue_destroy(bipartite_queue_t **self);
  */
 bool bipartite_queue_enqueue(bipartite_queue_t *self, const void *data);
 
+/**
+ * @brief Add up to count items to the Queue data structure under a single
+ *        acquisition of the lock. Items that do not fit are left to the
+ *        caller.
+ * @param self A pointer to the Queue container.
+ * @param items An array of count items of len bytes.
+ * @param count The number of items to add.
+ * @return The number of items added, from the front of items.
+ */
+size_t bipartite_queue_enqueue_batch(bipartite_queue_t *self, const void *items, const size_t count);
+
 /**
  * @brief Remove an item from the Queue data structure.
  * @param self A pointer to the Queue container.
@@ -68,6 +130,18 @@ bool bipartite_queue_enqueue(bipartite_queue_t *self, const void *data);
  */
 void *bipartite_queue_dequeue(bipartite_queue_t *self);
 
+/**
+ * @brief Remove up to max items from the front of the Queue data structure
+ *        into an array owned by the caller under a single acquisition of
+ *        the lock, prefetching upcoming items. Pass the capacity of the
+ *        Queue in items to drain it.
+ * @param self A pointer to the Queue container.
+ * @param items An array of at least max items of len bytes.
+ * @param max The maximum number of items to remove.
+ * @return The number of items removed.
+ */
+size_t bipartite_queue_dequeue_batch(bipartite_queue_t *self, void *items, const size_t max);
+
 /**
  * @brief Return the item at the front of the Queue data structure.
  * @param self A pointer to the Queue container.
@@ -89,4 +163,86 @@ size_t bipartite_queue_size(bipartite_queue_t *self);
  */
 bool bipartite_queue_empty(bipartite_queue_t *self);
 
+/**
+ * @brief Copy the metrics of the Queue into a snapshot. The Queue keeps
+ *        metrics only when the library is built with TURNPIKE_METRICS.
+ * @param self A pointer to the Queue container.
+ * @param snapshot Receives the metrics of the Queue.
+ * @return Whether or not the Queue collects metrics.
+ */
+bool bipartite_queue_metrics(bipartite_queue_t *self, metrics_snapshot_t *snapshot);
+
+/**
+ * @brief Summarize how long items stayed in the Queue before they were
+ *        dequeued. The Queue records dwell-times only when the library is
+ *        built with TURNPIKE_LATENCY.
+ * @param self A pointer to the Queue container.
+ * @param snapshot Receives the p50, p99 and p999 dwell-times.
+ * @return Whether or not the Queue records dwell-times.
+ */
+bool bipartite_queue_latency(bipartite_queue_t *self, latency_snapshot_t *snapshot);
+
+/**
+ * @brief Copy the lock contention profile of the Queue: for enqueue,
+ *        dequeue, peek, size and empty, the contended and uncontended
+ *        acquisitions, the time spent waiting and the time the lock was
+ *        held. The Queue is profiled only when the library is built with
+ *        TURNPIKE_LOCK_PROFILE.
+ * @param self A pointer to the Queue container.
+ * @param snapshot Receives the lock profile of the Queue.
+ * @return Whether or not the Queue is profiled.
+ */
+bool bipartite_queue_lock_profile(bipartite_queue_t *self, lock_profile_t *snapshot);
+
+/**
+ * @brief Record every enqueue, refused enqueue and dequeue of the Queue
+ *        to a recorder, for replay with bench/replay. Events are logged
+ *        under the lock of the Queue, so they are written in the order the
+ *        operations took effect. The Queue does not take ownership of the
+ *        recorder.
+ * @param self A pointer to the Queue container.
+ * @param recorder The recorder, or NULL to stop recording.
+ */
+void bipartite_queue_set_recorder(bipartite_queue_t *self, recorder_t *recorder);
+
+/**
+ * @brief Return an eventfd that becomes readable when an item is enqueued
+ *        while the consumer is waiting, so that the Queue can be watched
+ *        by epoll, poll or select. The descriptor is created on the first
+ *        call and closed with the Queue.
+ *
+ *        A consumer drains the Queue, then calls bipartite_queue_arm() and
+ *        only waits on the descriptor when that returns true:
+ *
+ *          while (true == bipartite_queue_arm(queue))
+ *          {
+ *            epoll_wait(...);
+ *          }
+ *
+ * @param self A pointer to the Queue container.
+ * @return The file descriptor.
+ */
+int bipartite_queue_fd(bipartite_queue_t *self);
+
+/**
+ * @brief Announce that the consumer is about to wait on the descriptor of
+ *        the Queue. The descriptor is reset, and the next enqueue makes it
+ *        readable again. Producers write to the descriptor only once per
+ *        arm, so a busy Queue costs no system calls.
+ * @param self A pointer to the Queue container.
+ * @return True when the Queue is empty and the consumer may wait, false
+ *         when items are already available.
+ */
+bool bipartite_queue_arm(bipartite_queue_t *self);
+
+/**
+ * @brief Set how many items ahead the batch consumer prefetches and the
+ *        producer prefetches for writing. The default is
+ *        BIPARTITE_QUEUE_PREFETCH. This knob is experimental; measure with
+ *        bench_throughput -K before turning it on.
+ * @param self A pointer to the Queue container.
+ * @param items The prefetch distance in items, or zero to disable.
+ */
+void bipartite_queue_set_prefetch(bipartite_queue_t *self, const size_t items);
+
 #endif/*TURNPIKE__BIPARTITE_H*/
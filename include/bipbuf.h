@@ -1,9 +1,14 @@
 #ifndef TURNPIKE_BIPBUF_H
 #define TURNPIKE_BIPBUF_H
 
+#include "metrics.h"
+#include "recorder.h"
+#include "trim.h"
+
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <sys/types.h>
 
 struct bipbuf
 {
@@ -13,12 +18,22 @@ struct bipbuf
   uint64_t a_end;
   uint64_t b_end;
   bool b_inuse;
+  bool mapped;
+  struct trim_policy trim;
+  struct metrics *metrics;
+  struct recorder *recorder;
 };
 
 typedef struct bipbuf bipbuf_t;
 
 bipbuf_t *bipbuf_new(const size_t cap);
 
+bipbuf_t *bipbuf_new_lazy(const size_t cap);
+
+bool bipbuf_init(bipbuf_t *self, void *buffer, const size_t cap);
+
+void bipbuf_fini(bipbuf_t *self);
+
 void __bipbuf_destroy(bipbuf_t **self);
 
 #define bipbuf_destroy(self) __bipbuf_destroy(&self)
@@ -31,4 +46,20 @@ uint8_t *bipbuf_peek(bipbuf_t *self, const size_t size);
 
 uint8_t *bipbuf_poll(bipbuf_t *self, const size_t size);
 
+size_t bipbuf_contiguous(bipbuf_t *self, const size_t offset, uint8_t **data);
+
+bool bipbuf_release(bipbuf_t *self, const size_t size);
+
+ssize_t bipbuf_read(bipbuf_t *self, const int fd);
+
+ssize_t bipbuf_write(bipbuf_t *self, const int fd);
+
+size_t bipbuf_trim(bipbuf_t *self);
+
+void bipbuf_set_trim_policy(bipbuf_t *self, const size_t watermark, const size_t period);
+
+bool bipbuf_metrics(bipbuf_t *self, metrics_snapshot_t *snapshot);
+
+void bipbuf_set_recorder(bipbuf_t *self, recorder_t *recorder);
+
 #endif/*TURNPIKE_BIPBUF_H*/
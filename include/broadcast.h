@@ -0,0 +1,128 @@
+#ifndef TURNPIKE__BROADCAST_H
+#define TURNPIKE__BROADCAST_H
+
+#include "copy.h"
+
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief The greatest number of consumers of one ring.
+ */
+#define BROADCAST_CONSUMERS 64
+
+/**
+ * @brief The read position of one consumer. Each cursor sits on a cache
+ *        line of its own, so consumers never write to a shared line; the
+ *        cached copy of the tail is private to the consumer.
+ */
+struct broadcast_cursor
+{
+  _Alignas(64) atomic_size_t head;
+  atomic_bool active;
+  size_t tail_cache;
+};
+
+/**
+ * @brief A single-producer, multi-consumer broadcast ring. Every item is
+ *        written once and every subscribed consumer reads every item, in
+ *        place, at its own pace. The producer may only reuse a slot once
+ *        the slowest consumer has released it, and keeps a cached copy of
+ *        that position so that it only scans the cursors when the copy
+ *        says the ring is full.
+ */
+struct broadcast
+{
+  uint8_t *data;
+  size_t cap;
+  size_t len;
+  size_t slots;
+  copy_fn copy_in;
+
+  _Alignas(64) atomic_size_t tail;
+  size_t gate_cache;
+
+  struct broadcast_cursor cursor[BROADCAST_CONSUMERS];
+};
+
+/**
+ * @brief An alias for the broadcast ring struct.
+ */
+typedef struct broadcast broadcast_t;
+
+/**
+ * @brief Allocate a new broadcast ring to the heap.
+ * @param cap The capacity of the ring in bytes.
+ * @param len The length in bytes of every item in the ring.
+ */
+broadcast_t *broadcast_new(const size_t cap, const size_t len);
+
+/**
+ * @brief Deallocate an existing broadcast ring from the heap.
+ * @param self A double pointer to the ring.
+ */
+void __broadcast_destroy(broadcast_t **self);
+
+/**
+ * @brief Create a stack-pointer and pass it to broadcast_destroy() so that
+ *        the ring pointer in the caller knows it no longer exists.
+ * @param self A pointer to the ring.
+ */
+#define broadcast_destroy(self) __broadcast_destroy(&self)
+
+/**
+ * @brief Register a consumer. The consumer sees every item published after
+ *        it subscribed. Subscribe consumers before the producer starts,
+ *        since a cursor only gates the producer once it has seen it.
+ * @param self A pointer to the ring.
+ * @return The id of the consumer, or -1 when every cursor is taken.
+ */
+int broadcast_subscribe(broadcast_t *self);
+
+/**
+ * @brief Unregister a consumer. The producer no longer waits for it. Any
+ *        thread may call this, at any time.
+ * @param self A pointer to the ring.
+ * @param id The id of the consumer.
+ */
+void broadcast_unsubscribe(broadcast_t *self, const int id);
+
+/**
+ * @brief Publish an item to every consumer. Producer only.
+ * @param self A pointer to the ring.
+ * @param data The len bytes of the item.
+ * @return Whether or not the item was published, false when the slowest
+ *         consumer is a whole ring behind.
+ */
+bool broadcast_publish(broadcast_t *self, const void *data);
+
+/**
+ * @brief Return the items a consumer has not read yet, in place. The items
+ *        stay valid until the consumer releases them.
+ * @param self A pointer to the ring.
+ * @param id The id of the consumer.
+ * @param items Receives the address of up to max items.
+ * @param max The capacity of items.
+ * @return The number of items returned.
+ */
+size_t broadcast_peek(broadcast_t *self, const int id, const void **items, const size_t max);
+
+/**
+ * @brief Hand the oldest count items a consumer has read back to the
+ *        producer.
+ * @param self A pointer to the ring.
+ * @param id The id of the consumer.
+ * @param count The number of items, at most the number last peeked.
+ */
+void broadcast_release(broadcast_t *self, const int id, const size_t count);
+
+/**
+ * @brief Return the number of items a consumer has not released yet.
+ * @param self A pointer to the ring.
+ * @param id The id of the consumer.
+ */
+size_t broadcast_backlog(broadcast_t *self, const int id);
+
+#endif/*TURNPIKE__BROADCAST_H*/
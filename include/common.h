@@ -3,9 +3,12 @@
 
 #include <jemalloc/jemalloc.h>
 
+#include <inttypes.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #ifndef always_inline
 #define always_inline __attribute__ ((always_inline))
@@ -47,4 +50,80 @@ static void _free(void **__ptr)
 
 #define __free(__ptr) _free((void **)&__ptr);
 
+/**
+ * @brief Map a buffer of anonymous memory. The pages are neither touched
+ *        nor explicitly zeroed here; the kernel commits a zeroed page on
+ *        the first access to it, so the cost of the mapping is independent
+ *        of its size and only the pages actually used are charged.
+ */
+static void *_map(const size_t size)
+{
+  void *__ptr = NULL;
+  __ptr = mmap(NULL, size, (PROT_READ | PROT_WRITE), (MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE), -1, 0);
+  if (__ptr == MAP_FAILED)
+  {
+    die("a memory error occurred");
+  }
+  return __ptr;
+}
+
+static void _unmap(void *__ptr, const size_t size)
+{
+  if (NULL != __ptr)
+  {
+    munmap(__ptr, size);
+  }
+}
+
+/**
+ * @brief The advice given to the kernel for ring pages that are released by
+ *        a trim. MADV_DONTNEED drops the pages immediately; builds that
+ *        prefer the cheaper, lazy MADV_FREE may override it.
+ */
+#ifndef TURNPIKE_TRIM_ADVICE
+#define TURNPIKE_TRIM_ADVICE MADV_DONTNEED
+#endif/*TURNPIKE_TRIM_ADVICE*/
+
+static size_t _page_size(void)
+{
+  static size_t __size = 0;
+  if (__size == 0)
+  {
+    __size = (size_t)sysconf(_SC_PAGESIZE);
+  }
+  return __size;
+}
+
+/**
+ * @brief Return the whole pages that lie inside bytes [from, to) of a
+ *        buffer to the operating system. The buffer stays mapped, the
+ *        released pages read back as zero and are committed again on
+ *        their next write.
+ * @return The number of bytes released.
+ */
+static size_t _release(uint8_t *__ptr, const size_t from, const size_t to)
+{
+  const uintptr_t __page = (uintptr_t)_page_size();
+
+  if (__ptr == NULL || to <= from)
+  {
+    return 0;
+  }
+
+  const uintptr_t __start = ((uintptr_t)(__ptr + from) + __page - 1) & ~(__page - 1);
+  const uintptr_t __end   = ((uintptr_t)(__ptr + to)) & ~(__page - 1);
+
+  if (__end <= __start)
+  {
+    return 0;
+  }
+
+  if (madvise((void *)__start, (__end - __start), TURNPIKE_TRIM_ADVICE) < 0)
+  {
+    return 0;
+  }
+
+  return (size_t)(__end - __start);
+}
+
 #endif/*TURNPIKE__COMMON_H*/
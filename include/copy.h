@@ -0,0 +1,40 @@
+#ifndef TURNPIKE__COPY_H
+#define TURNPIKE__COPY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Items at least this large are written into a queue with
+ *        non-temporal stores, which bypass the cache so that a large
+ *        transfer does not evict the working set of the consumer. Builds
+ *        may override it; zero disables non-temporal stores.
+ */
+#ifndef TURNPIKE_COPY_STREAM_THRESHOLD
+#define TURNPIKE_COPY_STREAM_THRESHOLD (16 * 1024)
+#endif/*TURNPIKE_COPY_STREAM_THRESHOLD*/
+
+/**
+ * @brief A kernel that copies one item of a queue.
+ */
+typedef void (*copy_fn)(void *restrict dst, const void *restrict src, const size_t len);
+
+/**
+ * @brief Select the copy kernel for items of one length. Lengths of 8, 16,
+ *        32 and 64 bytes get fixed-size kernels that compile to a few moves;
+ *        larger items get an AVX-512 or AVX2 kernel when the CPU supports
+ *        it, and everything else falls back to memcpy(). The CPU is probed
+ *        once, so the selection is cheap enough for every queue creation.
+ * @param len The length in bytes of every item.
+ * @param stream Whether the copy writes into the queue buffer and may use
+ *        non-temporal stores for items above the threshold.
+ */
+copy_fn copy_select(const size_t len, const bool stream);
+
+/**
+ * @brief Return the name of a kernel returned by copy_select(), for
+ *        diagnostics and benchmarks.
+ */
+const char *copy_name(const copy_fn fn);
+
+#endif/*TURNPIKE__COPY_H*/
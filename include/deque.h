@@ -0,0 +1,96 @@
+#ifndef TURNPIKE__DEQUE_H
+#define TURNPIKE__DEQUE_H
+
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief The circular array behind a work-stealing deque. An array that
+ *        was outgrown stays allocated, linked from its successor, until the
+ *        deque is destroyed, because a thief may still be reading from it.
+ */
+struct ws_array
+{
+  size_t size;
+  struct ws_array *prev;
+  uint8_t slot[];
+};
+
+/**
+ * @brief A Chase-Lev work-stealing deque of fixed-length items, kept by
+ *        value in the slots of its array so that pushing one allocates
+ *        nothing. One owner thread pushes and pops at the bottom without a
+ *        lock or, except for the last item, an atomic read-modify-write;
+ *        any other thread steals from the top with a single
+ *        compare-and-swap. The array doubles when the owner fills it.
+ */
+struct ws_deque
+{
+  _Alignas(64) _Atomic(int64_t) top;
+  _Alignas(64) _Atomic(int64_t) bottom;
+  _Atomic(struct ws_array *) array;
+  size_t len;
+};
+
+/**
+ * @brief An alias for the deque struct.
+ */
+typedef struct ws_deque ws_deque_t;
+
+/**
+ * @brief Allocate a new, empty deque to the heap.
+ * @param cap The initial capacity in items, rounded up to a power of two.
+ * @param len The length in bytes of every item in the deque.
+ */
+ws_deque_t *ws_deque_new(const size_t cap, const size_t len);
+
+/**
+ * @brief Deallocate an existing deque from the heap. No thread may use it
+ *        any more.
+ * @param self A double pointer to the deque.
+ */
+void __ws_deque_destroy(ws_deque_t **self);
+
+/**
+ * @brief Create a stack-pointer and pass it to ws_deque_destroy() so that
+ *        the deque pointer in the caller knows it no longer exists.
+ * @param self A pointer to the deque.
+ */
+#define ws_deque_destroy(self) __ws_deque_destroy(&self)
+
+/**
+ * @brief Push a copy of an item onto the bottom of the deque. Owner only.
+ * @param self A pointer to the deque.
+ * @param item The item to be copied in.
+ */
+void ws_deque_push(ws_deque_t *self, const void *item);
+
+/**
+ * @brief Pop the item most recently pushed. Owner only.
+ * @param self A pointer to the deque.
+ * @param item Receives a copy of the item.
+ * @return Whether or not an item was popped; false when the deque is
+ *         empty.
+ */
+bool ws_deque_pop(ws_deque_t *self, void *item);
+
+/**
+ * @brief Steal the oldest item. Any thread.
+ * @param self A pointer to the deque.
+ * @param item Receives a copy of the item. Its contents are undefined when
+ *        nothing was stolen.
+ * @return Whether or not an item was stolen; false when the deque is empty
+ *         or another thread took the item first.
+ */
+bool ws_deque_steal(ws_deque_t *self, void *item);
+
+/**
+ * @brief Return the number of items in the deque. The answer may be stale
+ *        by the time it is returned.
+ * @param self A pointer to the deque.
+ */
+size_t ws_deque_size(ws_deque_t *self);
+
+#endif/*TURNPIKE__DEQUE_H*/
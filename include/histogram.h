@@ -0,0 +1,165 @@
+#ifndef TURNPIKE__HISTOGRAM_H
+#define TURNPIKE__HISTOGRAM_H
+
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+/**
+ * @brief Every power of two range of the histogram is split into this many
+ *        linear sub-buckets, which bounds the relative error of a reported
+ *        value to one part in sixteen.
+ */
+#define HISTOGRAM_SUB_BITS 4
+#define HISTOGRAM_SUB      (1UL << HISTOGRAM_SUB_BITS)
+
+/**
+ * @brief The number of buckets needed to cover every 64-bit value.
+ */
+#define HISTOGRAM_BUCKETS  ((64 - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB)
+
+/**
+ * @brief A lock-free log-linear histogram. Values below 2 * HISTOGRAM_SUB
+ *        are counted exactly; larger values fall into one of HISTOGRAM_SUB
+ *        equal-width buckets of their power of two range.
+ */
+struct histogram
+{
+  atomic_ulong count[HISTOGRAM_BUCKETS];
+};
+
+/**
+ * @brief A summary of the dwell-time of the items of a queue, in
+ *        nanoseconds from enqueue to dequeue.
+ */
+struct latency_snapshot
+{
+  uint64_t count;
+  uint64_t p50;
+  uint64_t p99;
+  uint64_t p999;
+  uint64_t max;
+};
+
+/**
+ * @brief An alias for the latency snapshot struct.
+ */
+typedef struct latency_snapshot latency_snapshot_t;
+
+/**
+ * @brief Allocate a new, empty histogram to the heap.
+ */
+struct histogram *histogram_new(void);
+
+/**
+ * @brief Deallocate an existing histogram from the heap.
+ * @param self A double pointer to the histogram.
+ */
+void __histogram_destroy(struct histogram **self);
+
+/**
+ * @brief Create a stack-pointer and pass it to histogram_destroy() so that
+ *        the histogram pointer in the caller knows it no longer exists.
+ * @param self A pointer to the histogram.
+ */
+#define histogram_destroy(self) __histogram_destroy(&self)
+
+/**
+ * @brief Return the bucket a value is counted in.
+ */
+static inline size_t histogram_bucket(const uint64_t value)
+{
+  if (value < (2 * HISTOGRAM_SUB))
+  {
+    return (size_t)value;
+  }
+
+  const unsigned shift = (63 - __builtin_clzl(value)) - HISTOGRAM_SUB_BITS;
+  return ((shift + 1) * HISTOGRAM_SUB) + ((value >> shift) - HISTOGRAM_SUB);
+}
+
+/**
+ * @brief Count a value. Safe to call from many threads at once.
+ */
+static inline void histogram_record(struct histogram *self, const uint64_t value)
+{
+  atomic_fetch_add_explicit(&self->count[histogram_bucket(value)], 1UL, memory_order_relaxed);
+}
+
+/**
+ * @brief Return the value at a quantile of the histogram, rounded up to the
+ *        upper bound of its bucket.
+ * @param self A pointer to the histogram.
+ * @param quantile The quantile, between 0.0 and 1.0.
+ */
+uint64_t histogram_percentile(struct histogram *self, const double quantile);
+
+/**
+ * @brief Summarize a histogram of dwell-times.
+ * @param self A pointer to the histogram, or NULL when latency is disabled.
+ * @param snapshot Receives the summary.
+ * @return Whether or not the queue records latency.
+ */
+bool histogram_latency(struct histogram *self, latency_snapshot_t *snapshot);
+
+/**
+ * @brief Read the monotonic clock in nanoseconds.
+ */
+static inline uint64_t histogram_now(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((uint64_t)now.tv_sec * 1000000000UL) + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * @brief Allocate a dwell-time histogram for a new queue when the library
+ *        is built with TURNPIKE_LATENCY, otherwise leave the queue without.
+ */
+static inline struct histogram *latency_attach(void)
+{
+#ifdef TURNPIKE_LATENCY
+  return histogram_new();
+#else
+  return NULL;
+#endif/*TURNPIKE_LATENCY*/
+}
+
+/**
+ * @brief Stamp the slot an item was just written to with the current time.
+ *        This compiles to nothing unless built with TURNPIKE_LATENCY.
+ */
+static inline void latency_stamp(uint64_t *stamps, const size_t slot)
+{
+#ifdef TURNPIKE_LATENCY
+  if (stamps != NULL)
+  {
+    stamps[slot] = histogram_now();
+  }
+#else
+  (void)stamps;
+  (void)slot;
+#endif/*TURNPIKE_LATENCY*/
+}
+
+/**
+ * @brief Record the dwell-time of the item being removed from a slot.
+ *        This compiles to nothing unless built with TURNPIKE_LATENCY.
+ */
+static inline void latency_record(struct histogram *self, const uint64_t *stamps, const size_t slot)
+{
+#ifdef TURNPIKE_LATENCY
+  if (self != NULL && stamps != NULL)
+  {
+    histogram_record(self, histogram_now() - stamps[slot]);
+  }
+#else
+  (void)self;
+  (void)stamps;
+  (void)slot;
+#endif/*TURNPIKE_LATENCY*/
+}
+
+#endif/*TURNPIKE__HISTOGRAM_H*/
@@ -0,0 +1,187 @@
+#ifndef TURNPIKE__LOCKPROF_H
+#define TURNPIKE__LOCKPROF_H
+
+#include "histogram.h"
+#include "probes.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * @brief The operations of a queue that take its lock.
+ */
+enum lock_profile_op
+{
+  LOCK_PROFILE_ENQUEUE,
+  LOCK_PROFILE_DEQUEUE,
+  LOCK_PROFILE_PEEK,
+  LOCK_PROFILE_SIZE,
+  LOCK_PROFILE_EMPTY,
+  LOCK_PROFILE_OPS,
+};
+
+/**
+ * @brief The contention statistics of one operation. An acquisition is
+ *        uncontended when the lock was free on the first attempt. Times are
+ *        in nanoseconds.
+ */
+struct lock_stats
+{
+  uint64_t uncontended;
+  uint64_t contended;
+  uint64_t wait_ns;
+  uint64_t wait_max_ns;
+  uint64_t hold_ns;
+};
+
+/**
+ * @brief The contention profile of the lock of one queue. The statistics
+ *        are only updated while the lock is held, so they need no atomics
+ *        of their own.
+ */
+struct lock_profile
+{
+  struct lock_stats op[LOCK_PROFILE_OPS];
+  uint64_t held_since;
+};
+
+/**
+ * @brief An alias for the lock profile struct.
+ */
+typedef struct lock_profile lock_profile_t;
+
+/**
+ * @brief Allocate a new, empty lock profile to the heap.
+ */
+lock_profile_t *lock_profile_new(void);
+
+/**
+ * @brief Deallocate an existing lock profile from the heap.
+ * @param self A double pointer to the lock profile.
+ */
+void __lock_profile_destroy(lock_profile_t **self);
+
+/**
+ * @brief Create a stack-pointer and pass it to lock_profile_destroy() so
+ *        that the profile pointer in the caller knows it no longer exists.
+ * @param self A pointer to the lock profile.
+ */
+#define lock_profile_destroy(self) __lock_profile_destroy(&self)
+
+/**
+ * @brief Return the name of a profiled operation.
+ */
+const char *lock_profile_op_name(const enum lock_profile_op op);
+
+/**
+ * @brief Print a lock profile as one line per operation.
+ * @param self A pointer to the lock profile.
+ * @param fp The stream to print to.
+ */
+void lock_profile_print(const lock_profile_t *self, FILE *fp);
+
+/**
+ * @brief Allocate a lock profile for a new queue when the library is built
+ *        with TURNPIKE_LOCK_PROFILE, otherwise leave the queue without.
+ */
+static inline lock_profile_t *lock_profile_attach(void)
+{
+#ifdef TURNPIKE_LOCK_PROFILE
+  return lock_profile_new();
+#else
+  return NULL;
+#endif/*TURNPIKE_LOCK_PROFILE*/
+}
+
+/**
+ * @brief Lock a mutex on behalf of an operation. Without a profile or
+ *        tracepoints this is a plain pthread_mutex_lock(). Otherwise the
+ *        lock is tried first and, when it is busy, the wait for it is
+ *        traced and recorded.
+ * @param owner The queue that owns the mutex, passed to the tracepoints.
+ * @return Zero on success, otherwise an error number.
+ */
+static inline int lock_profile_acquire(lock_profile_t *self, pthread_mutex_t *lock, const enum lock_profile_op op, const void *owner)
+{
+#if defined(TURNPIKE_LOCK_PROFILE) || defined(TURNPIKE_PROBES)
+  int error = pthread_mutex_trylock(lock);
+
+  if (error != EBUSY)
+  {
+#ifdef TURNPIKE_LOCK_PROFILE
+    if (error == 0 && self != NULL)
+    {
+      self->op[op].uncontended++;
+      self->held_since = histogram_now();
+    }
+#endif/*TURNPIKE_LOCK_PROFILE*/
+    return error;
+  }
+
+  TURNPIKE_PROBE2(lock_wait, owner, (int)op);
+
+#ifdef TURNPIKE_LOCK_PROFILE
+  const uint64_t start = (self != NULL) ? histogram_now() : 0;
+#endif/*TURNPIKE_LOCK_PROFILE*/
+
+  if (0 != (error = pthread_mutex_lock(lock)))
+  {
+    return error;
+  }
+
+  TURNPIKE_PROBE2(lock_acquired, owner, (int)op);
+
+#ifdef TURNPIKE_LOCK_PROFILE
+  if (self != NULL)
+  {
+    const uint64_t now = histogram_now();
+    const uint64_t wait = now - start;
+
+    self->op[op].contended++;
+    self->op[op].wait_ns += wait;
+
+    if (wait > self->op[op].wait_max_ns)
+    {
+      self->op[op].wait_max_ns = wait;
+    }
+
+    self->held_since = now;
+  }
+#endif/*TURNPIKE_LOCK_PROFILE*/
+
+  (void)self;
+  (void)owner;
+  return 0;
+#else
+  (void)self;
+  (void)op;
+  (void)owner;
+  return pthread_mutex_lock(lock);
+#endif
+}
+
+/**
+ * @brief Unlock a mutex on behalf of an operation, recording how long it
+ *        was held when a profile is attached.
+ * @return Zero on success, otherwise an error number.
+ */
+static inline int lock_profile_release(lock_profile_t *self, pthread_mutex_t *lock, const enum lock_profile_op op)
+{
+#ifdef TURNPIKE_LOCK_PROFILE
+  if (self != NULL)
+  {
+    self->op[op].hold_ns += histogram_now() - self->held_since;
+  }
+#else
+  (void)self;
+  (void)op;
+#endif/*TURNPIKE_LOCK_PROFILE*/
+
+  return pthread_mutex_unlock(lock);
+}
+
+#endif/*TURNPIKE__LOCKPROF_H*/
@@ -0,0 +1,107 @@
+#ifndef TURNPIKE__LOSSY_H
+#define TURNPIKE__LOSSY_H
+
+#include "copy.h"
+
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief A lossy implementation of a Queue data structure for telemetry.
+ *        Producers never fail: when the Queue is full the oldest items are
+ *        overwritten. Every item carries a sequence number so that the
+ *        consumer can detect and count the gaps left by overwritten items.
+ *        Producers take a sequence number with one atomic increment and
+ *        then claim the slot with a single compare-and-swap on its
+ *        sequence word, so that a producer that was lapped can never write
+ *        over a newer item. The producer path is wait-free: a producer
+ *        that cannot claim its slot, because a newer item owns it or an
+ *        older item is still being copied into it, gives its item up and
+ *        leaves a gap. The Queue has a single consumer.
+ */
+struct lossy_queue
+{
+  uint8_t *data;
+  atomic_ulong *seq;
+  size_t cap;
+  size_t len;
+  size_t slots;
+  copy_fn copy_in;
+  copy_fn copy_out;
+  atomic_ulong w;
+  uint64_t r;
+  uint64_t dropped;
+};
+
+/**
+ * @brief An alias for the Queue data struct.
+ */
+typedef struct lossy_queue lossy_queue_t;
+
+/**
+ * @brief Allocate a new Queue data structure to the heap.
+ * @param cap The maximum capacity allow in the Queue data structure.
+ * @param len The length in bytes of every item in the Queue.
+ */
+lossy_queue_t *lossy_queue_new(const size_t cap, const size_t len);
+
+/**
+ * @brief Deallocate an existing Queue data structure from the heap.
+ * @param self A double pointer to the Queue container.
+ */
+void __lossy_queue_destroy(lossy_queue_t **self);
+
+/**
+ * @brief Create a stack-pointer and pass it to lossy_queue_destroy() so
+ *        that the queue pointer in the caller knows the queue no longer
+ *        exists.
+ * @param self A pointer to the Queue container.
+ */
+#define lossy_queue_destroy(self) __lossy_queue_destroy(&self)
+
+/**
+ * @brief Add an item to the Queue data structure, overwriting the oldest
+ *        item when the Queue is full. Safe to call from many producers and
+ *        never waits. An item whose slot another producer holds is given
+ *        up and counted like an overwritten one.
+ * @param self A pointer to the Queue container.
+ * @param data The item to be added to the Queue data structure.
+ * @return The sequence number assigned to the item.
+ */
+uint64_t lossy_queue_enqueue(lossy_queue_t *self, const void *data);
+
+/**
+ * @brief Remove the oldest item still held by the Queue data structure.
+ *        Items overwritten or given up before they could be removed are
+ *        skipped and counted as dropped.
+ * @param self A pointer to the Queue container.
+ * @param seq Receives the sequence number of the item; may be NULL.
+ * @return The item removed from the front of the Queue, or NULL when no
+ *         published item is available.
+ */
+void *lossy_queue_dequeue(lossy_queue_t *self, uint64_t *seq);
+
+/**
+ * @brief Return the number of items that were overwritten before the
+ *        consumer could remove them.
+ * @param self A pointer to the Queue container.
+ */
+uint64_t lossy_queue_dropped(lossy_queue_t *self);
+
+/**
+ * @brief Return the number of bytes currently in the Queue data structure.
+ * @param self A pointer to the Queue container.
+ * @return The current size of the Queue data structure.
+ */
+size_t lossy_queue_size(lossy_queue_t *self);
+
+/**
+ * @brief Determine of the Queue data structure is empty.
+ * @param self A pointer to the Queue container.
+ * @return Whether or not the Queue data structure is empty.
+ */
+bool lossy_queue_empty(lossy_queue_t *self);
+
+#endif/*TURNPIKE__LOSSY_H*/
@@ -0,0 +1,167 @@
+#ifndef TURNPIKE__METRICS_H
+#define TURNPIKE__METRICS_H
+
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief The number of counter shards kept per queue. Threads are spread
+ *        over the shards so that, up to this many threads, no two threads
+ *        update the same cache line.
+ */
+#define METRICS_SHARDS 16
+
+/**
+ * @brief The events counted by the metrics of a queue.
+ */
+enum metrics_event
+{
+  METRICS_ENQUEUE,
+  METRICS_DEQUEUE,
+  METRICS_FULL,
+  METRICS_EMPTY,
+};
+
+/**
+ * @brief A point-in-time copy of the metrics of a queue. The counters are
+ *        summed over every shard; the high-water mark is the greatest
+ *        occupancy in bytes observed after an enqueue.
+ */
+struct metrics_snapshot
+{
+  uint64_t enqueued;
+  uint64_t dequeued;
+  uint64_t full;
+  uint64_t empty;
+  uint64_t high_water;
+};
+
+/**
+ * @brief An alias for the metrics snapshot struct.
+ */
+typedef struct metrics_snapshot metrics_snapshot_t;
+
+/**
+ * @brief One cache line of counters, only ever updated by the threads that
+ *        were assigned to it.
+ */
+struct metrics_shard
+{
+  _Alignas(64) atomic_ulong enqueued;
+  atomic_ulong dequeued;
+  atomic_ulong full;
+  atomic_ulong empty;
+  atomic_ulong high_water;
+};
+
+/**
+ * @brief The sharded counters attached to a queue.
+ */
+struct metrics
+{
+  struct metrics_shard shard[METRICS_SHARDS];
+};
+
+/**
+ * @brief Allocate a new set of metrics to the heap.
+ */
+struct metrics *metrics_new(void);
+
+/**
+ * @brief Deallocate an existing set of metrics from the heap.
+ * @param self A double pointer to the metrics.
+ */
+void __metrics_destroy(struct metrics **self);
+
+/**
+ * @brief Create a stack-pointer and pass it to metrics_destroy() so that
+ *        the metrics pointer in the caller knows the metrics no longer exist.
+ * @param self A pointer to the metrics.
+ */
+#define metrics_destroy(self) __metrics_destroy(&self)
+
+/**
+ * @brief Sum the shards of a set of metrics into a snapshot. The counters
+ *        are read without stopping the queue, so a snapshot taken while the
+ *        queue is in use may be off by the operations in flight.
+ * @param self A pointer to the metrics, or NULL when metrics are disabled.
+ * @param snapshot Receives the summed metrics.
+ * @return Whether or not the queue collects metrics.
+ */
+bool metrics_snapshot(struct metrics *self, metrics_snapshot_t *snapshot);
+
+/**
+ * @brief The shard assigned to the calling thread, plus one. Zero until the
+ *        thread records its first event.
+ */
+extern _Thread_local size_t __metrics_shard;
+
+/**
+ * @brief Assign the calling thread to the next shard in round-robin order.
+ */
+void __metrics_shard_assign(void);
+
+/**
+ * @brief Record an event in the shard of the calling thread. This compiles
+ *        to nothing unless the library is built with TURNPIKE_METRICS.
+ * @param self A pointer to the metrics, or NULL when metrics are disabled.
+ * @param event The event to count.
+ * @param used The occupancy in bytes after the event.
+ */
+static inline void metrics_record(struct metrics *self, const enum metrics_event event, const size_t used)
+{
+#ifdef TURNPIKE_METRICS
+  if (self == NULL)
+  {
+    return;
+  }
+
+  if (__metrics_shard == 0)
+  {
+    __metrics_shard_assign();
+  }
+
+  struct metrics_shard *shard = &self->shard[__metrics_shard - 1];
+
+  switch (event)
+  {
+    case METRICS_ENQUEUE:
+      atomic_fetch_add_explicit(&shard->enqueued, 1UL, memory_order_relaxed);
+      if (used > atomic_load_explicit(&shard->high_water, memory_order_relaxed))
+      {
+        atomic_store_explicit(&shard->high_water, used, memory_order_relaxed);
+      }
+      break;
+    case METRICS_DEQUEUE:
+      atomic_fetch_add_explicit(&shard->dequeued, 1UL, memory_order_relaxed);
+      break;
+    case METRICS_FULL:
+      atomic_fetch_add_explicit(&shard->full, 1UL, memory_order_relaxed);
+      break;
+    case METRICS_EMPTY:
+      atomic_fetch_add_explicit(&shard->empty, 1UL, memory_order_relaxed);
+      break;
+  }
+#else
+  (void)self;
+  (void)event;
+  (void)used;
+#endif/*TURNPIKE_METRICS*/
+}
+
+/**
+ * @brief Allocate metrics for a new queue when the library is built with
+ *        TURNPIKE_METRICS, otherwise leave the queue without metrics.
+ */
+static inline struct metrics *metrics_attach(void)
+{
+#ifdef TURNPIKE_METRICS
+  return metrics_new();
+#else
+  return NULL;
+#endif/*TURNPIKE_METRICS*/
+}
+
+#endif/*TURNPIKE__METRICS_H*/
@@ -0,0 +1,116 @@
+#ifndef TURNPIKE__PERCPU_H
+#define TURNPIKE__PERCPU_H
+
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief The ring of one CPU. The tail is written by producers running on
+ *        that CPU, the head by any consumer with a compare-and-swap; they
+ *        live on separate cache lines. The flag serializes producers that
+ *        cannot use a restartable sequence.
+ */
+struct percpu_ring
+{
+  _Alignas(64) atomic_size_t tail;
+  uint8_t *data;
+  atomic_bool locked;
+
+  _Alignas(64) atomic_size_t head;
+};
+
+/**
+ * @brief A multi-producer, multi-consumer Queue with one ring per CPU.
+ *        Where Linux restartable sequences are available a producer
+ *        enqueues into the ring of the CPU it runs on with plain loads and
+ *        stores: the kernel restarts the enqueue if the thread is preempted
+ *        or migrated before its final store, so no two producers can ever
+ *        interleave on a ring. Where they are not, or on architectures
+ *        without the assembly, producers take the ring of sched_getcpu()
+ *        under its flag instead. Threads that cannot use rseq on an rseq
+ *        queue share a spare ring under its flag. Consumers drain every
+ *        ring. Items from one thread stay in order while it stays on one
+ *        CPU; there is no order across rings. Building with
+ *        TURNPIKE_DEFS="-DTURNPIKE_NO_RSEQ" always takes the flag path.
+ */
+struct percpu_queue
+{
+  size_t cap;
+  size_t len;
+  size_t slots;
+  size_t mask;
+  size_t cpus;
+  bool rseq;
+  struct percpu_ring *ring;
+};
+
+/**
+ * @brief An alias for the Queue data struct.
+ */
+typedef struct percpu_queue percpu_queue_t;
+
+/**
+ * @brief Allocate a new Queue data structure to the heap with one ring per
+ *        configured CPU, plus the spare ring.
+ * @param cap The capacity in bytes of each ring, rounded down to a power
+ *        of two number of items.
+ * @param len The length in bytes of every item in the Queue.
+ */
+percpu_queue_t *percpu_queue_new(const size_t cap, const size_t len);
+
+/**
+ * @brief Deallocate an existing Queue data structure from the heap.
+ * @param self A double pointer to the Queue container.
+ */
+void __percpu_queue_destroy(percpu_queue_t **self);
+
+/**
+ * @brief Create a stack-pointer and pass it to percpu_queue_destroy() so
+ *        that the queue pointer in the caller knows the queue no longer
+ *        exists.
+ * @param self A pointer to the Queue container.
+ */
+#define percpu_queue_destroy(self) __percpu_queue_destroy(&self)
+
+/**
+ * @brief Add an item to the ring of the CPU the caller runs on. A full ring
+ *        makes the enqueue fail even when other rings have room.
+ * @param self A pointer to the Queue container.
+ * @param data The item to be added to the Queue data structure.
+ * @return Whether or not the item was added.
+ */
+bool percpu_queue_enqueue(percpu_queue_t *self, const void *data);
+
+/**
+ * @brief Remove an item from the next ring that has one.
+ * @param self A pointer to the Queue container.
+ * @return A copy of the item removed, or NULL when every ring was empty.
+ */
+void *percpu_queue_dequeue(percpu_queue_t *self);
+
+/**
+ * @brief Remove up to max items into an array owned by the caller, claiming
+ *        the items of one ring with a single compare-and-swap.
+ * @param self A pointer to the Queue container.
+ * @param items An array of at least max items of len bytes.
+ * @param max The maximum number of items to remove.
+ * @return The number of items removed.
+ */
+size_t percpu_queue_dequeue_batch(percpu_queue_t *self, void *items, const size_t max);
+
+/**
+ * @brief Return the number of bytes currently in the Queue data structure.
+ *        The answer may be stale by the time it is returned.
+ * @param self A pointer to the Queue container.
+ */
+size_t percpu_queue_size(percpu_queue_t *self);
+
+/**
+ * @brief Determine of the Queue data structure is empty.
+ * @param self A pointer to the Queue container.
+ */
+bool percpu_queue_empty(percpu_queue_t *self);
+
+#endif/*TURNPIKE__PERCPU_H*/
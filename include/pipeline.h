@@ -0,0 +1,182 @@
+#ifndef TURNPIKE__PIPELINE_H
+#define TURNPIKE__PIPELINE_H
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * @brief The greatest number of stages in one pipeline.
+ */
+#define PIPELINE_STAGES 16
+
+/**
+ * @brief The number of items a worker takes from its input, and hands to
+ *        its output, in one go.
+ */
+#define PIPELINE_BATCH 32
+
+/**
+ * @brief The kind of ring that carries the output of a stage to the next.
+ *        An SPSC ring needs exactly one thread on either side of it.
+ */
+enum pipeline_ring
+{
+  PIPELINE_BIPARTITE,
+  PIPELINE_SPSC,
+};
+
+/**
+ * @brief What a stage function did with one item.
+ */
+enum pipeline_result
+{
+  PIPELINE_EMIT,
+  PIPELINE_DROP,
+  PIPELINE_DONE,
+};
+
+/**
+ * @brief The function of a stage. The first stage is a source and is called
+ *        with in set to NULL until it returns PIPELINE_DONE. The last stage
+ *        is a sink and is called with out set to NULL. Every other stage is
+ *        called once per input item and fills out when it returns
+ *        PIPELINE_EMIT. A stage with several threads calls its function
+ *        from all of them, with the same context.
+ * @param ctx The context given to pipeline_add().
+ * @param in The input item, or NULL for the source.
+ * @param out Room for one output item, or NULL for the sink.
+ */
+typedef enum pipeline_result (*pipeline_fn)(void *ctx, const void *in, void *out);
+
+/**
+ * @brief The statistics of one stage. Throughput is over the time the
+ *        stage has been running, and the backlog is the number of items
+ *        waiting in its input ring.
+ */
+struct pipeline_stats
+{
+  uint64_t in;
+  uint64_t out;
+  uint64_t batches;
+  size_t backlog;
+  uint64_t elapsed_ns;
+  double rate;
+};
+
+/**
+ * @brief An alias for the pipeline stats struct.
+ */
+typedef struct pipeline_stats pipeline_stats_t;
+
+/**
+ * @brief One stage of a pipeline: its declaration, the ring to the next
+ *        stage, its workers and their counters.
+ */
+struct pipeline_stage
+{
+  const char *name;
+  pipeline_fn fn;
+  void *ctx;
+  unsigned threads;
+  size_t len;
+  enum pipeline_ring ring;
+
+  struct pipeline *owner;
+  size_t index;
+  void *output;
+  pthread_t *workers;
+  atomic_uint running;
+  atomic_ulong in;
+  atomic_ulong out;
+  atomic_ulong batches;
+  atomic_ulong finished;
+};
+
+/**
+ * @brief A chain of stages connected by turnpike rings. Every stage runs
+ *        on its own threads; items move between stages in batches.
+ */
+struct pipeline
+{
+  size_t slots;
+  size_t stages;
+  uint64_t started;
+  struct pipeline_stage stage[PIPELINE_STAGES];
+};
+
+/**
+ * @brief An alias for the pipeline struct.
+ */
+typedef struct pipeline pipeline_t;
+
+/**
+ * @brief Allocate a new, empty pipeline to the heap.
+ * @param slots The capacity in items of every ring between stages.
+ */
+pipeline_t *pipeline_new(const size_t slots);
+
+/**
+ * @brief Deallocate a pipeline from the heap. Call pipeline_wait() first
+ *        when the pipeline was started.
+ * @param self A double pointer to the pipeline.
+ */
+void __pipeline_destroy(pipeline_t **self);
+
+/**
+ * @brief Create a stack-pointer and pass it to pipeline_destroy() so that
+ *        the pipeline pointer in the caller knows it no longer exists.
+ * @param self A pointer to the pipeline.
+ */
+#define pipeline_destroy(self) __pipeline_destroy(&self)
+
+/**
+ * @brief Append a stage to the pipeline.
+ * @param self A pointer to the pipeline.
+ * @param name The name of the stage, for the statistics.
+ * @param fn The function of the stage.
+ * @param ctx The context passed to fn.
+ * @param threads The number of threads that run fn.
+ * @param len The length in bytes of an output item, zero for the sink.
+ * @param ring The kind of ring that carries the output to the next stage.
+ * @return Whether or not the stage was added.
+ */
+bool pipeline_add(pipeline_t *self, const char *name, pipeline_fn fn, void *ctx, const unsigned threads, const size_t len, const enum pipeline_ring ring);
+
+/**
+ * @brief Create the rings and start every worker.
+ * @param self A pointer to the pipeline.
+ * @return Whether or not the pipeline started. It does not when it has
+ *         fewer than two stages, when any stage but the last has no output
+ *         or the last has one, or when an SPSC ring has more than one
+ *         thread on either side.
+ */
+bool pipeline_start(pipeline_t *self);
+
+/**
+ * @brief Wait until the source is done and every item has reached the
+ *        sink.
+ * @param self A pointer to the pipeline.
+ */
+void pipeline_wait(pipeline_t *self);
+
+/**
+ * @brief Read the statistics of a stage while it runs, or after.
+ * @param self A pointer to the pipeline.
+ * @param stage The index of the stage.
+ * @param stats Receives the statistics.
+ * @return Whether or not the stage exists.
+ */
+bool pipeline_stats(pipeline_t *self, const size_t stage, pipeline_stats_t *stats);
+
+/**
+ * @brief Print the statistics of every stage as one line per stage.
+ * @param self A pointer to the pipeline.
+ * @param fp The stream to print to.
+ */
+void pipeline_print(pipeline_t *self, FILE *fp);
+
+#endif/*TURNPIKE__PIPELINE_H*/
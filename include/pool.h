@@ -0,0 +1,134 @@
+#ifndef TURNPIKE__POOL_H
+#define TURNPIKE__POOL_H
+
+#include "bipartite.h"
+#include "deque.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief The number of tasks a worker takes from the injector in one go.
+ */
+#define POOL_BATCH 16
+
+/**
+ * @brief How the workers of a pool find their tasks. A stealing pool gives
+ *        every worker a deque of its own: tasks submitted by a worker go to
+ *        its deque, an idle worker steals from the others, and only tasks
+ *        submitted from outside pass through the shared injector. A shared
+ *        pool sends every task through the injector.
+ */
+enum pool_kind
+{
+  POOL_STEALING,
+  POOL_SHARED,
+};
+
+/**
+ * @brief The function of a task.
+ */
+typedef void (*pool_fn)(void *arg);
+
+/**
+ * @brief A task, as it is kept in the injector and in the deques.
+ */
+struct pool_task
+{
+  pool_fn fn;
+  void *arg;
+};
+
+/**
+ * @brief One worker thread and its deque. The counters are only written by
+ *        the worker itself.
+ */
+struct pool_worker
+{
+  _Alignas(64) struct pool *pool;
+  ws_deque_t *deque;
+  pthread_t thread;
+  unsigned index;
+  uint64_t seed;
+  atomic_ulong executed;
+  atomic_ulong stolen;
+};
+
+/**
+ * @brief A pool of worker threads running fine-grained tasks.
+ */
+struct pool
+{
+  enum pool_kind kind;
+  unsigned threads;
+  bipartite_queue_t *injector;
+  struct pool_worker *workers;
+
+  _Alignas(64) atomic_ulong pending;
+  atomic_bool stopping;
+};
+
+/**
+ * @brief An alias for the pool struct.
+ */
+typedef struct pool pool_t;
+
+/**
+ * @brief The totals of the workers of a pool.
+ */
+struct pool_stats
+{
+  uint64_t executed;
+  uint64_t stolen;
+};
+
+/**
+ * @brief Allocate a new pool to the heap and start its workers.
+ * @param threads The number of worker threads.
+ * @param kind How the workers find their tasks.
+ * @param cap The capacity in tasks of the injector.
+ */
+pool_t *pool_new(const unsigned threads, const enum pool_kind kind, const size_t cap);
+
+/**
+ * @brief Wait for every task, stop the workers and deallocate the pool.
+ * @param self A double pointer to the pool.
+ */
+void __pool_destroy(pool_t **self);
+
+/**
+ * @brief Create a stack-pointer and pass it to pool_destroy() so that the
+ *        pool pointer in the caller knows it no longer exists.
+ * @param self A pointer to the pool.
+ */
+#define pool_destroy(self) __pool_destroy(&self)
+
+/**
+ * @brief Submit a task. Tasks may submit further tasks. A task submitted
+ *        from outside the pool waits for room in the injector; a task
+ *        submitted by a worker of a shared pool whose injector is full is
+ *        run at once instead, so that the workers cannot deadlock.
+ * @param self A pointer to the pool.
+ * @param fn The function of the task.
+ * @param arg The argument passed to fn.
+ */
+void pool_submit(pool_t *self, pool_fn fn, void *arg);
+
+/**
+ * @brief Wait until every task submitted so far, and every task those
+ *        submitted, has run. Do not call from a task.
+ * @param self A pointer to the pool.
+ */
+void pool_wait(pool_t *self);
+
+/**
+ * @brief Sum the counters of the workers.
+ * @param self A pointer to the pool.
+ * @param stats Receives the totals.
+ */
+void pool_stats(pool_t *self, struct pool_stats *stats);
+
+#endif/*TURNPIKE__POOL_H*/
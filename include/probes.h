@@ -0,0 +1,45 @@
+#ifndef TURNPIKE__PROBES_H
+#define TURNPIKE__PROBES_H
+
+/**
+ * @brief Static tracepoints for perf and bpftrace. When <sys/sdt.h> is
+ *        available every probe is compiled in as a single nop under the
+ *        "turnpike" provider, so production builds can be traced without a
+ *        redeploy, for example:
+ *
+ *          bpftrace -l 'usdt:libexec/libturnpike.so:turnpike:*'
+ *
+ *        Define TURNPIKE_NO_USDT to compile the probes out entirely.
+ *
+ *        Every queue probe carries the queue pointer, the occupancy in bytes
+ *        after the operation and the item size in bytes:
+ *
+ *          queue_enqueue, queue_enqueue_full, queue_dequeue,
+ *          bipartite_enqueue, bipartite_enqueue_full, bipartite_dequeue,
+ *          bipbuf_offer, bipbuf_offer_full, bipbuf_poll
+ *
+ *        queue_switch_to_b and bipbuf_switch_to_b fire when writes move to
+ *        region B. lock_wait and lock_acquired bracket a contended lock and
+ *        carry the queue pointer and the lock_profile_op of the caller.
+ */
+#if !defined(TURNPIKE_NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define TURNPIKE_PROBES
+#endif
+#endif
+
+#ifdef TURNPIKE_PROBES
+
+#include <sys/sdt.h>
+
+#define TURNPIKE_PROBE2(name, a, b)    DTRACE_PROBE2(turnpike, name, a, b)
+#define TURNPIKE_PROBE3(name, a, b, c) DTRACE_PROBE3(turnpike, name, a, b, c)
+
+#else
+
+#define TURNPIKE_PROBE2(name, a, b)    do { } while (0)
+#define TURNPIKE_PROBE3(name, a, b, c) do { } while (0)
+
+#endif/*TURNPIKE_PROBES*/
+
+#endif/*TURNPIKE__PROBES_H*/
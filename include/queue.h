@@ -1,10 +1,23 @@
 #ifndef TURNPIKE__QUEUE_H
 #define TURNPIKE__QUEUE_H
 
+#include "copy.h"
+#include "histogram.h"
+#include "metrics.h"
+#include "recorder.h"
+#include "trim.h"
+
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stddef.h>
 
+/**
+ * @brief The default distance, in items, that the batch consumer and the
+ *        producer prefetch ahead of their position. Prefetching is off by
+ *        default: no measured run has shown it to help yet.
+ */
+#define QUEUE_PREFETCH 0
+
 /**
  * @brief A safe implementation of a Queue data structure. This data
  *        structure is based upon the Circular Buffer. It has a stateful
@@ -20,6 +33,15 @@ struct queue
   uint64_t a_end;
   uint64_t b_end;
   bool b_inuse;
+  bool mapped;
+  copy_fn copy_in;
+  copy_fn copy_out;
+  size_t prefetch;
+  struct trim_policy trim;
+  struct metrics *metrics;
+  struct histogram *latency;
+  uint64_t *stamps;
+  struct recorder *recorder;
 };
 
 /**
@@ -33,6 +55,28 @@ typedef struct queue queue_t;
  */
 queue_t *queue_new(const size_t cap, const size_t len);
 
+/**
+ * @brief Allocate a new Queue data structure whose buffer is committed
+ *        lazily by the operating system instead of being zeroed up front.
+ * @param cap The maximum capacity allow in the Queue data structure.
+ */
+queue_t *queue_new_lazy(const size_t cap, const size_t len);
+
+/**
+ * @brief Set up a Queue data structure over memory owned by the caller.
+ * @param self A pointer to the uninitialized Queue container.
+ * @param buffer A buffer of at least cap bytes.
+ * @param cap The maximum capacity allow in the Queue data structure.
+ */
+void queue_init(queue_t *self, void *buffer, const size_t cap, const size_t len);
+
+/**
+ * @brief Tear down a Queue set up by queue_init(). Do not pass such a Queue
+ *        to queue_destroy().
+ * @param self A pointer to the Queue container.
+ */
+void queue_fini(queue_t *self);
+
 /**
  * @brief Deallocate an existing Queue data structure from the heap.
  * @param self A double pointer to the Queue container.
@@ -67,6 +111,17 @@ bool queue_enqueue(queue_t *self, const void *item);
  */
 void *queue_dequeue(queue_t *self);
 
+/**
+ * @brief Remove up to max items from the front of the Queue data structure
+ *        into an array owned by the caller, prefetching upcoming items.
+ *        Pass the capacity of the Queue in items to drain it.
+ * @param self A pointer to the Queue container.
+ * @param items An array of at least max items of len bytes.
+ * @param max The maximum number of items to remove.
+ * @return The number of items removed.
+ */
+size_t queue_dequeue_batch(queue_t *self, void *items, const size_t max);
+
 /**
  * @brief Return the item at the front of the Queue data structure.
  * @param self A pointer to the Queue container.
@@ -88,4 +143,60 @@ size_t queue_size(queue_t *self);
  */
 bool queue_empty(queue_t *self);
 
+/**
+ * @brief Return the pages of the queue buffer that hold no items to the
+ *        operating system without reallocating the buffer.
+ * @param self A pointer to the Queue container.
+ * @return The number of bytes released.
+ */
+size_t queue_trim(queue_t *self);
+
+/**
+ * @brief Trim the Queue automatically once its occupancy has stayed at or
+ *        below a watermark for a number of consecutive dequeues.
+ * @param self A pointer to the Queue container.
+ * @param watermark The occupancy in bytes considered idle.
+ * @param period The number of idle dequeues before trimming, or zero to
+ *        disable automatic trimming.
+ */
+void queue_set_trim_policy(queue_t *self, const size_t watermark, const size_t period);
+
+/**
+ * @brief Copy the metrics of the Queue into a snapshot. The Queue keeps
+ *        metrics only when the library is built with TURNPIKE_METRICS.
+ * @param self A pointer to the Queue container.
+ * @param snapshot Receives the metrics of the Queue.
+ * @return Whether or not the Queue collects metrics.
+ */
+bool queue_metrics(queue_t *self, metrics_snapshot_t *snapshot);
+
+/**
+ * @brief Summarize how long items stayed in the Queue before they were
+ *        dequeued. The Queue records dwell-times only when the library is
+ *        built with TURNPIKE_LATENCY.
+ * @param self A pointer to the Queue container.
+ * @param snapshot Receives the p50, p99 and p999 dwell-times.
+ * @return Whether or not the Queue records dwell-times.
+ */
+bool queue_latency(queue_t *self, latency_snapshot_t *snapshot);
+
+/**
+ * @brief Record every enqueue, refused enqueue and dequeue of the Queue
+ *        to a recorder, for replay with bench/replay. The Queue does not
+ *        take ownership of the recorder.
+ * @param self A pointer to the Queue container.
+ * @param recorder The recorder, or NULL to stop recording.
+ */
+void queue_set_recorder(queue_t *self, recorder_t *recorder);
+
+/**
+ * @brief Set how many items ahead the batch consumer prefetches and the
+ *        producer prefetches for writing. The default is QUEUE_PREFETCH.
+ *        This knob is experimental; measure with bench_throughput -K
+ *        before turning it on.
+ * @param self A pointer to the Queue container.
+ * @param items The prefetch distance in items, or zero to disable.
+ */
+void queue_set_prefetch(queue_t *self, const size_t items);
+
 #endif/*TURNPIKE__QUEUE_H*/
@@ -0,0 +1,124 @@
+#ifndef TURNPIKE__RECORDER_H
+#define TURNPIKE__RECORDER_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * @brief The size of the buffer that events are collected in before they
+ *        are written to the file.
+ */
+#define RECORDER_BUFFER (64 * 1024)
+
+/**
+ * @brief The operations of a queue that are recorded. RECORDER_FULL is an
+ *        enqueue that was refused because the queue was full; it is still
+ *        an arrival and a replay tries it again.
+ */
+enum recorder_op
+{
+  RECORDER_ENQUEUE,
+  RECORDER_DEQUEUE,
+  RECORDER_FULL,
+  RECORDER_OPS,
+};
+
+/**
+ * @brief One recorded operation, with its time in nanoseconds since the
+ *        recording started and the size of the item in bytes.
+ */
+struct recorder_event
+{
+  uint64_t time;
+  uint32_t size;
+  uint8_t op;
+};
+
+/**
+ * @brief A recorder of the traffic through a queue. The file starts with
+ *        an eight byte header of the magic "TPRC" and a version number and
+ *        every event is stored as one byte for the operation followed by
+ *        the time since the previous event and the item size, both as
+ *        LEB128 varints, so that a typical event takes four to six bytes.
+ *        A recorder is not thread-safe: attach it to one queue only; the
+ *        locking queues log while they hold their lock.
+ */
+struct recorder
+{
+  FILE *fp;
+  uint64_t start;
+  uint64_t last;
+  uint64_t events;
+  size_t used;
+  uint8_t buffer[RECORDER_BUFFER];
+};
+
+/**
+ * @brief An alias for the recorder struct.
+ */
+typedef struct recorder recorder_t;
+
+/**
+ * @brief Allocate a new recorder to the heap and create its file.
+ * @param path The path of the file, which is truncated.
+ * @return The recorder, or NULL when the file could not be created.
+ */
+recorder_t *recorder_new(const char *path);
+
+/**
+ * @brief Flush and close the file of a recorder and deallocate it from the
+ *        heap. Detach it from its queue first.
+ * @param self A double pointer to the recorder.
+ */
+void __recorder_destroy(recorder_t **self);
+
+/**
+ * @brief Create a stack-pointer and pass it to recorder_destroy() so that
+ *        the recorder pointer in the caller knows it no longer exists.
+ * @param self A pointer to the recorder.
+ */
+#define recorder_destroy(self) __recorder_destroy(&self)
+
+/**
+ * @brief Append an event to a recorder.
+ * @param self A pointer to the recorder.
+ * @param op The operation that took place.
+ * @param size The size of the item in bytes.
+ */
+void recorder_log(recorder_t *self, const enum recorder_op op, const size_t size);
+
+/**
+ * @brief Write the buffered events of a recorder to its file.
+ * @return Whether or not every event was written.
+ */
+bool recorder_flush(recorder_t *self);
+
+/**
+ * @brief Read every event of a recording into memory.
+ * @param path The path of the file.
+ * @param count Receives the number of events.
+ * @return An array of events to be released with recorder_events_free(),
+ *         or NULL when the file could not be read or is not a recording.
+ */
+struct recorder_event *recorder_load(const char *path, size_t *count);
+
+/**
+ * @brief Release the events returned by recorder_load().
+ * @param events The array of events, or NULL.
+ */
+void recorder_events_free(struct recorder_event *events);
+
+/**
+ * @brief Log an event when a recorder is attached to the queue.
+ */
+static inline void recorder_record(recorder_t *self, const enum recorder_op op, const size_t size)
+{
+  if (self != NULL)
+  {
+    recorder_log(self, op, size);
+  }
+}
+
+#endif/*TURNPIKE__RECORDER_H*/
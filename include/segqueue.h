@@ -0,0 +1,120 @@
+#ifndef TURNPIKE__SEGQUEUE_H
+#define TURNPIKE__SEGQUEUE_H
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief The default number of drained segments a Queue keeps on its free
+ *        list before handing them back to the allocator.
+ */
+#define SEG_QUEUE_SPARE_SEGMENTS 8
+
+/**
+ * @brief A fixed-size ring segment. Segments are linked from the oldest
+ *        (head) to the newest (tail) and hold up to cap bytes of items.
+ */
+struct segment
+{
+  struct segment *next;
+  uint64_t r;
+  uint64_t w;
+  uint8_t data[];
+};
+
+/**
+ * @brief An unbounded implementation of a Queue data structure. Rather than
+ *        one large up-front buffer, the Queue is a linked list of fixed-size
+ *        segments. A new segment is appended when the tail segment is full
+ *        and a drained segment is recycled through a free list, so bursts
+ *        are absorbed without sizing the Queue for the worst case.
+ */
+struct seg_queue
+{
+  struct segment *head;
+  struct segment *tail;
+  struct segment *spare;
+  size_t cap;
+  size_t len;
+  size_t size;
+  size_t nspare;
+  size_t max_spare;
+  pthread_mutex_t lock;
+};
+
+/**
+ * @brief An alias for the Queue data struct.
+ */
+typedef struct seg_queue seg_queue_t;
+
+/**
+ * @brief Allocate a new Queue data structure to the heap.
+ * @param cap The capacity in bytes of every segment in the Queue.
+ * @param len The length in bytes of every item in the Queue.
+ */
+seg_queue_t *seg_queue_new(const size_t cap, const size_t len);
+
+/**
+ * @brief Deallocate an existing Queue data structure from the heap.
+ * @param self A double pointer to the Queue container.
+ */
+void __seg_queue_destroy(seg_queue_t **self);
+
+/**
+ * @brief Create a stack-pointer and pass it to seg_queue_destroy() so that
+ *        the queue pointer in the caller knows the queue no longer exists.
+ * @param self A pointer to the Queue container.
+ */
+#define seg_queue_destroy(self) __seg_queue_destroy(&self)
+
+/**
+ * @brief Add an item to the Queue data structure. The Queue grows by one
+ *        segment whenever the tail segment is full; running out of memory
+ *        for a segment exits the process like every other allocation in
+ *        turnpike, so this call never fails.
+ * @param self A pointer to the Queue container.
+ * @param data The item to be added to the Queue data structure.
+ * @return Always true. The return type matches the other Queues so that
+ *         callers can swap them.
+ */
+bool seg_queue_enqueue(seg_queue_t *self, const void *data);
+
+/**
+ * @brief Remove an item from the Queue data structure.
+ * @param self A pointer to the Queue container.
+ * @return The item currently removed from the front of the Queue.
+ */
+void *seg_queue_dequeue(seg_queue_t *self);
+
+/**
+ * @brief Return the item at the front of the Queue data structure.
+ * @param self A pointer to the Queue container.
+ * @return A copy of the item currently at the front of the Queue.
+ */
+void *seg_queue_peek(seg_queue_t *self);
+
+/**
+ * @brief Return the number of bytes currently in the Queue data structure.
+ * @param self A pointer to the Queue container.
+ * @return The current size of the Queue data structure.
+ */
+size_t seg_queue_size(seg_queue_t *self);
+
+/**
+ * @brief Determine of the Queue data structure is empty.
+ * @param self A pointer to the Queue container.
+ * @return Whether or not the Queue data structure is empty.
+ */
+bool seg_queue_empty(seg_queue_t *self);
+
+/**
+ * @brief Change the number of drained segments kept on the free list.
+ *        Segments beyond this limit are returned to the allocator.
+ * @param self A pointer to the Queue container.
+ * @param max_spare The maximum number of recycled segments to keep.
+ */
+void seg_queue_set_spare(seg_queue_t *self, const size_t max_spare);
+
+#endif/*TURNPIKE__SEGQUEUE_H*/
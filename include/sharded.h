@@ -0,0 +1,146 @@
+#ifndef TURNPIKE__SHARDED_H
+#define TURNPIKE__SHARDED_H
+
+#include "spsc.h"
+
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief The largest number of lanes a sharded queue may have.
+ */
+#define SHARDED_QUEUE_LANES 256
+
+/**
+ * @brief The number of queues whose lane a producer thread remembers at
+ *        once. A thread that produces into more queues than this may be
+ *        given a fresh lane when it comes back to one.
+ */
+#define SHARDED_QUEUE_CACHE 8
+
+/**
+ * @brief One lane of a sharded queue: an SPSC ring with a flag at each
+ *        end. A producer owns a lane while it holds the producer flag and a
+ *        consumer while it holds the consumer flag, so the ring only ever
+ *        sees one thread at each end. With no more producers than lanes the
+ *        producer flag is only ever taken by the same thread and stays in
+ *        its cache.
+ */
+struct sharded_lane
+{
+  _Alignas(64) atomic_bool producing;
+  spsc_queue_t *ring;
+
+  _Alignas(64) atomic_bool consuming;
+};
+
+/**
+ * @brief A multi-producer, multi-consumer Queue made of independent lanes.
+ *        Every producer thread is given the next lane of the Queue the
+ *        first time it enqueues into it, so that with no more producers
+ *        than lanes no two producers share a lane. Every consumer sweeps
+ *        the lanes round-robin from where it last left off, skipping lanes
+ *        that are empty or held by another consumer, and never takes a
+ *        lane of its own. Items from one producer stay in order; there is
+ *        no order across producers.
+ */
+struct sharded_queue
+{
+  size_t cap;
+  size_t len;
+  size_t lanes;
+  uint64_t id;
+  atomic_size_t producers;
+  struct sharded_lane *lane;
+};
+
+/**
+ * @brief An alias for the Queue data struct.
+ */
+typedef struct sharded_queue sharded_queue_t;
+
+/**
+ * @brief Allocate a new Queue data structure to the heap with one lane per
+ *        online CPU, or fewer when the capacity cannot give every lane an
+ *        item.
+ * @param cap The maximum capacity in bytes, divided evenly between lanes.
+ * @param len The length in bytes of every item in the Queue.
+ */
+sharded_queue_t *sharded_queue_new(const size_t cap, const size_t len);
+
+/**
+ * @brief Allocate a new Queue data structure to the heap.
+ * @param cap The maximum capacity in bytes, divided evenly between lanes.
+ * @param len The length in bytes of every item in the Queue.
+ * @param lanes The number of lanes, usually the number of producers.
+ */
+sharded_queue_t *sharded_queue_new_lanes(const size_t cap, const size_t len, const size_t lanes);
+
+/**
+ * @brief Deallocate an existing Queue data structure from the heap.
+ * @param self A double pointer to the Queue container.
+ */
+void __sharded_queue_destroy(sharded_queue_t **self);
+
+/**
+ * @brief Create a stack-pointer and pass it to sharded_queue_destroy() so
+ *        that the queue pointer in the caller knows the queue no longer
+ *        exists.
+ * @param self A pointer to the Queue container.
+ */
+#define sharded_queue_destroy(self) __sharded_queue_destroy(&self)
+
+/**
+ * @brief Add an item to the lane of the calling thread. A full lane makes
+ *        the enqueue fail even when other lanes have room.
+ * @param self A pointer to the Queue container.
+ * @param data The item to be added to the Queue data structure.
+ * @return Whether or not the item was added.
+ */
+bool sharded_queue_enqueue(sharded_queue_t *self, const void *data);
+
+/**
+ * @brief Add up to count items to the lane of the calling thread under a
+ *        single acquisition of its flag.
+ * @param self A pointer to the Queue container.
+ * @param items An array of count items of len bytes.
+ * @param count The number of items to add.
+ * @return The number of items added, from the front of items.
+ */
+size_t sharded_queue_enqueue_batch(sharded_queue_t *self, const void *items, const size_t count);
+
+/**
+ * @brief Remove an item from the next lane that has one.
+ * @param self A pointer to the Queue container.
+ * @return A copy of the item removed, or NULL when every lane was empty
+ *         or held by another consumer.
+ */
+void *sharded_queue_dequeue(sharded_queue_t *self);
+
+/**
+ * @brief Remove up to max items into an array owned by the caller. A lane
+ *        is drained as far as it goes before the sweep moves on, so that
+ *        the consumer reads each ring sequentially.
+ * @param self A pointer to the Queue container.
+ * @param items An array of at least max items of len bytes.
+ * @param max The maximum number of items to remove.
+ * @return The number of items removed.
+ */
+size_t sharded_queue_dequeue_batch(sharded_queue_t *self, void *items, const size_t max);
+
+/**
+ * @brief Return the number of bytes currently in the Queue data structure.
+ *        The answer may be stale by the time it is returned.
+ * @param self A pointer to the Queue container.
+ */
+size_t sharded_queue_size(sharded_queue_t *self);
+
+/**
+ * @brief Determine of the Queue data structure is empty.
+ * @param self A pointer to the Queue container.
+ */
+bool sharded_queue_empty(sharded_queue_t *self);
+
+#endif/*TURNPIKE__SHARDED_H*/
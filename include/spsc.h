@@ -0,0 +1,102 @@
+#ifndef TURNPIKE__SPSC_H
+#define TURNPIKE__SPSC_H
+
+#include "copy.h"
+
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief A single-producer, single-consumer implementation of a Queue data
+ *        structure. Exactly one thread may enqueue and exactly one other
+ *        thread may dequeue, which lets both sides run without a lock: the
+ *        producer only writes the tail, the consumer only writes the head,
+ *        and each keeps a private copy of the other's index so that it
+ *        only reads the shared cache line when its copy runs out. The head
+ *        and the tail live on separate cache lines.
+ */
+struct spsc_queue
+{
+  uint8_t *data;
+  size_t cap;
+  size_t len;
+  size_t slots;
+  copy_fn copy_in;
+  copy_fn copy_out;
+
+  _Alignas(64) atomic_size_t head;
+  size_t tail_cache;
+
+  _Alignas(64) atomic_size_t tail;
+  size_t head_cache;
+};
+
+/**
+ * @brief An alias for the Queue data struct.
+ */
+typedef struct spsc_queue spsc_queue_t;
+
+/**
+ * @brief Allocate a new Queue data structure to the heap.
+ * @param cap The maximum capacity allow in the Queue data structure.
+ * @param len The length in bytes of every item in the Queue.
+ */
+spsc_queue_t *spsc_queue_new(const size_t cap, const size_t len);
+
+/**
+ * @brief Deallocate an existing Queue data structure from the heap.
+ * @param self A double pointer to the Queue container.
+ */
+void __spsc_queue_destroy(spsc_queue_t **self);
+
+/**
+ * @brief Create a stack-pointer and pass it to spsc_queue_destroy() so
+ *        that the queue pointer in the caller knows the queue no longer
+ *        exists.
+ * @param self A pointer to the Queue container.
+ */
+#define spsc_queue_destroy(self) __spsc_queue_destroy(&self)
+
+/**
+ * @brief Add an item to the Queue data structure. Producer only.
+ * @param self A pointer to the Queue container.
+ * @param data The item to be added to the Queue data structure.
+ * @return Whether or not the item was added.
+ */
+bool spsc_queue_enqueue(spsc_queue_t *self, const void *data);
+
+/**
+ * @brief Remove the item at the front of the Queue data structure.
+ *        Consumer only.
+ * @param self A pointer to the Queue container.
+ * @return A copy of the item removed from the front of the Queue, or NULL
+ *         when the Queue is empty.
+ */
+void *spsc_queue_dequeue(spsc_queue_t *self);
+
+/**
+ * @brief Remove the item at the front of the Queue data structure into a
+ *        buffer owned by the caller, without allocating. Consumer only.
+ * @param self A pointer to the Queue container.
+ * @param data Receives the len bytes of the item.
+ * @return Whether or not an item was removed.
+ */
+bool spsc_queue_pop(spsc_queue_t *self, void *data);
+
+/**
+ * @brief Return the number of bytes currently in the Queue data structure.
+ * @param self A pointer to the Queue container.
+ * @return The current size of the Queue data structure.
+ */
+size_t spsc_queue_size(spsc_queue_t *self);
+
+/**
+ * @brief Determine of the Queue data structure is empty.
+ * @param self A pointer to the Queue container.
+ * @return Whether or not the Queue data structure is empty.
+ */
+bool spsc_queue_empty(spsc_queue_t *self);
+
+#endif/*TURNPIKE__SPSC_H*/
@@ -0,0 +1,51 @@
+#ifndef TURNPIKE__TRIM_H
+#define TURNPIKE__TRIM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief An automatic trim policy. A policy is armed once occupancy rises
+ *        above the watermark and fires after occupancy has stayed at or
+ *        below the watermark for period consecutive removals. A period of
+ *        zero disables the policy.
+ */
+struct trim_policy
+{
+  size_t watermark;
+  size_t period;
+  size_t ticks;
+  bool armed;
+};
+
+/**
+ * @brief Record the occupancy observed after a removal.
+ * @param self A pointer to the trim policy.
+ * @param used The number of bytes currently in use.
+ * @return Whether or not the owner should trim now.
+ */
+static inline bool trim_policy_tick(struct trim_policy *self, const size_t used)
+{
+  if (self->period == 0)
+  {
+    return false;
+  }
+
+  if (used > self->watermark)
+  {
+    self->ticks = 0;
+    self->armed = true;
+    return false;
+  }
+
+  if (false == self->armed || ++self->ticks < self->period)
+  {
+    return false;
+  }
+
+  self->ticks = 0;
+  self->armed = false;
+  return true;
+}
+
+#endif/*TURNPIKE__TRIM_H*/
@@ -1,6 +1,9 @@
 #ifndef TURNPIKE__THREAD_SAFE_QUEUE_H
 #define TURNPIKE__THREAD_SAFE_QUEUE_H
 
+#include "copy.h"
+#include "metrics.h"
+
 #include <inttypes.h>
 #include <stdatomic.h>
 #include <stdbool.h>
@@ -21,6 +24,10 @@ struct ts_queue
   atomic_ulong a_end;
   atomic_ulong b_end;
   atomic_bool b_inuse;
+  bool mapped;
+  copy_fn copy_in;
+  copy_fn copy_out;
+  struct metrics *metrics;
 };
 
 /**
@@ -34,6 +41,13 @@ typedef struct ts_queue ts_queue_t;
  */
 ts_queue_t *ts_queue_new(const size_t cap, const size_t len);
 
+/**
+ * @brief Allocate a new Queue data structure whose buffer is committed
+ *        lazily by the operating system instead of being zeroed up front.
+ * @param cap The maximum capacity allow in the Queue data structure.
+ */
+ts_queue_t *ts_queue_new_lazy(const size_t cap, const size_t len);
+
 /**
  * @brief Deallocate an existing Queue data structure from the heap.
  * @param self A double pointer to the Queue container.
@@ -89,4 +103,13 @@ size_t ts_queue_size(ts_queue_t *self);
  */
 bool ts_queue_empty(ts_queue_t *self);
 
+/**
+ * @brief Copy the metrics of the Queue into a snapshot. The Queue keeps
+ *        metrics only when the library is built with TURNPIKE_METRICS.
+ * @param self A pointer to the Queue container.
+ * @param snapshot Receives the metrics of the Queue.
+ * @return Whether or not the Queue collects metrics.
+ */
+bool ts_queue_metrics(ts_queue_t *self, metrics_snapshot_t *snapshot);
+
 #endif/*TURNPIKE__THREAD_SAFE_QUEUE_H*/
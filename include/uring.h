@@ -0,0 +1,134 @@
+#ifndef TURNPIKE__URING_H
+#define TURNPIKE__URING_H
+
+#include "bipbuf.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * @brief The default number of writes a sink keeps in flight.
+ */
+#define URING_SINK_DEPTH 32
+
+/**
+ * @brief The default size in bytes of the largest single write.
+ */
+#define URING_SINK_CHUNK (256 * 1024)
+
+/**
+ * @brief One write in flight, covering len bytes of the buffer that were
+ *        done bytes short of complete the last time the kernel answered.
+ */
+struct uring_write
+{
+  uint8_t *data;
+  uint64_t offset;
+  uint32_t len;
+  uint32_t done;
+};
+
+/**
+ * @brief An asynchronous drain of a bipbuf_t into a file through io_uring.
+ *        The memory of the buffer is registered with the kernel once, and
+ *        writes are issued straight from it with IORING_OP_WRITE_FIXED, so
+ *        the bytes are never copied and the pages are not pinned per write.
+ *        Bytes stay committed in the buffer while their write is in
+ *        flight and are released in order as completions arrive.
+ *
+ *        The sink and the buffer belong to one thread, which offers to the
+ *        buffer and calls uring_sink_submit() as it sees fit.
+ */
+struct uring_sink
+{
+  int ring;
+  int fd;
+  bipbuf_t *buffer;
+  uint64_t offset;
+  size_t inflight;
+  size_t chunk;
+  int error;
+
+  unsigned depth;
+  uint64_t head;
+  uint64_t tail;
+  unsigned outstanding;
+  unsigned unsubmitted;
+  struct uring_write *writes;
+
+  void *sq_ring;
+  size_t sq_ring_size;
+  void *cq_ring;
+  size_t cq_ring_size;
+  void *sqes;
+  size_t sqes_size;
+
+  unsigned *sq_head;
+  unsigned *sq_tail;
+  unsigned *sq_mask;
+  unsigned *sq_array;
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned *cq_mask;
+  void *cqes;
+};
+
+/**
+ * @brief An alias for the sink struct.
+ */
+typedef struct uring_sink uring_sink_t;
+
+/**
+ * @brief Set up an io_uring sink that drains a buffer into a file. Trimming
+ *        is switched off for the buffer: its pages are registered with the
+ *        kernel and must not be swapped for fresh ones underneath it.
+ * @param buffer The buffer to drain. It must outlive the sink.
+ * @param fd The file to write to.
+ * @param offset The position in the file of the first byte written.
+ * @param depth The number of writes to keep in flight, or zero for
+ *        URING_SINK_DEPTH.
+ * @return The sink, or NULL with errno set when io_uring is unavailable,
+ *         in which case bipbuf_write() is the fallback.
+ */
+uring_sink_t *uring_sink_new(bipbuf_t *buffer, const int fd, const uint64_t offset, const unsigned depth);
+
+/**
+ * @brief Wait for the writes in flight and tear the sink down.
+ * @param self A double pointer to the sink.
+ */
+void __uring_sink_destroy(uring_sink_t **self);
+
+/**
+ * @brief Create a stack-pointer and pass it to uring_sink_destroy() so that
+ *        the sink pointer in the caller knows it no longer exists.
+ * @param self A pointer to the sink.
+ */
+#define uring_sink_destroy(self) __uring_sink_destroy(&self)
+
+/**
+ * @brief Set the size in bytes of the largest single write.
+ */
+void uring_sink_set_chunk(uring_sink_t *self, const size_t chunk);
+
+/**
+ * @brief Reap the completions that have arrived, release the bytes of the
+ *        finished writes, and queue writes for the readable bytes not yet
+ *        in flight, all with at most one system call.
+ * @param self A pointer to the sink.
+ * @param wait Whether to block until at least one write completes when
+ *        any are in flight.
+ * @return The number of bytes released, or -1 with errno set when a write
+ *         failed. A failed sink stays failed.
+ */
+ssize_t uring_sink_submit(uring_sink_t *self, const bool wait);
+
+/**
+ * @brief Submit everything readable and wait until it is all written.
+ * @param self A pointer to the sink.
+ * @return Zero on success, or -1 with errno set when a write failed.
+ */
+int uring_sink_flush(uring_sink_t *self);
+
+#endif/*TURNPIKE__URING_H*/
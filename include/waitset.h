@@ -0,0 +1,122 @@
+#ifndef TURNPIKE__WAITSET_H
+#define TURNPIKE__WAITSET_H
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief The number of queues one word of the ready bitmap covers, and the
+ *        number of words the summary word covers.
+ */
+#define WAITSET_WORD 64
+
+/**
+ * @brief The greatest number of queues a wait set can hold.
+ */
+#define WAITSET_MAX (WAITSET_WORD * WAITSET_WORD)
+
+struct bipartite_queue;
+
+/**
+ * @brief A set of queues that one consumer can block on at once. Every
+ *        member owns a bit of a two-level ready bitmap: a producer sets the
+ *        bit of its queue and the bit of that word in the summary, so that
+ *        the consumer only visits the words, and the queues, that are
+ *        actually ready. The consumer sleeps on a futex word that producers
+ *        bump only when a queue turns ready while the consumer is asleep.
+ */
+struct waitset
+{
+  size_t cap;
+  atomic_ulong summary;
+  atomic_ulong *ready;
+  struct bipartite_queue **members;
+  pthread_mutex_t lock;
+  size_t next;
+
+  _Alignas(64) atomic_uint seq;
+  atomic_uint sleepers;
+};
+
+/**
+ * @brief An alias for the wait set struct.
+ */
+typedef struct waitset waitset_t;
+
+/**
+ * @brief Allocate a new, empty wait set to the heap.
+ * @param cap The greatest number of queues in the set, at most WAITSET_MAX.
+ */
+waitset_t *waitset_new(const size_t cap);
+
+/**
+ * @brief Deallocate an existing wait set from the heap. Queues still in
+ *        the set are removed from it first and may go on being used.
+ * @param self A double pointer to the wait set.
+ */
+void __waitset_destroy(waitset_t **self);
+
+/**
+ * @brief Create a stack-pointer and pass it to waitset_destroy() so that
+ *        the wait set pointer in the caller knows it no longer exists.
+ * @param self A pointer to the wait set.
+ */
+#define waitset_destroy(self) __waitset_destroy(&self)
+
+/**
+ * @brief Add a Queue to the wait set. A Queue belongs to at most one set.
+ *        A Queue that already holds items is reported ready at once.
+ * @param self A pointer to the wait set.
+ * @param queue A pointer to the Queue container.
+ * @return Whether or not the Queue was added.
+ */
+bool waitset_add(waitset_t *self, struct bipartite_queue *queue);
+
+/**
+ * @brief Remove a Queue from the wait set.
+ * @param self A pointer to the wait set.
+ * @param queue A pointer to the Queue container.
+ * @return Whether or not the Queue was a member.
+ */
+bool waitset_remove(waitset_t *self, struct bipartite_queue *queue);
+
+/**
+ * @brief Mark a member as ready and wake the consumer if it is asleep.
+ *        Called by the Queue after every enqueue, under its lock; a member
+ *        that is already marked costs a single load.
+ * @param self A pointer to the wait set, or NULL.
+ * @param slot The slot of the member.
+ */
+void waitset_signal(waitset_t *self, const size_t slot);
+
+/**
+ * @brief Mark a member as ready. Inlined into the enqueue path of the
+ *        Queue so that a Queue outside any set pays one branch.
+ */
+static inline void waitset_notify(waitset_t *self, const size_t slot)
+{
+  if (self != NULL)
+  {
+    waitset_signal(self, slot);
+  }
+}
+
+/**
+ * @brief Block until at least one member is ready, then return the ready
+ *        members. A member is reported once per wakeup and again only
+ *        after its next enqueue, so the caller should drain every Queue
+ *        it is given until it is empty.
+ * @param self A pointer to the wait set.
+ * @param ready Receives up to max ready Queues. Members that do not fit
+ *        stay ready for the next call.
+ * @param max The capacity of ready.
+ * @param timeout The longest time to block in milliseconds, zero to poll
+ *        or negative to block indefinitely.
+ * @return The number of Queues written to ready, zero on timeout.
+ */
+size_t waitset_wait(waitset_t *self, struct bipartite_queue **ready, const size_t max, const int timeout);
+
+#endif/*TURNPIKE__WAITSET_H*/
@@ -1,5 +1,6 @@
 #include "bipartite.h"
 #include "common.h"
+#include "probes.h"
 
 #include <pthread.h>
 #include <stdatomic.h>
@@ -8,6 +9,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
 
 /**
  * @brief Allocate the Queue container and the queue buffer to the heap.
@@ -15,26 +18,79 @@
  *       the wrapper functions specified in common.h. These functions
  *       deal with common problems like exception handling and fragmentation.
  */
-static bipartite_queue_t *bipartite_queue_alloc(const size_t cap)
+static bipartite_queue_t *bipartite_queue_alloc(const size_t cap, const bool lazy)
 {
   bipartite_queue_t *self = NULL;
   self = (bipartite_queue_t *)_calloc(1, sizeof(*self));
-  self->data = (uint8_t *)_calloc(cap, sizeof(*self->data));
+
+  if (true == lazy)
+  {
+    self->data = (uint8_t *)_map(cap * sizeof(*self->data));
+    self->mapped = true;
+  }
+  else
+  {
+    self->data = (uint8_t *)_calloc(cap, sizeof(*self->data));
+  }
+
   return self;
 }
 
 /**
- * @brief Allocate a new Queue data structure to the heap. Do not allocate
- *        the queue properties here. Queue properties are allocated in
- *        queue_alloc() refer to it for more information. With that, this
- *        function sets up the Queue for usage.
- * @param cap The maximum capacity allow in the Queue data structure.
+ * @brief Lock the Queue on behalf of an operation. When the library is
+ *        built with TURNPIKE_LOCK_PROFILE, the wait for the lock is
+ *        recorded against the operation.
  */
-bipartite_queue_t *bipartite_queue_new(const size_t cap, const size_t len)
+static inline void always_inline __bipartite_queue_lock(bipartite_queue_t *self, const enum lock_profile_op op)
 {
-  bipartite_queue_t *self = NULL;
-  self = bipartite_queue_alloc(cap);
+  if (lock_profile_acquire(self->profile, &self->lock, op, self) != 0)
+  {
+    fprintf(stderr, "%s(): %s\n", __func__, "could not lock mutex");
+    exit(EXIT_FAILURE);
+  }
+}
 
+/**
+ * @brief Unlock the Queue on behalf of an operation, recording how long the
+ *        operation held the lock when the Queue is profiled.
+ */
+static inline void always_inline __bipartite_queue_unlock(bipartite_queue_t *self, const enum lock_profile_op op)
+{
+  if (lock_profile_release(self->profile, &self->lock, op) != 0)
+  {
+    fprintf(stderr, "%s(): %s\n", __func__, "could not unlock mutex");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/**
+ * @brief Wake a consumer waiting on the descriptor of the Queue. Only the
+ *        first producer to see the waiting flag writes, so a burst of
+ *        enqueues costs one system call. The flag is read after the write
+ *        index was advanced, which pairs with bipartite_queue_arm() setting
+ *        the flag before it reads the write index, so a wakeup is never
+ *        lost.
+ */
+static inline void always_inline __bipartite_queue_notify(bipartite_queue_t *self)
+{
+  if (true == atomic_load(&self->waiting) && true == atomic_exchange(&self->waiting, false))
+  {
+    const uint64_t one = 1;
+
+    if (write(self->fd, &one, sizeof(one)) < 0)
+    {
+      // The counter can only overflow after 2^64 - 2 wakeups; the
+      // descriptor is readable either way.
+    }
+  }
+}
+
+/**
+ * @brief Set up the properties of a Queue whose buffer is already in place.
+ * @param cap The maximum capacity allow in the Queue data structure.
+ */
+static void bipartite_queue_setup(bipartite_queue_t *self, const size_t cap, const size_t len)
+{
   if (pthread_mutex_init(&self->lock, NULL) < 0)
   {
     fprintf(stderr, "%s(): %s\n", __func__, "could not init mutex lock");
@@ -43,13 +99,111 @@ bipartite_queue_t *bipartite_queue_new(const size_t cap, const size_t len)
 
   atomic_init(&self->r, 0UL);
   atomic_init(&self->w, 0UL);
+  atomic_init(&self->waiting, false);
+
+  self->fd = -1;
+  self->waitset = NULL;
+  self->slot = 0;
 
   self->cap = cap;
   self->len = len;
+  self->copy_in = copy_select(len, true);
+  self->copy_out = copy_select(len, false);
+  self->prefetch = BIPARTITE_QUEUE_PREFETCH;
+  self->metrics = metrics_attach();
+  self->profile = lock_profile_attach();
+  self->latency = latency_attach();
+
+  if (self->latency != NULL)
+  {
+    self->stamps = (uint64_t *)_calloc(((cap / len) + 1), sizeof(*self->stamps));
+  }
+}
+
+/**
+ * @brief Allocate a new Queue data structure to the heap. Do not allocate
+ *        the queue properties here. Queue properties are allocated in
+ *        queue_alloc() refer to it for more information. With that, this
+ *        function sets up the Queue for usage.
+ * @param cap The maximum capacity allow in the Queue data structure.
+ */
+bipartite_queue_t *bipartite_queue_new(const size_t cap, const size_t len)
+{
+  bipartite_queue_t *self = NULL;
+  self = bipartite_queue_alloc(cap, false);
+  bipartite_queue_setup(self, cap, len);
+  return self;
+}
 
+/**
+ * @brief Allocate a new Queue data structure whose buffer is mapped rather
+ *        than allocated and zeroed. Creation is constant time in cap and
+ *        buffer pages are only committed when the Queue first writes them.
+ * @param cap The maximum capacity allow in the Queue data structure.
+ */
+bipartite_queue_t *bipartite_queue_new_lazy(const size_t cap, const size_t len)
+{
+  bipartite_queue_t *self = NULL;
+  self = bipartite_queue_alloc(cap, true);
+  bipartite_queue_setup(self, cap, len);
   return self;
 }
 
+/**
+ * @brief Set up a Queue data structure over memory owned by the caller.
+ *        Neither the container nor the buffer is allocated, so the Queue
+ *        may live in static, stack or arena memory of this process, and
+ *        the buffer may directly follow the container in one allocation.
+ *        It cannot be shared between processes: the lock is private to
+ *        the process, the buffer is referenced by absolute address and the
+ *        instrumentation lives on the heap.
+ * @param self A pointer to the uninitialized Queue container.
+ * @param buffer A buffer of at least cap bytes.
+ * @param cap The maximum capacity allow in the Queue data structure.
+ */
+void bipartite_queue_init(bipartite_queue_t *self, void *buffer, const size_t cap, const size_t len)
+{
+  if (self == NULL || buffer == NULL)
+  {
+    fprintf(stderr, "%s(): %s\n", __func__, "queue instance and buffer may not be null");
+    exit(EXIT_FAILURE);
+  }
+
+  memset(self, 0, sizeof(*self));
+  self->data = (uint8_t *)buffer;
+  bipartite_queue_setup(self, cap, len);
+}
+
+/**
+ * @brief Tear down a Queue set up by bipartite_queue_init(). The container
+ *        and the buffer remain owned by the caller.
+ * @param self A pointer to the Queue container.
+ */
+void bipartite_queue_fini(bipartite_queue_t *self)
+{
+  if (self == NULL)
+  {
+    return;
+  }
+
+  if (self->waitset != NULL)
+  {
+    waitset_remove(self->waitset, self);
+  }
+
+  if (self->fd >= 0)
+  {
+    close(self->fd);
+  }
+
+  pthread_mutex_destroy(&self->lock);
+  metrics_destroy(self->metrics);
+  lock_profile_destroy(self->profile);
+  histogram_destroy(self->latency);
+  __free(self->stamps);
+  self->data = NULL;
+}
+
 /**
  * @brief Deallocate an existing Queue data structure from the heap.
  * @param self A double pointer to the Queue container.
@@ -58,7 +212,27 @@ void __bipartite_queue_destroy(bipartite_queue_t **self)
 {
   if (self != NULL && *self != NULL)
   {
-    __free((*self)->data);
+    if ((*self)->waitset != NULL)
+    {
+      waitset_remove((*self)->waitset, *self);
+    }
+
+    if (true == (*self)->mapped)
+    {
+      _unmap((*self)->data, (*self)->cap);
+    }
+    else
+    {
+      __free((*self)->data);
+    }
+    if ((*self)->fd >= 0)
+    {
+      close((*self)->fd);
+    }
+    metrics_destroy((*self)->metrics);
+    lock_profile_destroy((*self)->profile);
+    histogram_destroy((*self)->latency);
+    __free((*self)->stamps);
     ___free(*self);
     *self = NULL;
   }
@@ -84,11 +258,7 @@ bool bipartite_queue_enqueue(bipartite_queue_t *self, const void *data)
     exit(EXIT_FAILURE);
   }
 
-  if (pthread_mutex_lock(&self->lock) < 0)
-  {
-    fprintf(stderr, "%s(): %s\n", __func__, "could not lock mutex");
-    exit(EXIT_FAILURE);
-  }
+  __bipartite_queue_lock(self, LOCK_PROFILE_ENQUEUE);
 
   const uint64_t r = atomic_load(&self->r);
   const uint64_t w = atomic_fetch_add(&self->w, self->len);
@@ -96,27 +266,107 @@ bool bipartite_queue_enqueue(bipartite_queue_t *self, const void *data)
   if ((w - r) >= self->cap)
   {
     atomic_exchange(&self->w, w);
+    recorder_record(self->recorder, RECORDER_FULL, self->len);
 
-    if (pthread_mutex_unlock(&self->lock) < 0)
-    {
-      fprintf(stderr, "%s(): %s\n", __func__, "could not unlock mutex");
-      exit(EXIT_FAILURE);
-    }
+    __bipartite_queue_unlock(self, LOCK_PROFILE_ENQUEUE);
 
+    TURNPIKE_PROBE3(bipartite_enqueue_full, self, (w - r), self->len);
+    metrics_record(self->metrics, METRICS_FULL, (w - r));
     return false;
   }
 
-  memcpy((self->data + (w % self->cap)), data, self->len * sizeof(*self->data));
+  self->copy_in((self->data + (w % self->cap)), data, self->len);
+  latency_stamp(self->stamps, ((w % self->cap) / self->len));
+  recorder_record(self->recorder, RECORDER_ENQUEUE, self->len);
 
-  if (pthread_mutex_unlock(&self->lock) < 0)
+  if (self->prefetch != 0)
   {
-    fprintf(stderr, "%s(): %s\n", __func__, "could not unlock mutex");
-    exit(EXIT_FAILURE);
+    __builtin_prefetch((self->data + ((w + ((self->prefetch + 1) * self->len)) % self->cap)), 1, 3);
   }
 
+  // The wait set is signalled under the lock: waitset_remove() takes the
+  // lock to detach the Queue, so the set cannot be freed underneath.
+  waitset_notify(self->waitset, self->slot);
+
+  __bipartite_queue_unlock(self, LOCK_PROFILE_ENQUEUE);
+
+  __bipartite_queue_notify(self);
+
+  TURNPIKE_PROBE3(bipartite_enqueue, self, (w + self->len - r), self->len);
+  metrics_record(self->metrics, METRICS_ENQUEUE, (w + self->len - r));
   return true;
 }
 
+/**
+ * @brief Add up to count items to the Queue data structure under a single
+ *        acquisition of the lock. Waiters are notified once per batch.
+ * @param self A pointer to the Queue container.
+ * @param items An array of count items of len bytes.
+ * @param count The number of items to add.
+ * @return The number of items added, from the front of items.
+ */
+size_t bipartite_queue_enqueue_batch(bipartite_queue_t *self, const void *items, const size_t count)
+{
+  if (self == NULL || items == NULL)
+  {
+    fprintf(stderr, "%s(): %s\n", __func__, "queue instance and items may not be null");
+    exit(EXIT_FAILURE);
+  }
+
+  __bipartite_queue_lock(self, LOCK_PROFILE_ENQUEUE);
+
+  const uint64_t r = atomic_load(&self->r);
+  const uint64_t w = atomic_load(&self->w);
+
+  const size_t room = (size_t)((self->cap - (w - r)) / self->len);
+  const size_t n = (room < count) ? room : count;
+
+  const uint8_t *in = (const uint8_t *)items;
+  size_t i;
+
+  for (i = 0; i < n; i++)
+  {
+    const uint64_t at = w + (i * self->len);
+
+    self->copy_in((self->data + (at % self->cap)), (in + (i * self->len)), self->len);
+    latency_stamp(self->stamps, ((at % self->cap) / self->len));
+    recorder_record(self->recorder, RECORDER_ENQUEUE, self->len);
+  }
+
+  if (n < count)
+  {
+    recorder_record(self->recorder, RECORDER_FULL, self->len);
+  }
+
+  atomic_store(&self->w, w + (n * self->len));
+
+  if (n != 0)
+  {
+    waitset_notify(self->waitset, self->slot);
+  }
+
+  __bipartite_queue_unlock(self, LOCK_PROFILE_ENQUEUE);
+
+  if (n != 0)
+  {
+    __bipartite_queue_notify(self);
+  }
+
+  for (i = 1; i <= n; i++)
+  {
+    TURNPIKE_PROBE3(bipartite_enqueue, self, (w - r + (i * self->len)), self->len);
+    metrics_record(self->metrics, METRICS_ENQUEUE, (w - r + (i * self->len)));
+  }
+
+  if (n < count)
+  {
+    TURNPIKE_PROBE3(bipartite_enqueue_full, self, (w - r + (n * self->len)), self->len);
+    metrics_record(self->metrics, METRICS_FULL, (w - r + (n * self->len)));
+  }
+
+  return n;
+}
+
 /**
  * @brief Remove an item from the Queue data structure.
  * @param self A pointer to the Queue container.
@@ -130,11 +380,7 @@ void *bipartite_queue_dequeue(bipartite_queue_t *self)
     exit(EXIT_FAILURE);
   }
 
-  if (pthread_mutex_lock(&self->lock) < 0)
-  {
-    fprintf(stderr, "%s(): %s\n", __func__, "could not lock mutex");
-    exit(EXIT_FAILURE);
-  }
+  __bipartite_queue_lock(self, LOCK_PROFILE_DEQUEUE);
 
   const uint64_t w = atomic_load(&self->w);
   const uint64_t r = atomic_fetch_add(&self->r, self->len);
@@ -143,27 +389,88 @@ void *bipartite_queue_dequeue(bipartite_queue_t *self)
   {
     atomic_exchange(&self->r, r);
 
-    if (pthread_mutex_unlock(&self->lock) < 0)
-    {
-      fprintf(stderr, "%s(): %s\n", __func__, "could not unlock mutex");
-      exit(EXIT_FAILURE);
-    }
+    __bipartite_queue_unlock(self, LOCK_PROFILE_DEQUEUE);
 
+    metrics_record(self->metrics, METRICS_EMPTY, 0);
     return NULL;
   }
 
   void *item = NULL;
   item = calloc(self->len, sizeof(*item));
 
-  memcpy(item, (self->data + (r % self->cap)), self->len * sizeof(*self->data));
+  self->copy_out(item, (self->data + (r % self->cap)), self->len);
+  latency_record(self->latency, self->stamps, ((r % self->cap) / self->len));
+  recorder_record(self->recorder, RECORDER_DEQUEUE, self->len);
+
+  __bipartite_queue_unlock(self, LOCK_PROFILE_DEQUEUE);
+
+  TURNPIKE_PROBE3(bipartite_dequeue, self, (w - r - self->len), self->len);
+  metrics_record(self->metrics, METRICS_DEQUEUE, (w - r - self->len));
+  return item;
+}
 
-  if (pthread_mutex_unlock(&self->lock) < 0)
+/**
+ * @brief Remove up to max items from the front of the Queue data structure
+ *        into an array owned by the caller, under a single acquisition of
+ *        the lock. With a prefetch distance set, the consumer prefetches
+ *        that many slots ahead while it copies, in the hope of overlapping
+ *        the misses of a backlog larger than the cache.
+ * @param self A pointer to the Queue container.
+ * @param items An array of at least max items of len bytes.
+ * @param max The maximum number of items to remove.
+ * @return The number of items removed.
+ */
+size_t bipartite_queue_dequeue_batch(bipartite_queue_t *self, void *items, const size_t max)
+{
+  if (self == NULL || items == NULL)
   {
-    fprintf(stderr, "%s(): %s\n", __func__, "could not unlock mutex");
+    fprintf(stderr, "%s(): %s\n", __func__, "queue instance and items may not be null");
     exit(EXIT_FAILURE);
   }
 
-  return item;
+  __bipartite_queue_lock(self, LOCK_PROFILE_DEQUEUE);
+
+  const uint64_t w = atomic_load(&self->w);
+  const uint64_t r = atomic_load(&self->r);
+
+  const size_t available = (size_t)((w - r) / self->len);
+  const size_t n = (available < max) ? available : max;
+  const size_t ahead = self->prefetch * self->len;
+
+  uint8_t *out = (uint8_t *)items;
+  size_t i;
+
+  for (i = 0; i < n; i++)
+  {
+    const uint64_t at = r + (i * self->len);
+
+    if (ahead != 0 && (i + self->prefetch) < n)
+    {
+      __builtin_prefetch((self->data + ((at + ahead) % self->cap)), 0, 0);
+    }
+
+    self->copy_out((out + (i * self->len)), (self->data + (at % self->cap)), self->len);
+    latency_record(self->latency, self->stamps, ((at % self->cap) / self->len));
+    recorder_record(self->recorder, RECORDER_DEQUEUE, self->len);
+  }
+
+  atomic_store(&self->r, r + (n * self->len));
+
+  __bipartite_queue_unlock(self, LOCK_PROFILE_DEQUEUE);
+
+  if (n == 0)
+  {
+    metrics_record(self->metrics, METRICS_EMPTY, 0);
+    return 0;
+  }
+
+  for (i = 1; i <= n; i++)
+  {
+    TURNPIKE_PROBE3(bipartite_dequeue, self, (w - r - (i * self->len)), self->len);
+    metrics_record(self->metrics, METRICS_DEQUEUE, (w - r - (i * self->len)));
+  }
+
+  return n;
 }
 
 /**
@@ -179,22 +486,14 @@ void *bipartite_queue_peek(bipartite_queue_t *self)
     exit(EXIT_FAILURE);
   }
 
-  if (pthread_mutex_lock(&self->lock) < 0)
-  {
-    fprintf(stderr, "%s(): %s\n", __func__, "could not lock mutex");
-    exit(EXIT_FAILURE);
-  }
+  __bipartite_queue_lock(self, LOCK_PROFILE_PEEK);
 
   const uint64_t w = atomic_load(&self->w);
   const uint64_t r = atomic_load(&self->r);
 
   if (r == w)
   {
-    if (pthread_mutex_unlock(&self->lock) < 0)
-    {
-      fprintf(stderr, "%s(): %s\n", __func__, "could not unlock mutex");
-      exit(EXIT_FAILURE);
-    }
+    __bipartite_queue_unlock(self, LOCK_PROFILE_PEEK);
 
     return NULL;
   }
@@ -202,13 +501,9 @@ void *bipartite_queue_peek(bipartite_queue_t *self)
   void *item = NULL;
   item = calloc(self->len, sizeof(*item));
 
-  memcpy(item, (self->data + (r % self->cap)), self->len * sizeof(*self->data));
+  self->copy_out(item, (self->data + (r % self->cap)), self->len);
 
-  if (pthread_mutex_unlock(&self->lock) < 0)
-  {
-    fprintf(stderr, "%s(): %s\n", __func__, "could not unlock mutex");
-    exit(EXIT_FAILURE);
-  }
+  __bipartite_queue_unlock(self, LOCK_PROFILE_PEEK);
 
   return item;
 }
@@ -226,30 +521,131 @@ size_t bipartite_queue_size(bipartite_queue_t *self)
     exit(EXIT_FAILURE);
   }
 
-  if (pthread_mutex_lock(&self->lock) < 0)
+  __bipartite_queue_lock(self, LOCK_PROFILE_SIZE);
+
+  const uint64_t w = atomic_load(&self->w);
+  const uint64_t r = atomic_load(&self->r);
+
+  __bipartite_queue_unlock(self, LOCK_PROFILE_SIZE);
+
+  return (w - r);
+}
+
+/**
+ * @brief Determine of the Queue data structure is empty.
+ * @param self A pointer to the Queue container.
+ * @return Whether or not the Queue data structure is empty.
+ */
+bool bipartite_queue_empty(bipartite_queue_t *self)
+{
+  if (self == NULL)
   {
-    fprintf(stderr, "%s(): %s\n", __func__, "could not lock mutex");
+    fprintf(stderr, "%s(): %s\n", __func__, "queue instance may not be null");
     exit(EXIT_FAILURE);
   }
 
+  __bipartite_queue_lock(self, LOCK_PROFILE_EMPTY);
+
   const uint64_t w = atomic_load(&self->w);
   const uint64_t r = atomic_load(&self->r);
 
-  if (pthread_mutex_unlock(&self->lock) < 0)
+  __bipartite_queue_unlock(self, LOCK_PROFILE_EMPTY);
+
+  // Do not call the forward facing queue_size() method here.
+  // That method adds redundant overhead to this method call.
+  return 0UL == (w - r);
+}
+
+/**
+ * @brief Copy the metrics of the Queue into a snapshot. The Queue keeps
+ *        metrics only when the library is built with TURNPIKE_METRICS.
+ * @param self A pointer to the Queue container.
+ * @param snapshot Receives the metrics of the Queue.
+ * @return Whether or not the Queue collects metrics.
+ */
+bool bipartite_queue_metrics(bipartite_queue_t *self, metrics_snapshot_t *snapshot)
+{
+  if (self == NULL)
+  {
+    fprintf(stderr, "%s(): %s\n", __func__, "queue instance may not be null");
+    exit(EXIT_FAILURE);
+  }
+
+  return metrics_snapshot(self->metrics, snapshot);
+}
+
+/**
+ * @brief Summarize how long items stayed in the Queue before they were
+ *        dequeued. The Queue records dwell-times only when the library is
+ *        built with TURNPIKE_LATENCY.
+ * @param self A pointer to the Queue container.
+ * @param snapshot Receives the p50, p99 and p999 dwell-times.
+ * @return Whether or not the Queue records dwell-times.
+ */
+bool bipartite_queue_latency(bipartite_queue_t *self, latency_snapshot_t *snapshot)
+{
+  if (self == NULL)
+  {
+    fprintf(stderr, "%s(): %s\n", __func__, "queue instance may not be null");
+    exit(EXIT_FAILURE);
+  }
+
+  return histogram_latency(self->latency, snapshot);
+}
+
+/**
+ * @brief Copy the lock contention profile of the Queue. The Queue is
+ *        profiled only when the library is built with TURNPIKE_LOCK_PROFILE.
+ *        The copy is taken under the lock, outside of the profile.
+ * @param self A pointer to the Queue container.
+ * @param snapshot Receives the lock profile of the Queue.
+ * @return Whether or not the Queue is profiled.
+ */
+bool bipartite_queue_lock_profile(bipartite_queue_t *self, lock_profile_t *snapshot)
+{
+  if (self == NULL)
+  {
+    fprintf(stderr, "%s(): %s\n", __func__, "queue instance may not be null");
+    exit(EXIT_FAILURE);
+  }
+
+  if (snapshot == NULL)
+  {
+    return false;
+  }
+
+  memset(snapshot, 0, sizeof(*snapshot));
+
+  if (self->profile == NULL)
+  {
+    return false;
+  }
+
+  if (pthread_mutex_lock(&self->lock) != 0)
+  {
+    fprintf(stderr, "%s(): %s\n", __func__, "could not lock mutex");
+    exit(EXIT_FAILURE);
+  }
+
+  memcpy(snapshot, self->profile, sizeof(*snapshot));
+
+  if (pthread_mutex_unlock(&self->lock) != 0)
   {
     fprintf(stderr, "%s(): %s\n", __func__, "could not unlock mutex");
     exit(EXIT_FAILURE);
   }
 
-  return (w - r);
+  return true;
 }
 
 /**
- * @brief Determine of the Queue data structure is empty.
+ * @brief Record every enqueue, refused enqueue and dequeue of the Queue
+ *        to a recorder. The recorder is swapped under the lock so that no
+ *        operation is logged to a recorder that was just detached.
  * @param self A pointer to the Queue container.
- * @return Whether or not the Queue data structure is empty.
+ * @param recorder The recorder, or NULL to stop recording.
  */
-bool bipartite_queue_empty(bipartite_queue_t *self)
+void bipartite_queue_set_recorder(bipartite_queue_t *self, recorder_t *recorder)
 {
   if (self == NULL)
   {
@@ -257,22 +653,114 @@ bool bipartite_queue_empty(bipartite_queue_t *self)
     exit(EXIT_FAILURE);
   }
 
-  if (pthread_mutex_lock(&self->lock) < 0)
+  if (pthread_mutex_lock(&self->lock) != 0)
   {
     fprintf(stderr, "%s(): %s\n", __func__, "could not lock mutex");
     exit(EXIT_FAILURE);
   }
 
-  const uint64_t w = atomic_load(&self->w);
-  const uint64_t r = atomic_load(&self->r);
+  self->recorder = recorder;
 
-  if (pthread_mutex_unlock(&self->lock) < 0)
+  if (pthread_mutex_unlock(&self->lock) != 0)
   {
     fprintf(stderr, "%s(): %s\n", __func__, "could not unlock mutex");
     exit(EXIT_FAILURE);
   }
+}
 
-  // Do not call the forward facing queue_size() method here.
-  // That method adds redundant overhead to this method call.
-  return 0UL == (w - r);
+/**
+ * @brief Set how many items ahead the batch consumer prefetches and the
+ *        producer prefetches for writing.
+ * @param self A pointer to the Queue container.
+ * @param items The prefetch distance in items, or zero to disable.
+ */
+void bipartite_queue_set_prefetch(bipartite_queue_t *self, const size_t items)
+{
+  if (self == NULL)
+  {
+    fprintf(stderr, "%s(): %s\n", __func__, "queue instance may not be null");
+    exit(EXIT_FAILURE);
+  }
+
+  self->prefetch = items;
+}
+
+/**
+ * @brief Return an eventfd that becomes readable when an item is enqueued
+ *        while the consumer is waiting. The descriptor is created on the
+ *        first call and closed with the Queue.
+ * @param self A pointer to the Queue container.
+ * @return The file descriptor.
+ */
+int bipartite_queue_fd(bipartite_queue_t *self)
+{
+  if (self == NULL)
+  {
+    fprintf(stderr, "%s(): %s\n", __func__, "queue instance may not be null");
+    exit(EXIT_FAILURE);
+  }
+
+  if (pthread_mutex_lock(&self->lock) != 0)
+  {
+    fprintf(stderr, "%s(): %s\n", __func__, "could not lock mutex");
+    exit(EXIT_FAILURE);
+  }
+
+  if (self->fd < 0 && (self->fd = eventfd(0, (EFD_NONBLOCK | EFD_CLOEXEC))) < 0)
+  {
+    fprintf(stderr, "%s(): %s\n", __func__, "could not create eventfd");
+    exit(EXIT_FAILURE);
+  }
+
+  const int fd = self->fd;
+
+  if (pthread_mutex_unlock(&self->lock) != 0)
+  {
+    fprintf(stderr, "%s(): %s\n", __func__, "could not unlock mutex");
+    exit(EXIT_FAILURE);
+  }
+
+  return fd;
+}
+
+/**
+ * @brief Announce that the consumer is about to wait on the descriptor of
+ *        the Queue. The descriptor is reset first, so that it only becomes
+ *        readable again on the next enqueue. The waiting flag is set before
+ *        the write index is read; a producer that advanced the write index
+ *        without seeing the flag is seen here instead.
+ * @param self A pointer to the Queue container.
+ * @return True when the Queue is empty and the consumer may wait, false
+ *         when items are already available.
+ */
+bool bipartite_queue_arm(bipartite_queue_t *self)
+{
+  if (self == NULL)
+  {
+    fprintf(stderr, "%s(): %s\n", __func__, "queue instance may not be null");
+    exit(EXIT_FAILURE);
+  }
+
+  if (self->fd < 0)
+  {
+    fprintf(stderr, "%s(): %s\n", __func__, "queue has no descriptor, call bipartite_queue_fd() first");
+    exit(EXIT_FAILURE);
+  }
+
+  uint64_t count = 0;
+
+  if (read(self->fd, &count, sizeof(count)) < 0)
+  {
+    // EAGAIN: the descriptor was not readable.
+  }
+
+  atomic_store(&self->waiting, true);
+
+  if (atomic_load(&self->w) > atomic_load(&self->r))
+  {
+    atomic_store(&self->waiting, false);
+    return false;
+  }
+
+  return true;
 }
@@ -1,11 +1,14 @@
 #include "bipbuf.h"
 #include "common.h"
+#include "probes.h"
 
+#include <errno.h>
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/uio.h>
 
 bipbuf_t *bipbuf_new(const size_t cap)
 {
@@ -13,14 +16,59 @@ bipbuf_t *bipbuf_new(const size_t cap)
   self = (bipbuf_t *)_calloc(1, sizeof(*self));
   self->data = (uint8_t *)_calloc(cap, sizeof(*self->data));
   self->cap = cap;
+  self->metrics = metrics_attach();
   return self;
 }
 
+bipbuf_t *bipbuf_new_lazy(const size_t cap)
+{
+  bipbuf_t *self = NULL;
+  self = (bipbuf_t *)_calloc(1, sizeof(*self));
+  self->data = (uint8_t *)_map(cap * sizeof(*self->data));
+  self->cap = cap;
+  self->mapped = true;
+  self->metrics = metrics_attach();
+  return self;
+}
+
+bool bipbuf_init(bipbuf_t *self, void *buffer, const size_t cap)
+{
+  if (self == NULL || buffer == NULL)
+  {
+    return false;
+  }
+
+  memset(self, 0, sizeof(*self));
+  self->data = (uint8_t *)buffer;
+  self->cap = cap;
+  self->metrics = metrics_attach();
+  return true;
+}
+
+void bipbuf_fini(bipbuf_t *self)
+{
+  if (self == NULL)
+  {
+    return;
+  }
+
+  metrics_destroy(self->metrics);
+  self->data = NULL;
+}
+
 void __bipbuf_destroy(bipbuf_t **self)
 {
   if (self != NULL && *self != NULL)
   {
-    __free((*self)->data);
+    if (true == (*self)->mapped)
+    {
+      _unmap((*self)->data, (*self)->cap);
+    }
+    else
+    {
+      __free((*self)->data);
+    }
+    metrics_destroy((*self)->metrics);
     ___free(*self);
     *self = NULL;
   }
@@ -65,10 +113,75 @@ static void bipbuf_try_switch_to_b(bipbuf_t *self)
 {
   if ((self->cap - self->a_end) < (self->a_start - self->b_end))
   {
+    if (false == self->b_inuse)
+    {
+      TURNPIKE_PROBE2(bipbuf_switch_to_b, self, bipbuf_used(self));
+    }
+
     self->b_inuse = true;
   }
 }
 
+/**
+ * @brief Release size bytes from the front of the buffer. When region A
+ *        runs dry, region B becomes the new region A and the rest of size
+ *        is released from it.
+ */
+static void bipbuf_decommit(bipbuf_t *self, size_t size)
+{
+  while (size != 0 && self->a_start != self->a_end)
+  {
+    const size_t n = ((self->a_end - self->a_start) < size) ? (self->a_end - self->a_start) : size;
+
+    self->a_start += n;
+    size -= n;
+
+    if (self->a_start == self->a_end)
+    {
+      if (true == self->b_inuse)
+      {
+        self->a_start = 0;
+        self->a_end = self->b_end;
+        self->b_end = 0;
+        self->b_inuse = false;
+      }
+      else
+      {
+        self->a_start = 0;
+        self->a_end = 0;
+      }
+    }
+  }
+
+  bipbuf_try_switch_to_b(self);
+}
+
+/**
+ * @brief Claim size bytes that were written straight into the free space
+ *        of the buffer. Without region B, the free space is the end of
+ *        the buffer followed by its start, and bytes that spilled past
+ *        the end open region B.
+ */
+static void bipbuf_commit(bipbuf_t *self, const size_t size)
+{
+  if (true == self->b_inuse)
+  {
+    self->b_end += size;
+  }
+  else if (size <= (self->cap - self->a_end))
+  {
+    self->a_end += size;
+  }
+  else
+  {
+    self->b_end = size - (self->cap - self->a_end);
+    self->a_end = self->cap;
+    self->b_inuse = true;
+  }
+
+  bipbuf_try_switch_to_b(self);
+}
+
 bool bipbuf_offer(bipbuf_t *self, const void *data, const size_t size)
 {
   if (self == NULL)
@@ -78,6 +191,9 @@ bool bipbuf_offer(bipbuf_t *self, const void *data, const size_t size)
 
   if (bipbuf_unused(self) < size)
   {
+    TURNPIKE_PROBE3(bipbuf_offer_full, self, bipbuf_used(self), size);
+    metrics_record(self->metrics, METRICS_FULL, bipbuf_used(self));
+    recorder_record(self->recorder, RECORDER_FULL, size);
     return false;
   }
 
@@ -93,6 +209,10 @@ bool bipbuf_offer(bipbuf_t *self, const void *data, const size_t size)
   }
 
   bipbuf_try_switch_to_b(self);
+
+  TURNPIKE_PROBE3(bipbuf_offer, self, bipbuf_used(self), size);
+  metrics_record(self->metrics, METRICS_ENQUEUE, bipbuf_used(self));
+  recorder_record(self->recorder, RECORDER_ENQUEUE, size);
   return true;
 }
 
@@ -130,6 +250,7 @@ uint8_t *bipbuf_poll(bipbuf_t *self, const size_t size)
 
   if (bipbuf_empty(self))
   {
+    metrics_record(self->metrics, METRICS_EMPTY, 0);
     return NULL;
   }
 
@@ -142,24 +263,233 @@ uint8_t *bipbuf_poll(bipbuf_t *self, const size_t size)
   data = (uint8_t *)calloc(size, sizeof(*self->data));
 
   memcpy(data, (self->data + self->a_start), size * sizeof(*self->data));
-  self->a_start += size;
+  bipbuf_decommit(self, size);
+
+  TURNPIKE_PROBE3(bipbuf_poll, self, bipbuf_used(self), size);
+  metrics_record(self->metrics, METRICS_DEQUEUE, bipbuf_used(self));
+  recorder_record(self->recorder, RECORDER_DEQUEUE, size);
+
+  if (trim_policy_tick(&self->trim, bipbuf_used(self)))
+  {
+    bipbuf_trim(self);
+  }
+
+  return data;
+}
 
-  if (self->a_start == self->a_end)
+/**
+ * @brief Read from a file descriptor straight into the free space of the
+ *        buffer: the one or two free regions are handed to a single
+ *        readv() and only the bytes received are committed. The bytes
+ *        form a stream; callers that need framing impose it themselves.
+ * @return The number of bytes read, zero at end of file, or -1 with
+ *         errno set: ENOBUFS when the buffer is full, or e.g. EAGAIN when
+ *         a non-blocking fd has nothing to read.
+ */
+ssize_t bipbuf_read(bipbuf_t *self, const int fd)
+{
+  if (self == NULL)
   {
-    if (true == self->b_inuse)
+    errno = EINVAL;
+    return -1;
+  }
+
+  struct iovec iov[2];
+  int count = 0;
+
+  if (true == self->b_inuse)
+  {
+    iov[count++] = (struct iovec){ .iov_base = (self->data + self->b_end), .iov_len = (self->a_start - self->b_end) };
+  }
+  else
+  {
+    if (self->a_end != self->cap)
     {
-      self->a_start = 0;
-      self->a_end = self->b_end;
-      self->b_end = 0;
-      self->b_inuse = false;
+      iov[count++] = (struct iovec){ .iov_base = (self->data + self->a_end), .iov_len = (self->cap - self->a_end) };
     }
-    else
+
+    if (self->a_start != 0)
     {
-      self->a_start = 0;
-      self->a_end = 0;
+      iov[count++] = (struct iovec){ .iov_base = self->data, .iov_len = self->a_start };
     }
   }
 
-  bipbuf_try_switch_to_b(self);
-  return data;
+  if (count == 0 || iov[0].iov_len == 0)
+  {
+    TURNPIKE_PROBE3(bipbuf_offer_full, self, bipbuf_used(self), 0);
+    metrics_record(self->metrics, METRICS_FULL, bipbuf_used(self));
+    errno = ENOBUFS;
+    return -1;
+  }
+
+  ssize_t received;
+
+  do
+  {
+    received = readv(fd, iov, count);
+  }
+  while (received < 0 && errno == EINTR);
+
+  if (received <= 0)
+  {
+    return received;
+  }
+
+  bipbuf_commit(self, (size_t)received);
+
+  TURNPIKE_PROBE3(bipbuf_offer, self, bipbuf_used(self), (size_t)received);
+  metrics_record(self->metrics, METRICS_ENQUEUE, bipbuf_used(self));
+  recorder_record(self->recorder, RECORDER_ENQUEUE, (size_t)received);
+  return received;
+}
+
+/**
+ * @brief Write the readable bytes to a file descriptor without copying
+ *        them out first: region A, and region B behind it, are handed to a
+ *        single writev(). Only the bytes the kernel accepted are released,
+ *        so a short write leaves the rest at the front of the buffer for
+ *        the next call.
+ * @return The number of bytes written, zero when the buffer is empty, or
+ *         -1 with errno set, e.g. to EAGAIN for a full non-blocking fd.
+ */
+ssize_t bipbuf_write(bipbuf_t *self, const int fd)
+{
+  if (self == NULL)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (bipbuf_empty(self))
+  {
+    return 0;
+  }
+
+  struct iovec iov[2] = {
+    { .iov_base = (self->data + self->a_start), .iov_len = (self->a_end - self->a_start) },
+    { .iov_base = self->data,                   .iov_len = self->b_end },
+  };
+
+  const int count = (true == self->b_inuse && self->b_end != 0) ? 2 : 1;
+  ssize_t written;
+
+  do
+  {
+    written = writev(fd, iov, count);
+  }
+  while (written < 0 && errno == EINTR);
+
+  if (written <= 0)
+  {
+    return written;
+  }
+
+  bipbuf_release(self, (size_t)written);
+  return written;
+}
+
+/**
+ * @brief Find the readable bytes that lie in one piece offset bytes past
+ *        the front of the buffer, so that they can be handed to the kernel
+ *        in place. Region A comes first and region B follows it.
+ * @param data Receives the address of the first byte.
+ * @return The number of contiguous bytes, zero when offset is at or past
+ *         the end of the readable bytes.
+ */
+size_t bipbuf_contiguous(bipbuf_t *self, const size_t offset, uint8_t **data)
+{
+  if (self == NULL || data == NULL)
+  {
+    return 0;
+  }
+
+  const size_t a = self->a_end - self->a_start;
+
+  if (offset < a)
+  {
+    *data = self->data + self->a_start + offset;
+    return a - offset;
+  }
+
+  if (true == self->b_inuse && (offset - a) < self->b_end)
+  {
+    *data = self->data + (offset - a);
+    return self->b_end - (offset - a);
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Release size bytes from the front of the buffer once whoever
+ *        read them in place is done with them.
+ * @return Whether or not the buffer held that many bytes.
+ */
+bool bipbuf_release(bipbuf_t *self, const size_t size)
+{
+  if (self == NULL || bipbuf_used(self) < size)
+  {
+    return false;
+  }
+
+  bipbuf_decommit(self, size);
+
+  TURNPIKE_PROBE3(bipbuf_poll, self, bipbuf_used(self), size);
+  metrics_record(self->metrics, METRICS_DEQUEUE, bipbuf_used(self));
+  recorder_record(self->recorder, RECORDER_DEQUEUE, size);
+
+  if (trim_policy_tick(&self->trim, bipbuf_used(self)))
+  {
+    bipbuf_trim(self);
+  }
+
+  return true;
+}
+
+size_t bipbuf_trim(bipbuf_t *self)
+{
+  if (self == NULL)
+  {
+    return 0;
+  }
+
+  size_t released = 0;
+
+  released += _release(self->data, ((true == self->b_inuse) ? self->b_end : 0), self->a_start);
+  released += _release(self->data, self->a_end, self->cap);
+
+  return released;
+}
+
+void bipbuf_set_trim_policy(bipbuf_t *self, const size_t watermark, const size_t period)
+{
+  if (self == NULL)
+  {
+    return;
+  }
+
+  self->trim.watermark = watermark;
+  self->trim.period    = period;
+  self->trim.ticks     = 0;
+  self->trim.armed     = false;
+}
+
+bool bipbuf_metrics(bipbuf_t *self, metrics_snapshot_t *snapshot)
+{
+  if (self == NULL)
+  {
+    return false;
+  }
+
+  return metrics_snapshot(self->metrics, snapshot);
+}
+
+void bipbuf_set_recorder(bipbuf_t *self, recorder_t *recorder)
+{
+  if (self == NULL)
+  {
+    return;
+  }
+
+  self->recorder = recorder;
 }
@@ -0,0 +1,242 @@
+#include "broadcast.h"
+#include "common.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Allocate a new broadcast ring to the heap. The capacity is divided
+ *        into whole slots of len bytes. The container is aligned so that
+ *        the tail and every cursor sit on cache lines of their own.
+ * @note Do not implement your calls to the heap here. Instead, please use
+ *       the wrapper functions specified in common.h. These functions
+ *       deal with common problems like exception handling and fragmentation.
+ */
+broadcast_t *broadcast_new(const size_t cap, const size_t len)
+{
+  if (len == 0 || cap < len)
+  {
+    die("capacity must hold at least one item");
+  }
+
+  broadcast_t *self = NULL;
+  self = (broadcast_t *)mallocx(sizeof(*self), (MALLOCX_ZERO | MALLOCX_ALIGN(64)));
+  if (self == NULL)
+  {
+    die("a memory error occurred");
+  }
+
+  self->data = (uint8_t *)_calloc(cap, sizeof(*self->data));
+  self->cap = cap;
+  self->len = len;
+  self->slots = cap / len;
+  self->copy_in = copy_select(len, true);
+
+  atomic_init(&self->tail, 0);
+
+  int i;
+  for (i = 0; i < BROADCAST_CONSUMERS; i++)
+  {
+    atomic_init(&self->cursor[i].head, 0);
+    atomic_init(&self->cursor[i].active, false);
+  }
+
+  return self;
+}
+
+/**
+ * @brief Deallocate an existing broadcast ring from the heap.
+ * @param self A double pointer to the ring.
+ */
+void __broadcast_destroy(broadcast_t **self)
+{
+  if (self != NULL && *self != NULL)
+  {
+    __free((*self)->data);
+    ___free(*self);
+    *self = NULL;
+  }
+}
+
+/**
+ * @brief Register a consumer at the current tail of the ring.
+ * @param self A pointer to the ring.
+ * @return The id of the consumer, or -1 when every cursor is taken.
+ */
+int broadcast_subscribe(broadcast_t *self)
+{
+  if (self == NULL)
+  {
+    die("broadcast instance may not be null");
+  }
+
+  int i;
+  for (i = 0; i < BROADCAST_CONSUMERS; i++)
+  {
+    bool expected = false;
+
+    if (true == atomic_compare_exchange_strong(&self->cursor[i].active, &expected, true))
+    {
+      const size_t tail = atomic_load_explicit(&self->tail, memory_order_acquire);
+
+      atomic_store_explicit(&self->cursor[i].head, tail, memory_order_release);
+      self->cursor[i].tail_cache = tail;
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+/**
+ * @brief Unregister a consumer. The producer no longer waits for it.
+ * @param self A pointer to the ring.
+ * @param id The id of the consumer.
+ */
+void broadcast_unsubscribe(broadcast_t *self, const int id)
+{
+  if (self == NULL || id < 0 || id >= BROADCAST_CONSUMERS)
+  {
+    die("invalid broadcast consumer");
+  }
+
+  atomic_store(&self->cursor[id].active, false);
+}
+
+/**
+ * @brief Return the position of the slowest active consumer, or the tail
+ *        itself when there is none.
+ */
+static size_t broadcast_gate(broadcast_t *self, const size_t tail)
+{
+  size_t gate = tail;
+  int i;
+
+  for (i = 0; i < BROADCAST_CONSUMERS; i++)
+  {
+    if (true == atomic_load_explicit(&self->cursor[i].active, memory_order_acquire))
+    {
+      const size_t head = atomic_load_explicit(&self->cursor[i].head, memory_order_acquire);
+
+      if ((tail - head) > (tail - gate))
+      {
+        gate = head;
+      }
+    }
+  }
+
+  return gate;
+}
+
+/**
+ * @brief Publish an item to every consumer. Producer only. The cursors are
+ *        scanned only when the cached gate says the ring is full.
+ * @param self A pointer to the ring.
+ * @param data The len bytes of the item.
+ * @return Whether or not the item was published.
+ */
+bool broadcast_publish(broadcast_t *self, const void *data)
+{
+  if (self == NULL)
+  {
+    die("broadcast instance may not be null");
+  }
+
+  const size_t tail = atomic_load_explicit(&self->tail, memory_order_relaxed);
+
+  if ((tail - self->gate_cache) >= self->slots)
+  {
+    self->gate_cache = broadcast_gate(self, tail);
+
+    if ((tail - self->gate_cache) >= self->slots)
+    {
+      return false;
+    }
+  }
+
+  self->copy_in((self->data + ((tail % self->slots) * self->len)), data, self->len);
+  atomic_store_explicit(&self->tail, tail + 1, memory_order_release);
+
+  return true;
+}
+
+/**
+ * @brief Return the items a consumer has not read yet, in place, starting
+ *        at its cursor. The tail is re-read only when the cached copy runs
+ *        out before max items.
+ * @param self A pointer to the ring.
+ * @param id The id of the consumer.
+ * @param items Receives the address of up to max items.
+ * @param max The capacity of items.
+ * @return The number of items returned.
+ */
+size_t broadcast_peek(broadcast_t *self, const int id, const void **items, const size_t max)
+{
+  if (self == NULL || items == NULL || id < 0 || id >= BROADCAST_CONSUMERS)
+  {
+    die("invalid broadcast consumer");
+  }
+
+  struct broadcast_cursor *cursor = &self->cursor[id];
+  const size_t head = atomic_load_explicit(&cursor->head, memory_order_relaxed);
+
+  if ((cursor->tail_cache - head) < max)
+  {
+    cursor->tail_cache = atomic_load_explicit(&self->tail, memory_order_acquire);
+  }
+
+  const size_t available = cursor->tail_cache - head;
+  const size_t count = (available < max) ? available : max;
+  size_t i;
+
+  for (i = 0; i < count; i++)
+  {
+    items[i] = self->data + (((head + i) % self->slots) * self->len);
+  }
+
+  return count;
+}
+
+/**
+ * @brief Hand the oldest count items a consumer has read back to the
+ *        producer.
+ * @param self A pointer to the ring.
+ * @param id The id of the consumer.
+ * @param count The number of items, at most the number last peeked.
+ */
+void broadcast_release(broadcast_t *self, const int id, const size_t count)
+{
+  if (self == NULL || id < 0 || id >= BROADCAST_CONSUMERS)
+  {
+    die("invalid broadcast consumer");
+  }
+
+  struct broadcast_cursor *cursor = &self->cursor[id];
+  const size_t head = atomic_load_explicit(&cursor->head, memory_order_relaxed);
+
+  atomic_store_explicit(&cursor->head, head + count, memory_order_release);
+}
+
+/**
+ * @brief Return the number of items a consumer has not released yet. Any
+ *        thread may call this; the answer may be stale by the time it is
+ *        returned.
+ * @param self A pointer to the ring.
+ * @param id The id of the consumer.
+ */
+size_t broadcast_backlog(broadcast_t *self, const int id)
+{
+  if (self == NULL || id < 0 || id >= BROADCAST_CONSUMERS)
+  {
+    die("invalid broadcast consumer");
+  }
+
+  const size_t head = atomic_load_explicit(&self->cursor[id].head, memory_order_acquire);
+  const size_t tail = atomic_load_explicit(&self->tail, memory_order_acquire);
+
+  return tail - head;
+}
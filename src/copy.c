@@ -0,0 +1,211 @@
+#include "copy.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define COPY_X86
+#endif
+
+/**
+ * @brief Fixed-size kernels. The length is a constant, so the compiler
+ *        replaces each memcpy() with a handful of loads and stores.
+ */
+static void copy_8(void *restrict dst, const void *restrict src, const size_t len)
+{
+  memcpy(dst, src, 8);
+}
+
+static void copy_16(void *restrict dst, const void *restrict src, const size_t len)
+{
+  memcpy(dst, src, 16);
+}
+
+static void copy_32(void *restrict dst, const void *restrict src, const size_t len)
+{
+  memcpy(dst, src, 32);
+}
+
+static void copy_64(void *restrict dst, const void *restrict src, const size_t len)
+{
+  memcpy(dst, src, 64);
+}
+
+static void copy_generic(void *restrict dst, const void *restrict src, const size_t len)
+{
+  memcpy(dst, src, len);
+}
+
+#ifdef COPY_X86
+
+/**
+ * @brief Copy with unaligned 32-byte AVX2 loads and stores. The tail is
+ *        finished with one overlapping vector instead of a byte loop.
+ */
+__attribute__ ((target ("avx2")))
+static void copy_avx2(void *restrict dst, const void *restrict src, const size_t len)
+{
+  uint8_t *d = dst;
+  const uint8_t *s = src;
+  size_t i = 0;
+
+  if (len < 32)
+  {
+    memcpy(dst, src, len);
+    return;
+  }
+
+  for (; (i + 32) <= len; i += 32)
+  {
+    _mm256_storeu_si256((__m256i *)(d + i), _mm256_loadu_si256((const __m256i *)(s + i)));
+  }
+
+  if (i < len)
+  {
+    _mm256_storeu_si256((__m256i *)(d + len - 32), _mm256_loadu_si256((const __m256i *)(s + len - 32)));
+  }
+}
+
+/**
+ * @brief Copy with unaligned 64-byte AVX-512 loads and stores.
+ */
+__attribute__ ((target ("avx512f")))
+static void copy_avx512(void *restrict dst, const void *restrict src, const size_t len)
+{
+  uint8_t *d = dst;
+  const uint8_t *s = src;
+  size_t i = 0;
+
+  if (len < 64)
+  {
+    memcpy(dst, src, len);
+    return;
+  }
+
+  for (; (i + 64) <= len; i += 64)
+  {
+    _mm512_storeu_si512((void *)(d + i), _mm512_loadu_si512((const void *)(s + i)));
+  }
+
+  if (i < len)
+  {
+    _mm512_storeu_si512((void *)(d + len - 64), _mm512_loadu_si512((const void *)(s + len - 64)));
+  }
+}
+
+/**
+ * @brief Copy with non-temporal stores. The destination is brought to a
+ *        16-byte boundary with an ordinary copy, the aligned body is
+ *        streamed past the cache and the stores are fenced so that they
+ *        are visible before the item is published.
+ */
+static void copy_stream(void *restrict dst, const void *restrict src, const size_t len)
+{
+  uint8_t *d = dst;
+  const uint8_t *s = src;
+  size_t head = (16 - ((uintptr_t)d & 15)) & 15;
+  size_t i;
+
+  if (len < (head + 64))
+  {
+    memcpy(dst, src, len);
+    return;
+  }
+
+  memcpy(d, s, head);
+
+  for (i = head; (i + 64) <= len; i += 64)
+  {
+    const __m128i a = _mm_loadu_si128((const __m128i *)(s + i));
+    const __m128i b = _mm_loadu_si128((const __m128i *)(s + i + 16));
+    const __m128i c = _mm_loadu_si128((const __m128i *)(s + i + 32));
+    const __m128i e = _mm_loadu_si128((const __m128i *)(s + i + 48));
+
+    _mm_stream_si128((__m128i *)(d + i), a);
+    _mm_stream_si128((__m128i *)(d + i + 16), b);
+    _mm_stream_si128((__m128i *)(d + i + 32), c);
+    _mm_stream_si128((__m128i *)(d + i + 48), e);
+  }
+
+  memcpy(d + i, s + i, len - i);
+  _mm_sfence();
+}
+
+#endif/*COPY_X86*/
+
+/**
+ * @brief Select the copy kernel for items of one length.
+ * @param len The length in bytes of every item.
+ * @param stream Whether the copy writes into the queue buffer and may use
+ *        non-temporal stores for items above the threshold.
+ */
+copy_fn copy_select(const size_t len, const bool stream)
+{
+  switch (len)
+  {
+    case 8:  return copy_8;
+    case 16: return copy_16;
+    case 32: return copy_32;
+    case 64: return copy_64;
+    default: break;
+  }
+
+#ifdef COPY_X86
+  if (true == stream && TURNPIKE_COPY_STREAM_THRESHOLD != 0 && len >= TURNPIKE_COPY_STREAM_THRESHOLD)
+  {
+    return copy_stream;
+  }
+
+  if (len > 64)
+  {
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f"))
+    {
+      return copy_avx512;
+    }
+
+    if (__builtin_cpu_supports("avx2"))
+    {
+      return copy_avx2;
+    }
+  }
+#else
+  (void)stream;
+#endif/*COPY_X86*/
+
+  return copy_generic;
+}
+
+/**
+ * @brief Return the name of a kernel returned by copy_select().
+ */
+const char *copy_name(const copy_fn fn)
+{
+  static const struct { copy_fn fn; const char *name; } kernels[] = {
+    { copy_8,       "fixed8"  },
+    { copy_16,      "fixed16" },
+    { copy_32,      "fixed32" },
+    { copy_64,      "fixed64" },
+#ifdef COPY_X86
+    { copy_avx2,    "avx2"    },
+    { copy_avx512,  "avx512"  },
+    { copy_stream,  "stream"  },
+#endif/*COPY_X86*/
+    { copy_generic, "memcpy"  },
+  };
+
+  size_t i;
+  for (i = 0; i < (sizeof(kernels) / sizeof(kernels[0])); i++)
+  {
+    if (kernels[i].fn == fn)
+    {
+      return kernels[i].name;
+    }
+  }
+
+  return "unknown";
+}
@@ -0,0 +1,228 @@
+#include "common.h"
+#include "deque.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Allocate a circular array of size slots of len bytes.
+ * @note Do not implement your calls to the heap here. Instead, please use
+ *       the wrapper functions specified in common.h. These functions
+ *       deal with common problems like exception handling and fragmentation.
+ */
+static struct ws_array *ws_array_new(const size_t size, const size_t len)
+{
+  struct ws_array *self = NULL;
+  self = (struct ws_array *)_calloc(1, sizeof(*self) + (size * len));
+  self->size = size;
+  return self;
+}
+
+/**
+ * @brief Return the slot of index i in an array.
+ */
+static inline uint8_t *always_inline ws_array_slot(struct ws_array *array, const int64_t i, const size_t len)
+{
+  return array->slot + (((size_t)i & (array->size - 1)) * len);
+}
+
+/**
+ * @brief Allocate a new, empty deque to the heap.
+ * @param cap The initial capacity in items, rounded up to a power of two.
+ * @param len The length in bytes of every item in the deque.
+ */
+ws_deque_t *ws_deque_new(const size_t cap, const size_t len)
+{
+  if (len == 0)
+  {
+    die("items must be at least one byte long");
+  }
+
+  size_t size = 2;
+  while (size < cap)
+  {
+    size <<= 1;
+  }
+
+  ws_deque_t *self = NULL;
+  self = (ws_deque_t *)mallocx(sizeof(*self), (MALLOCX_ZERO | MALLOCX_ALIGN(64)));
+  if (self == NULL)
+  {
+    die("a memory error occurred");
+  }
+
+  atomic_init(&self->top, 0);
+  atomic_init(&self->bottom, 0);
+  atomic_init(&self->array, ws_array_new(size, len));
+  self->len = len;
+
+  return self;
+}
+
+/**
+ * @brief Deallocate an existing deque, and every array it outgrew, from
+ *        the heap.
+ * @param self A double pointer to the deque.
+ */
+void __ws_deque_destroy(ws_deque_t **self)
+{
+  if (self != NULL && *self != NULL)
+  {
+    struct ws_array *array = atomic_load(&(*self)->array);
+
+    while (array != NULL)
+    {
+      struct ws_array *prev = array->prev;
+      ___free(array);
+      array = prev;
+    }
+
+    ___free(*self);
+    *self = NULL;
+  }
+}
+
+/**
+ * @brief Replace a full array with one twice its size holding the items
+ *        in [top, bottom). The old array is kept for thieves that loaded
+ *        it before the swap.
+ */
+static struct ws_array *ws_deque_grow(ws_deque_t *self, struct ws_array *array, const int64_t top, const int64_t bottom)
+{
+  struct ws_array *grown = ws_array_new(array->size * 2, self->len);
+  int64_t i;
+
+  for (i = top; i < bottom; i++)
+  {
+    memcpy(ws_array_slot(grown, i, self->len), ws_array_slot(array, i, self->len), self->len);
+  }
+
+  grown->prev = array;
+  atomic_store_explicit(&self->array, grown, memory_order_release);
+  return grown;
+}
+
+/**
+ * @brief Push a copy of an item onto the bottom of the deque. Owner only.
+ *        The item is published to thieves by the release fence before the
+ *        bottom moves. The array grows before the bottom could wrap onto
+ *        the top, so the owner never writes a slot a thief may still claim.
+ * @param self A pointer to the deque.
+ * @param item The item to be copied in.
+ */
+void ws_deque_push(ws_deque_t *self, const void *item)
+{
+  if (self == NULL || item == NULL)
+  {
+    die("deque and item may not be null");
+  }
+
+  const int64_t bottom = atomic_load_explicit(&self->bottom, memory_order_relaxed);
+  const int64_t top = atomic_load_explicit(&self->top, memory_order_acquire);
+  struct ws_array *array = atomic_load_explicit(&self->array, memory_order_relaxed);
+
+  if ((bottom - top) > (int64_t)(array->size - 1))
+  {
+    array = ws_deque_grow(self, array, top, bottom);
+  }
+
+  memcpy(ws_array_slot(array, bottom, self->len), item, self->len);
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&self->bottom, bottom + 1, memory_order_relaxed);
+}
+
+/**
+ * @brief Pop the item most recently pushed. Owner only. The bottom is
+ *        moved first and the top read after a full fence, so that a thief
+ *        and the owner can only both reach for the last item, which they
+ *        then race for on the top.
+ * @param self A pointer to the deque.
+ * @param item Receives a copy of the item.
+ * @return Whether or not an item was popped.
+ */
+bool ws_deque_pop(ws_deque_t *self, void *item)
+{
+  if (self == NULL || item == NULL)
+  {
+    die("deque and item may not be null");
+  }
+
+  const int64_t bottom = atomic_load_explicit(&self->bottom, memory_order_relaxed) - 1;
+  struct ws_array *array = atomic_load_explicit(&self->array, memory_order_relaxed);
+
+  atomic_store_explicit(&self->bottom, bottom, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+
+  int64_t top = atomic_load_explicit(&self->top, memory_order_relaxed);
+  bool popped = false;
+
+  if (top <= bottom)
+  {
+    memcpy(item, ws_array_slot(array, bottom, self->len), self->len);
+    popped = true;
+
+    if (top == bottom)
+    {
+      popped = atomic_compare_exchange_strong_explicit(&self->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed);
+      atomic_store_explicit(&self->bottom, bottom + 1, memory_order_relaxed);
+    }
+  }
+  else
+  {
+    atomic_store_explicit(&self->bottom, bottom + 1, memory_order_relaxed);
+  }
+
+  return popped;
+}
+
+/**
+ * @brief Steal the oldest item. Any thread. The item is copied out first
+ *        and claimed afterwards by moving the top past it: the owner cannot
+ *        reuse its slot while the top still points at it, and if another
+ *        thread moved the top first the copy is thrown away.
+ * @param self A pointer to the deque.
+ * @param item Receives a copy of the item.
+ * @return Whether or not an item was stolen.
+ */
+bool ws_deque_steal(ws_deque_t *self, void *item)
+{
+  if (self == NULL || item == NULL)
+  {
+    die("deque and item may not be null");
+  }
+
+  int64_t top = atomic_load_explicit(&self->top, memory_order_acquire);
+  atomic_thread_fence(memory_order_seq_cst);
+  const int64_t bottom = atomic_load_explicit(&self->bottom, memory_order_acquire);
+
+  if (top >= bottom)
+  {
+    return false;
+  }
+
+  struct ws_array *array = atomic_load_explicit(&self->array, memory_order_acquire);
+  memcpy(item, ws_array_slot(array, top, self->len), self->len);
+
+  return atomic_compare_exchange_strong_explicit(&self->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed);
+}
+
+/**
+ * @brief Return the number of items in the deque.
+ * @param self A pointer to the deque.
+ */
+size_t ws_deque_size(ws_deque_t *self)
+{
+  if (self == NULL)
+  {
+    die("deque may not be null");
+  }
+
+  const int64_t bottom = atomic_load_explicit(&self->bottom, memory_order_acquire);
+  const int64_t top = atomic_load_explicit(&self->top, memory_order_acquire);
+
+  return (bottom > top) ? (size_t)(bottom - top) : 0;
+}
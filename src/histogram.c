@@ -0,0 +1,134 @@
+#include "common.h"
+#include "histogram.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * @brief Allocate a new, empty histogram to the heap.
+ * @note Do not implement your calls to the heap here. Instead, please use
+ *       the wrapper functions specified in common.h. These functions
+ *       deal with common problems like exception handling and fragmentation.
+ */
+struct histogram *histogram_new(void)
+{
+  struct histogram *self = NULL;
+  self = (struct histogram *)_calloc(1, sizeof(*self));
+  return self;
+}
+
+/**
+ * @brief Deallocate an existing histogram from the heap.
+ * @param self A double pointer to the histogram.
+ */
+void __histogram_destroy(struct histogram **self)
+{
+  if (self != NULL && *self != NULL)
+  {
+    ___free(*self);
+    *self = NULL;
+  }
+}
+
+/**
+ * @brief Return the greatest value counted in a bucket.
+ */
+static uint64_t histogram_upper(const size_t bucket)
+{
+  if (bucket < (2 * HISTOGRAM_SUB))
+  {
+    return bucket;
+  }
+
+  const unsigned shift = (unsigned)(bucket / HISTOGRAM_SUB) - 1;
+  const uint64_t top = HISTOGRAM_SUB + (bucket % HISTOGRAM_SUB);
+
+  return ((top + 1) << shift) - 1;
+}
+
+/**
+ * @brief Return the value at a quantile of the histogram, rounded up to the
+ *        upper bound of its bucket.
+ * @param self A pointer to the histogram.
+ * @param quantile The quantile, between 0.0 and 1.0.
+ */
+uint64_t histogram_percentile(struct histogram *self, const double quantile)
+{
+  if (self == NULL)
+  {
+    return 0;
+  }
+
+  uint64_t total = 0;
+  size_t i;
+
+  for (i = 0; i < HISTOGRAM_BUCKETS; i++)
+  {
+    total += atomic_load_explicit(&self->count[i], memory_order_relaxed);
+  }
+
+  if (total == 0)
+  {
+    return 0;
+  }
+
+  uint64_t rank = (uint64_t)((quantile * (double)total) + 0.5);
+  rank = (rank == 0) ? 1 : ((rank > total) ? total : rank);
+
+  uint64_t seen = 0;
+
+  for (i = 0; i < HISTOGRAM_BUCKETS; i++)
+  {
+    seen += atomic_load_explicit(&self->count[i], memory_order_relaxed);
+
+    if (seen >= rank)
+    {
+      return histogram_upper(i);
+    }
+  }
+
+  return histogram_upper(HISTOGRAM_BUCKETS - 1);
+}
+
+/**
+ * @brief Summarize a histogram of dwell-times. The buckets are read while
+ *        the queue keeps running, so the summary may miss values recorded
+ *        during the call.
+ * @param self A pointer to the histogram, or NULL when latency is disabled.
+ * @param snapshot Receives the summary.
+ * @return Whether or not the queue records latency.
+ */
+bool histogram_latency(struct histogram *self, latency_snapshot_t *snapshot)
+{
+  if (snapshot == NULL)
+  {
+    return false;
+  }
+
+  memset(snapshot, 0, sizeof(*snapshot));
+
+  if (self == NULL)
+  {
+    return false;
+  }
+
+  size_t i;
+  for (i = 0; i < HISTOGRAM_BUCKETS; i++)
+  {
+    const uint64_t count = atomic_load_explicit(&self->count[i], memory_order_relaxed);
+
+    if (count != 0)
+    {
+      snapshot->count += count;
+      snapshot->max = histogram_upper(i);
+    }
+  }
+
+  snapshot->p50  = histogram_percentile(self, 0.50);
+  snapshot->p99  = histogram_percentile(self, 0.99);
+  snapshot->p999 = histogram_percentile(self, 0.999);
+
+  return true;
+}
@@ -0,0 +1,85 @@
+#include "common.h"
+#include "lockprof.h"
+
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * @brief Allocate a new, empty lock profile to the heap.
+ * @note Do not implement your calls to the heap here. Instead, please use
+ *       the wrapper functions specified in common.h. These functions
+ *       deal with common problems like exception handling and fragmentation.
+ */
+lock_profile_t *lock_profile_new(void)
+{
+  lock_profile_t *self = NULL;
+  self = (lock_profile_t *)_calloc(1, sizeof(*self));
+  return self;
+}
+
+/**
+ * @brief Deallocate an existing lock profile from the heap.
+ * @param self A double pointer to the lock profile.
+ */
+void __lock_profile_destroy(lock_profile_t **self)
+{
+  if (self != NULL && *self != NULL)
+  {
+    ___free(*self);
+    *self = NULL;
+  }
+}
+
+/**
+ * @brief Return the name of a profiled operation.
+ */
+const char *lock_profile_op_name(const enum lock_profile_op op)
+{
+  static const char *names[LOCK_PROFILE_OPS] = {
+    [LOCK_PROFILE_ENQUEUE] = "enqueue",
+    [LOCK_PROFILE_DEQUEUE] = "dequeue",
+    [LOCK_PROFILE_PEEK]    = "peek",
+    [LOCK_PROFILE_SIZE]    = "size",
+    [LOCK_PROFILE_EMPTY]   = "empty",
+  };
+
+  if (op >= LOCK_PROFILE_OPS)
+  {
+    return "unknown";
+  }
+
+  return names[op];
+}
+
+/**
+ * @brief Print a lock profile as one line per operation, with the mean
+ *        wait over contended acquisitions and the mean hold time over all
+ *        acquisitions.
+ * @param self A pointer to the lock profile.
+ * @param fp The stream to print to.
+ */
+void lock_profile_print(const lock_profile_t *self, FILE *fp)
+{
+  if (self == NULL || fp == NULL)
+  {
+    return;
+  }
+
+  fprintf(fp, "%-8s %12s %12s %12s %12s %12s\n",
+    "op", "uncontended", "contended", "wait_avg_ns", "wait_max_ns", "hold_avg_ns");
+
+  int op;
+  for (op = 0; op < LOCK_PROFILE_OPS; op++)
+  {
+    const struct lock_stats *stats = &self->op[op];
+    const uint64_t total = stats->uncontended + stats->contended;
+
+    fprintf(fp, "%-8s %12" PRIu64 " %12" PRIu64 " %12" PRIu64 " %12" PRIu64 " %12" PRIu64 "\n",
+      lock_profile_op_name(op),
+      stats->uncontended,
+      stats->contended,
+      (stats->contended == 0) ? 0 : (stats->wait_ns / stats->contended),
+      stats->wait_max_ns,
+      (total == 0) ? 0 : (stats->hold_ns / total));
+  }
+}
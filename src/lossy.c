@@ -0,0 +1,248 @@
+#include "common.h"
+#include "lossy.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Allocate the Queue container, the queue buffer and the slot
+ *        sequence words to the heap.
+ * @note Do not implement your calls to the heap here. Instead, please use
+ *       the wrapper functions specified in common.h. These functions
+ *       deal with common problems like exception handling and fragmentation.
+ */
+static lossy_queue_t *lossy_queue_alloc(const size_t cap, const size_t slots)
+{
+  lossy_queue_t *self = NULL;
+  self = (lossy_queue_t *)_calloc(1, sizeof(*self));
+  self->data = (uint8_t *)_calloc(cap, sizeof(*self->data));
+  self->seq = (atomic_ulong *)_calloc(slots, sizeof(*self->seq));
+  return self;
+}
+
+/**
+ * @brief Allocate a new Queue data structure to the heap. The capacity is
+ *        divided into whole slots of len bytes.
+ * @param cap The maximum capacity allow in the Queue data structure.
+ * @param len The length in bytes of every item in the Queue.
+ */
+lossy_queue_t *lossy_queue_new(const size_t cap, const size_t len)
+{
+  if (len == 0 || cap < len)
+  {
+    die("capacity must hold at least one item");
+  }
+
+  const size_t slots = cap / len;
+
+  lossy_queue_t *self = NULL;
+  self = lossy_queue_alloc(cap, slots);
+
+  size_t i;
+  for (i = 0; i < slots; i++)
+  {
+    atomic_init(&self->seq[i], 0UL);
+  }
+
+  atomic_init(&self->w, 0UL);
+
+  self->cap = cap;
+  self->len = len;
+  self->slots = slots;
+  self->copy_in = copy_select(len, true);
+  self->copy_out = copy_select(len, false);
+
+  return self;
+}
+
+/**
+ * @brief Deallocate an existing Queue data structure from the heap.
+ * @param self A double pointer to the Queue container.
+ */
+void __lossy_queue_destroy(lossy_queue_t **self)
+{
+  if (self != NULL && *self != NULL)
+  {
+    __free((*self)->seq);
+    __free((*self)->data);
+    ___free(*self);
+    *self = NULL;
+  }
+}
+
+/**
+ * @brief Add an item to the Queue data structure, overwriting the oldest
+ *        item when the Queue is full. The sequence word of a slot holds
+ *        2n + 1 while item n is being written and 2n + 2 once item n is
+ *        published, so a reader can tell which item a slot holds and
+ *        whether it changed underneath the read. A producer claims the
+ *        slot by moving its word from an even, older value to 2n + 1, so
+ *        two producers can never copy into one slot at once. A producer
+ *        never waits: if a newer item already claimed the slot, or an
+ *        older item is still being copied into it, item n is given up
+ *        without being written and the consumer counts it as a gap. Every
+ *        producer finishes in a bounded number of steps.
+ * @param self A pointer to the Queue container.
+ * @param data The item to be added to the Queue data structure.
+ * @return The sequence number assigned to the item.
+ */
+uint64_t lossy_queue_enqueue(lossy_queue_t *self, const void *data)
+{
+  if (self == NULL)
+  {
+    die("queue instance may not be null");
+  }
+
+  const uint64_t n = atomic_fetch_add_explicit(&self->w, 1UL, memory_order_relaxed);
+  const size_t slot = n % self->slots;
+  const uint64_t claim = (2 * n) + 1;
+
+  uint64_t current = atomic_load_explicit(&self->seq[slot], memory_order_relaxed);
+
+  // A producer a lap or more ahead owns the slot, or one a lap or more
+  // behind is still copying into it: item n is given up and the consumer
+  // counts it as a gap. A failed claim means another producer just got the
+  // slot, which is either case again.
+  if (current >= claim || (current & 1UL) != 0 ||
+      false == atomic_compare_exchange_strong_explicit(&self->seq[slot], &current, claim, memory_order_relaxed, memory_order_relaxed))
+  {
+    return n;
+  }
+
+  atomic_thread_fence(memory_order_release);
+
+  self->copy_in((self->data + (slot * self->len)), data, self->len);
+
+  atomic_store_explicit(&self->seq[slot], claim + 1, memory_order_release);
+
+  return n;
+}
+
+/**
+ * @brief Remove the oldest item still held by the Queue data structure.
+ *        Items overwritten before they could be removed are skipped and
+ *        counted as dropped, and so is an item whose slot still holds an
+ *        older lap once its sequence number was handed out: its producer
+ *        gave it up, or has yet to claim the slot and will write an item
+ *        the consumer has already moved past. Only an item that is being
+ *        copied in is waited for, until it is lapped.
+ * @param self A pointer to the Queue container.
+ * @param seq Receives the sequence number of the item; may be NULL.
+ * @return The item removed from the front of the Queue, or NULL when no
+ *         published item is available.
+ */
+void *lossy_queue_dequeue(lossy_queue_t *self, uint64_t *seq)
+{
+  if (self == NULL)
+  {
+    die("queue instance may not be null");
+  }
+
+  void *item = NULL;
+
+  for (;;)
+  {
+    const uint64_t r = self->r;
+    const size_t slot = r % self->slots;
+    const uint64_t expected = (2 * r) + 2;
+
+    const uint64_t s1 = atomic_load_explicit(&self->seq[slot], memory_order_acquire);
+    const uint64_t w = atomic_load_explicit(&self->w, memory_order_relaxed);
+
+    if (r >= w)
+    {
+      // No producer has taken sequence number r yet.
+      break;
+    }
+
+    if (s1 == (expected - 1) && w <= (r + self->slots))
+    {
+      // Item r is being copied in and nothing has lapped it.
+      break;
+    }
+
+    if (s1 == expected)
+    {
+      if (item == NULL)
+      {
+        item = calloc(self->len, sizeof(*self->data));
+      }
+
+      self->copy_out(item, (self->data + (slot * self->len)), self->len);
+
+      atomic_thread_fence(memory_order_acquire);
+      const uint64_t s2 = atomic_load_explicit(&self->seq[slot], memory_order_relaxed);
+
+      if (s1 == s2)
+      {
+        if (seq != NULL)
+        {
+          *seq = r;
+        }
+
+        self->r = r + 1;
+        return item;
+      }
+    }
+
+    // Item r was overwritten, before or during the copy, a producer a lap
+    // ahead has already claimed its slot, or the slot still holds an older
+    // lap and item r is a gap. Skip ahead to the oldest item a producer
+    // may not have claimed over yet.
+    const uint64_t oldest = (w > self->slots) ? (w - self->slots) : 0;
+    const uint64_t next = (oldest > r) ? oldest : (r + 1);
+
+    self->dropped += next - r;
+    self->r = next;
+  }
+
+  free(item);
+  return NULL;
+}
+
+/**
+ * @brief Return the number of items that were overwritten before the
+ *        consumer could remove them.
+ * @param self A pointer to the Queue container.
+ */
+uint64_t lossy_queue_dropped(lossy_queue_t *self)
+{
+  if (self == NULL)
+  {
+    die("queue instance may not be null");
+  }
+
+  return self->dropped;
+}
+
+/**
+ * @brief Return the number of bytes currently in the Queue data structure.
+ * @param self A pointer to the Queue container.
+ * @return The current size of the Queue data structure.
+ */
+size_t lossy_queue_size(lossy_queue_t *self)
+{
+  if (self == NULL)
+  {
+    die("queue instance may not be null");
+  }
+
+  const uint64_t w = atomic_load(&self->w);
+  const uint64_t n = (w > self->r) ? (w - self->r) : 0;
+
+  return ((n < self->slots) ? n : self->slots) * self->len;
+}
+
+/**
+ * @brief Determine of the Queue data structure is empty.
+ * @param self A pointer to the Queue container.
+ * @return Whether or not the Queue data structure is empty.
+ */
+bool lossy_queue_empty(lossy_queue_t *self)
+{
+  return 0UL == lossy_queue_size(self);
+}
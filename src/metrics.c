@@ -0,0 +1,91 @@
+#include "common.h"
+#include "metrics.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+_Thread_local size_t __metrics_shard = 0;
+
+static atomic_ulong __metrics_next_shard = 0;
+
+/**
+ * @brief Assign the calling thread to the next shard in round-robin order.
+ */
+void __metrics_shard_assign(void)
+{
+  const size_t next = atomic_fetch_add_explicit(&__metrics_next_shard, 1UL, memory_order_relaxed);
+  __metrics_shard = (next % METRICS_SHARDS) + 1;
+}
+
+/**
+ * @brief Allocate a new set of metrics to the heap.
+ * @note Do not implement your calls to the heap here. Instead, please use
+ *       the wrapper functions specified in common.h. These functions
+ *       deal with common problems like exception handling and fragmentation.
+ */
+struct metrics *metrics_new(void)
+{
+  struct metrics *self = NULL;
+  self = (struct metrics *)mallocx(sizeof(*self), (MALLOCX_ZERO | MALLOCX_ALIGN(64)));
+  if (self == NULL)
+  {
+    die("a memory error occurred");
+  }
+  return self;
+}
+
+/**
+ * @brief Deallocate an existing set of metrics from the heap.
+ * @param self A double pointer to the metrics.
+ */
+void __metrics_destroy(struct metrics **self)
+{
+  if (self != NULL && *self != NULL)
+  {
+    ___free(*self);
+    *self = NULL;
+  }
+}
+
+/**
+ * @brief Sum the shards of a set of metrics into a snapshot.
+ * @param self A pointer to the metrics, or NULL when metrics are disabled.
+ * @param snapshot Receives the summed metrics.
+ * @return Whether or not the queue collects metrics.
+ */
+bool metrics_snapshot(struct metrics *self, metrics_snapshot_t *snapshot)
+{
+  if (snapshot == NULL)
+  {
+    return false;
+  }
+
+  memset(snapshot, 0, sizeof(*snapshot));
+
+  if (self == NULL)
+  {
+    return false;
+  }
+
+  size_t i;
+  for (i = 0; i < METRICS_SHARDS; i++)
+  {
+    struct metrics_shard *shard = &self->shard[i];
+
+    snapshot->enqueued += atomic_load_explicit(&shard->enqueued, memory_order_relaxed);
+    snapshot->dequeued += atomic_load_explicit(&shard->dequeued, memory_order_relaxed);
+    snapshot->full     += atomic_load_explicit(&shard->full,     memory_order_relaxed);
+    snapshot->empty    += atomic_load_explicit(&shard->empty,    memory_order_relaxed);
+
+    const uint64_t high_water = atomic_load_explicit(&shard->high_water, memory_order_relaxed);
+
+    if (high_water > snapshot->high_water)
+    {
+      snapshot->high_water = high_water;
+    }
+  }
+
+  return true;
+}
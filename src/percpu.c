@@ -0,0 +1,375 @@
+#define _GNU_SOURCE
+
+#include "common.h"
+#include "percpu.h"
+
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) && defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 35)) && !defined(TURNPIKE_NO_RSEQ)
+#include <sys/rseq.h>
+#define PERCPU_RSEQ
+#endif
+
+/**
+ * @brief The ring the sweep of the calling consumer starts from next.
+ */
+static _Thread_local size_t percpu_cursor = 0;
+
+#ifdef PERCPU_RSEQ
+
+enum percpu_push
+{
+  PERCPU_COMMITTED,
+  PERCPU_FULL,
+  PERCPU_ABORTED,
+};
+
+/**
+ * @brief Return the rseq area glibc registered for the calling thread.
+ */
+static inline volatile struct rseq *always_inline percpu_rseq_area(void)
+{
+  return (volatile struct rseq *)((uint8_t *)__builtin_thread_pointer() + __rseq_offset);
+}
+
+/**
+ * @brief Enqueue one item into the ring of cpu as a restartable sequence.
+ *        Everything from the CPU check to the store of the new tail is one
+ *        critical section: if the kernel preempts, migrates or signals the
+ *        thread inside it, the thread resumes at the abort handler instead,
+ *        with nothing published, and the caller tries again. The store of
+ *        the tail is the commit; on x86-64 it is ordered after the copy of
+ *        the item without a fence.
+ */
+static enum percpu_push percpu_rseq_push(volatile struct rseq *rs, struct percpu_ring *ring, const uint32_t cpu, const void *data, const size_t len, const size_t mask, const size_t slots)
+{
+  __asm__ goto (
+    ".pushsection __rseq_cs, \"aw\"\n\t"
+    ".balign 32\n\t"
+    "3:\n\t"
+    ".long 0x0, 0x0\n\t"
+    ".quad 1f, (2f - 1f), 4f\n\t"
+    ".popsection\n\t"
+    "leaq 3b(%%rip), %%rax\n\t"
+    "movq %%rax, %c[cs](%[rs])\n\t"
+    "1:\n\t"
+    "cmpl %[cpu], %c[cpu_id](%[rs])\n\t"
+    "jnz 4f\n\t"
+    "movq %c[tail](%[ring]), %%rax\n\t"
+    "movq %%rax, %%rcx\n\t"
+    "subq %c[head](%[ring]), %%rcx\n\t"
+    "cmpq %[slots], %%rcx\n\t"
+    "jae %l[full]\n\t"
+    "movq %%rax, %%rdi\n\t"
+    "andq %[mask], %%rdi\n\t"
+    "imulq %[len], %%rdi\n\t"
+    "addq %c[data](%[ring]), %%rdi\n\t"
+    "movq %[src], %%rsi\n\t"
+    "movq %[len], %%rcx\n\t"
+    "rep movsb\n\t"
+    "incq %%rax\n\t"
+    "movq %%rax, %c[tail](%[ring])\n\t"
+    "2:\n\t"
+    ".pushsection __rseq_failure, \"ax\"\n\t"
+    ".byte 0x0f, 0xb9, 0x3d\n\t"
+    ".long %c[sig]\n\t"
+    "4:\n\t"
+    "jmp %l[abort]\n\t"
+    ".popsection\n\t"
+    :
+    : [rs] "r" (rs),
+      [ring] "r" (ring),
+      [cpu] "r" (cpu),
+      [src] "rm" (data),
+      [len] "rm" (len),
+      [mask] "rm" (mask),
+      [slots] "rm" (slots),
+      [sig] "i" (RSEQ_SIG),
+      [cs] "i" (offsetof(struct rseq, rseq_cs)),
+      [cpu_id] "i" (offsetof(struct rseq, cpu_id)),
+      [tail] "i" (offsetof(struct percpu_ring, tail)),
+      [head] "i" (offsetof(struct percpu_ring, head)),
+      [data] "i" (offsetof(struct percpu_ring, data))
+    : "memory", "cc", "rax", "rcx", "rsi", "rdi"
+    : full, abort);
+
+  return PERCPU_COMMITTED;
+full:
+  return PERCPU_FULL;
+abort:
+  return PERCPU_ABORTED;
+}
+
+#endif/*PERCPU_RSEQ*/
+
+/**
+ * @brief Allocate a new Queue data structure to the heap. rseq is used when
+ *        glibc registered an rseq area for the calling thread, which it
+ *        does for every thread unless the kernel lacks the system call or
+ *        the glibc.pthread.rseq tunable turned it off.
+ * @note Do not implement your calls to the heap here. Instead, please use
+ *       the wrapper functions specified in common.h. These functions
+ *       deal with common problems like exception handling and fragmentation.
+ */
+percpu_queue_t *percpu_queue_new(const size_t cap, const size_t len)
+{
+  if (len == 0 || cap < len)
+  {
+    die("capacity must hold at least one item");
+  }
+
+  const long cpus = sysconf(_SC_NPROCESSORS_CONF);
+
+  size_t slots = 1;
+  while ((slots * 2) <= (cap / len))
+  {
+    slots *= 2;
+  }
+
+  percpu_queue_t *self = NULL;
+  self = (percpu_queue_t *)_calloc(1, sizeof(*self));
+
+  self->cap = cap;
+  self->len = len;
+  self->slots = slots;
+  self->mask = slots - 1;
+  self->cpus = (cpus > 0) ? (size_t)cpus : 1;
+
+#ifdef PERCPU_RSEQ
+  self->rseq = (__rseq_size != 0) && ((int32_t)percpu_rseq_area()->cpu_id >= 0);
+#else
+  self->rseq = false;
+#endif/*PERCPU_RSEQ*/
+
+  self->ring = (struct percpu_ring *)mallocx(((self->cpus + 1) * sizeof(*self->ring)), (MALLOCX_ZERO | MALLOCX_ALIGN(64)));
+  if (self->ring == NULL)
+  {
+    die("a memory error occurred");
+  }
+
+  size_t i;
+  for (i = 0; i <= self->cpus; i++)
+  {
+    atomic_init(&self->ring[i].tail, 0);
+    atomic_init(&self->ring[i].head, 0);
+    atomic_init(&self->ring[i].locked, false);
+    self->ring[i].data = (uint8_t *)_calloc(slots, len);
+  }
+
+  return self;
+}
+
+/**
+ * @brief Deallocate an existing Queue data structure from the heap.
+ * @param self A double pointer to the Queue container.
+ */
+void __percpu_queue_destroy(percpu_queue_t **self)
+{
+  if (self != NULL && *self != NULL)
+  {
+    size_t i;
+    for (i = 0; i <= (*self)->cpus; i++)
+    {
+      __free((*self)->ring[i].data);
+    }
+
+    ___free((*self)->ring);
+    ___free(*self);
+    *self = NULL;
+  }
+}
+
+/**
+ * @brief Enqueue under the flag of a ring, for producers that cannot use a
+ *        restartable sequence.
+ */
+static bool percpu_queue_enqueue_locked(percpu_queue_t *self, struct percpu_ring *ring, const void *data)
+{
+  while (true == atomic_exchange_explicit(&ring->locked, true, memory_order_acquire))
+  {
+    while (true == atomic_load_explicit(&ring->locked, memory_order_relaxed))
+    {
+      sched_yield();
+    }
+  }
+
+  const size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  const size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  const bool room = (tail - head) < self->slots;
+
+  if (true == room)
+  {
+    memcpy(ring->data + ((tail & self->mask) * self->len), data, self->len);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+  }
+
+  atomic_store_explicit(&ring->locked, false, memory_order_release);
+  return room;
+}
+
+/**
+ * @brief Add an item to the ring of the CPU the caller runs on. An aborted
+ *        restartable sequence is simply tried again on whichever CPU the
+ *        thread now runs on.
+ * @param self A pointer to the Queue container.
+ * @param data The item to be added to the Queue data structure.
+ * @return Whether or not the item was added.
+ */
+bool percpu_queue_enqueue(percpu_queue_t *self, const void *data)
+{
+  if (self == NULL || data == NULL)
+  {
+    die("queue and item may not be null");
+  }
+
+#ifdef PERCPU_RSEQ
+  if (true == self->rseq)
+  {
+    volatile struct rseq *rs = percpu_rseq_area();
+
+    while (true)
+    {
+      const int32_t cpu = (int32_t)rs->cpu_id;
+
+      if (cpu < 0 || (size_t)cpu >= self->cpus)
+      {
+        return percpu_queue_enqueue_locked(self, &self->ring[self->cpus], data);
+      }
+
+      switch (percpu_rseq_push(rs, &self->ring[cpu], (uint32_t)cpu, data, self->len, self->mask, self->slots))
+      {
+        case PERCPU_COMMITTED: return true;
+        case PERCPU_FULL: return false;
+        case PERCPU_ABORTED: break;
+      }
+    }
+  }
+#endif/*PERCPU_RSEQ*/
+
+  const int cpu = sched_getcpu();
+  return percpu_queue_enqueue_locked(self, &self->ring[(cpu < 0) ? 0 : ((size_t)cpu % self->cpus)], data);
+}
+
+/**
+ * @brief Remove an item from the next ring that has one.
+ * @param self A pointer to the Queue container.
+ * @return A copy of the item removed, or NULL when none was found.
+ */
+void *percpu_queue_dequeue(percpu_queue_t *self)
+{
+  if (self == NULL)
+  {
+    die("queue instance may not be null");
+  }
+
+  void *data = NULL;
+  data = _calloc(1, self->len);
+
+  if (0 == percpu_queue_dequeue_batch(self, data, 1))
+  {
+    __free(data);
+  }
+
+  return data;
+}
+
+/**
+ * @brief Remove up to max items into an array owned by the caller. The
+ *        items of a ring are copied out first and claimed afterwards by
+ *        moving the head past them: no producer can reuse their slots
+ *        while the head still points at them, and if another consumer moved
+ *        the head first the copies are thrown away and the ring is read
+ *        again.
+ * @param self A pointer to the Queue container.
+ * @param items An array of at least max items of len bytes.
+ * @param max The maximum number of items to remove.
+ * @return The number of items removed.
+ */
+size_t percpu_queue_dequeue_batch(percpu_queue_t *self, void *items, const size_t max)
+{
+  if (self == NULL || items == NULL)
+  {
+    die("queue and items may not be null");
+  }
+
+  uint8_t *item = (uint8_t *)items;
+  const size_t rings = self->cpus + 1;
+  const size_t start = percpu_cursor;
+  size_t n = 0;
+  size_t visited;
+
+  for (visited = 0; visited < rings && n < max; visited++)
+  {
+    const size_t index = (start + visited) % rings;
+    struct percpu_ring *ring = &self->ring[index];
+
+    while (n < max)
+    {
+      size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+      const size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+      if (head == tail)
+      {
+        break;
+      }
+
+      const size_t count = ((tail - head) < (max - n)) ? (tail - head) : (max - n);
+      size_t i;
+
+      for (i = 0; i < count; i++)
+      {
+        memcpy(item + ((n + i) * self->len), ring->data + (((head + i) & self->mask) * self->len), self->len);
+      }
+
+      if (true == atomic_compare_exchange_weak_explicit(&ring->head, &head, head + count, memory_order_release, memory_order_relaxed))
+      {
+        n += count;
+        percpu_cursor = index + 1;
+        break;
+      }
+    }
+  }
+
+  return n;
+}
+
+/**
+ * @brief Return the number of bytes currently in the Queue data structure.
+ * @param self A pointer to the Queue container.
+ */
+size_t percpu_queue_size(percpu_queue_t *self)
+{
+  if (self == NULL)
+  {
+    die("queue instance may not be null");
+  }
+
+  size_t size = 0;
+  size_t i;
+
+  for (i = 0; i <= self->cpus; i++)
+  {
+    const size_t head = atomic_load_explicit(&self->ring[i].head, memory_order_acquire);
+    const size_t tail = atomic_load_explicit(&self->ring[i].tail, memory_order_acquire);
+
+    size += (tail > head) ? ((tail - head) * self->len) : 0;
+  }
+
+  return size;
+}
+
+/**
+ * @brief Determine of the Queue data structure is empty.
+ * @param self A pointer to the Queue container.
+ */
+bool percpu_queue_empty(percpu_queue_t *self)
+{
+  return 0UL == percpu_queue_size(self);
+}
@@ -0,0 +1,462 @@
+#include "bipartite.h"
+#include "common.h"
+#include "histogram.h"
+#include "pipeline.h"
+#include "spsc.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * @brief The number of idle rounds a worker yields for before it starts to
+ *        sleep between polls, and how long it sleeps.
+ */
+#define PIPELINE_SPINS    64
+#define PIPELINE_SLEEP_NS 50000L
+
+/**
+ * @brief Allocate a new, empty pipeline to the heap.
+ * @param slots The capacity in items of every ring between stages.
+ * @note Do not implement your calls to the heap here. Instead, please use
+ *       the wrapper functions specified in common.h. These functions
+ *       deal with common problems like exception handling and fragmentation.
+ */
+pipeline_t *pipeline_new(const size_t slots)
+{
+  if (slots < PIPELINE_BATCH)
+  {
+    die("rings must hold at least PIPELINE_BATCH items");
+  }
+
+  pipeline_t *self = NULL;
+  self = (pipeline_t *)_calloc(1, sizeof(*self));
+  self->slots = slots;
+  return self;
+}
+
+/**
+ * @brief Deallocate a pipeline and its rings from the heap.
+ * @param self A double pointer to the pipeline.
+ */
+void __pipeline_destroy(pipeline_t **self)
+{
+  if (self != NULL && *self != NULL)
+  {
+    size_t i;
+    for (i = 0; i < (*self)->stages; i++)
+    {
+      struct pipeline_stage *stage = &(*self)->stage[i];
+
+      if (stage->output != NULL && stage->ring == PIPELINE_BIPARTITE)
+      {
+        bipartite_queue_t *queue = (bipartite_queue_t *)stage->output;
+        bipartite_queue_destroy(queue);
+      }
+      else if (stage->output != NULL)
+      {
+        spsc_queue_t *queue = (spsc_queue_t *)stage->output;
+        spsc_queue_destroy(queue);
+      }
+
+      __free(stage->workers);
+    }
+
+    ___free(*self);
+    *self = NULL;
+  }
+}
+
+/**
+ * @brief Append a stage to the pipeline.
+ * @return Whether or not the stage was added.
+ */
+bool pipeline_add(pipeline_t *self, const char *name, pipeline_fn fn, void *ctx, const unsigned threads, const size_t len, const enum pipeline_ring ring)
+{
+  if (self == NULL || fn == NULL || threads == 0 || self->stages == PIPELINE_STAGES || self->started != 0)
+  {
+    return false;
+  }
+
+  struct pipeline_stage *stage = &self->stage[self->stages];
+
+  stage->name = (name == NULL) ? "stage" : name;
+  stage->fn = fn;
+  stage->ctx = ctx;
+  stage->threads = threads;
+  stage->len = len;
+  stage->ring = ring;
+  stage->owner = self;
+  stage->index = self->stages++;
+
+  return true;
+}
+
+/**
+ * @brief Back off while a worker has nothing to do: yield at first, then
+ *        sleep, so that an idle stage does not burn a core.
+ */
+static void pipeline_idle(unsigned *spins)
+{
+  if (++(*spins) < PIPELINE_SPINS)
+  {
+    sched_yield();
+    return;
+  }
+
+  const struct timespec pause = { 0, PIPELINE_SLEEP_NS };
+  nanosleep(&pause, NULL);
+}
+
+/**
+ * @brief Take up to PIPELINE_BATCH items from the output ring of a stage.
+ * @return The number of items taken.
+ */
+static size_t pipeline_take(struct pipeline_stage *from, uint8_t *items)
+{
+  if (from->ring == PIPELINE_BIPARTITE)
+  {
+    return bipartite_queue_dequeue_batch((bipartite_queue_t *)from->output, items, PIPELINE_BATCH);
+  }
+
+  size_t n = 0;
+  while (n < PIPELINE_BATCH && true == spsc_queue_pop((spsc_queue_t *)from->output, (items + (n * from->len))))
+  {
+    n++;
+  }
+
+  return n;
+}
+
+/**
+ * @brief Hand count items to the output ring of a stage, waiting for room
+ *        as long as it takes.
+ */
+static void pipeline_give(struct pipeline_stage *to, const uint8_t *items, const size_t count)
+{
+  size_t done = 0;
+  unsigned spins = 0;
+
+  while (done < count)
+  {
+    size_t n = 0;
+
+    if (to->ring == PIPELINE_BIPARTITE)
+    {
+      n = bipartite_queue_enqueue_batch((bipartite_queue_t *)to->output, (items + (done * to->len)), (count - done));
+    }
+    else
+    {
+      while ((done + n) < count && true == spsc_queue_enqueue((spsc_queue_t *)to->output, (items + ((done + n) * to->len))))
+      {
+        n++;
+      }
+    }
+
+    if (n == 0)
+    {
+      pipeline_idle(&spins);
+    }
+
+    done += n;
+  }
+
+  atomic_fetch_add_explicit(&to->out, count, memory_order_relaxed);
+  atomic_fetch_add_explicit(&to->batches, 1UL, memory_order_relaxed);
+}
+
+/**
+ * @brief Run the source: call the stage function until it is done and hand
+ *        its items on a batch at a time.
+ */
+static void pipeline_source(struct pipeline_stage *stage, uint8_t *out)
+{
+  enum pipeline_result result = PIPELINE_EMIT;
+
+  while (result != PIPELINE_DONE)
+  {
+    size_t n = 0;
+
+    while (n < PIPELINE_BATCH && (result = stage->fn(stage->ctx, NULL, (out + (n * stage->len)))) != PIPELINE_DONE)
+    {
+      n += (result == PIPELINE_EMIT) ? 1 : 0;
+    }
+
+    if (n != 0)
+    {
+      pipeline_give(stage, out, n);
+    }
+  }
+}
+
+/**
+ * @brief Run a stage fed by the previous one until that stage is finished
+ *        and its ring is drained. The previous stage counts itself out
+ *        only after its last hand-off, so a ring found empty after that is
+ *        empty for good.
+ */
+static void pipeline_filter(struct pipeline_stage *stage, uint8_t *in, uint8_t *out)
+{
+  struct pipeline_stage *from = &stage->owner->stage[stage->index - 1];
+  unsigned spins = 0;
+
+  while (true)
+  {
+    const bool finished = (0 == atomic_load_explicit(&from->running, memory_order_acquire));
+    const size_t n = pipeline_take(from, in);
+
+    if (n == 0)
+    {
+      if (true == finished)
+      {
+        return;
+      }
+
+      pipeline_idle(&spins);
+      continue;
+    }
+
+    spins = 0;
+    atomic_fetch_add_explicit(&stage->in, n, memory_order_relaxed);
+
+    size_t emitted = 0;
+    size_t i;
+
+    for (i = 0; i < n; i++)
+    {
+      void *slot = (stage->len == 0) ? NULL : (out + (emitted * stage->len));
+
+      if (stage->fn(stage->ctx, (in + (i * from->len)), slot) == PIPELINE_EMIT && slot != NULL)
+      {
+        emitted++;
+      }
+    }
+
+    if (emitted != 0)
+    {
+      pipeline_give(stage, out, emitted);
+    }
+  }
+}
+
+/**
+ * @brief The body of every worker thread.
+ */
+static void *pipeline_worker(void *arg)
+{
+  struct pipeline_stage *stage = (struct pipeline_stage *)arg;
+  const size_t in_len = (stage->index == 0) ? 0 : stage->owner->stage[stage->index - 1].len;
+
+  uint8_t *in = (in_len == 0) ? NULL : (uint8_t *)_calloc(PIPELINE_BATCH, in_len);
+  uint8_t *out = (stage->len == 0) ? NULL : (uint8_t *)_calloc(PIPELINE_BATCH, stage->len);
+
+  if (stage->index == 0)
+  {
+    pipeline_source(stage, out);
+  }
+  else
+  {
+    pipeline_filter(stage, in, out);
+  }
+
+  if (in != NULL)
+  {
+    ___free(in);
+  }
+
+  if (out != NULL)
+  {
+    ___free(out);
+  }
+
+  if (1 == atomic_fetch_sub_explicit(&stage->running, 1U, memory_order_release))
+  {
+    atomic_store(&stage->finished, histogram_now());
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief Check the declaration of every stage before anything is started.
+ */
+static bool pipeline_valid(pipeline_t *self)
+{
+  if (self->stages < 2)
+  {
+    return false;
+  }
+
+  size_t i;
+  for (i = 0; i < self->stages; i++)
+  {
+    const struct pipeline_stage *stage = &self->stage[i];
+    const bool last = (i + 1) == self->stages;
+
+    if (last != (stage->len == 0))
+    {
+      return false;
+    }
+
+    if (false == last && stage->ring == PIPELINE_SPSC && (stage->threads != 1 || self->stage[i + 1].threads != 1))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * @brief Create the rings and start every worker, from the sink back to
+ *        the source, so that nothing is produced before it can be taken.
+ * @return Whether or not the pipeline started.
+ */
+bool pipeline_start(pipeline_t *self)
+{
+  if (self == NULL || self->started != 0 || false == pipeline_valid(self))
+  {
+    return false;
+  }
+
+  size_t i;
+  for (i = 0; i < self->stages; i++)
+  {
+    struct pipeline_stage *stage = &self->stage[i];
+
+    if (stage->len != 0 && stage->ring == PIPELINE_BIPARTITE)
+    {
+      stage->output = bipartite_queue_new((self->slots * stage->len), stage->len);
+    }
+    else if (stage->len != 0)
+    {
+      stage->output = spsc_queue_new((self->slots * stage->len), stage->len);
+    }
+
+    stage->workers = (pthread_t *)_calloc(stage->threads, sizeof(*stage->workers));
+    atomic_init(&stage->running, stage->threads);
+  }
+
+  self->started = histogram_now();
+
+  for (i = self->stages; i-- > 0;)
+  {
+    struct pipeline_stage *stage = &self->stage[i];
+    unsigned t;
+
+    for (t = 0; t < stage->threads; t++)
+    {
+      if (pthread_create(&stage->workers[t], NULL, &pipeline_worker, stage) != 0)
+      {
+        die("could not start a pipeline worker");
+      }
+    }
+  }
+
+  return true;
+}
+
+/**
+ * @brief Wait until the source is done and every item has reached the
+ *        sink.
+ * @param self A pointer to the pipeline.
+ */
+void pipeline_wait(pipeline_t *self)
+{
+  if (self == NULL || self->started == 0)
+  {
+    return;
+  }
+
+  size_t i;
+  for (i = 0; i < self->stages; i++)
+  {
+    unsigned t;
+    for (t = 0; t < self->stage[i].threads; t++)
+    {
+      pthread_join(self->stage[i].workers[t], NULL);
+    }
+  }
+}
+
+/**
+ * @brief Read the statistics of a stage while it runs, or after. The rate
+ *        counts the items a stage took in, or for the source the items it
+ *        handed on, per second since the pipeline started.
+ * @return Whether or not the stage exists.
+ */
+bool pipeline_stats(pipeline_t *self, const size_t stage, pipeline_stats_t *stats)
+{
+  if (self == NULL || stats == NULL || stage >= self->stages)
+  {
+    return false;
+  }
+
+  const struct pipeline_stage *target = &self->stage[stage];
+  memset(stats, 0, sizeof(*stats));
+
+  stats->in = atomic_load_explicit(&target->in, memory_order_relaxed);
+  stats->out = atomic_load_explicit(&target->out, memory_order_relaxed);
+  stats->batches = atomic_load_explicit(&target->batches, memory_order_relaxed);
+
+  if (stage != 0 && self->stage[stage - 1].output != NULL)
+  {
+    const struct pipeline_stage *from = &self->stage[stage - 1];
+
+    stats->backlog = (from->ring == PIPELINE_BIPARTITE)
+      ? (bipartite_queue_size((bipartite_queue_t *)from->output) / from->len)
+      : (spsc_queue_size((spsc_queue_t *)from->output) / from->len);
+  }
+
+  if (self->started != 0)
+  {
+    const uint64_t finished = atomic_load(&target->finished);
+
+    stats->elapsed_ns = ((finished != 0) ? finished : histogram_now()) - self->started;
+  }
+
+  if (stats->elapsed_ns != 0)
+  {
+    stats->rate = (double)((stage == 0) ? stats->out : stats->in) * 1e9 / (double)stats->elapsed_ns;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Print the statistics of every stage as one line per stage.
+ * @param self A pointer to the pipeline.
+ * @param fp The stream to print to.
+ */
+void pipeline_print(pipeline_t *self, FILE *fp)
+{
+  if (self == NULL || fp == NULL)
+  {
+    return;
+  }
+
+  fprintf(fp, "%-12s %8s %12s %12s %10s %10s %14s\n",
+    "stage", "threads", "in", "out", "batches", "backlog", "items_per_sec");
+
+  size_t i;
+  for (i = 0; i < self->stages; i++)
+  {
+    pipeline_stats_t stats;
+    pipeline_stats(self, i, &stats);
+
+    fprintf(fp, "%-12s %8u %12" PRIu64 " %12" PRIu64 " %10" PRIu64 " %10zu %14.0f\n",
+      self->stage[i].name,
+      self->stage[i].threads,
+      stats.in,
+      stats.out,
+      stats.batches,
+      stats.backlog,
+      stats.rate);
+  }
+}
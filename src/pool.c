@@ -0,0 +1,346 @@
+#include "bipartite.h"
+#include "common.h"
+#include "deque.h"
+#include "pool.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * @brief The number of idle rounds a worker yields for before it starts to
+ *        sleep between looking for work, and how long it sleeps.
+ */
+#define POOL_SPINS    64
+#define POOL_SLEEP_NS 50000L
+
+/**
+ * @brief The worker running on the calling thread, if any.
+ */
+static _Thread_local struct pool_worker *pool_current = NULL;
+
+static void pool_idle(unsigned *spins)
+{
+  if (++(*spins) < POOL_SPINS)
+  {
+    sched_yield();
+    return;
+  }
+
+  const struct timespec pause = { 0, POOL_SLEEP_NS };
+  nanosleep(&pause, NULL);
+}
+
+/**
+ * @brief Run a task and count it as done.
+ */
+static inline void always_inline pool_run(struct pool_worker *worker, const struct pool_task *task)
+{
+  task->fn(task->arg);
+
+  atomic_fetch_add_explicit(&worker->executed, 1UL, memory_order_relaxed);
+  atomic_fetch_sub_explicit(&worker->pool->pending, 1UL, memory_order_release);
+}
+
+/**
+ * @brief Steal a task from another worker, starting at a random victim and
+ *        trying each of them once.
+ * @param task Receives the task.
+ * @return Whether or not a task was stolen; false when every other deque
+ *         looked empty.
+ */
+static bool pool_steal(struct pool_worker *worker, struct pool_task *task)
+{
+  struct pool *pool = worker->pool;
+
+  worker->seed ^= worker->seed << 13;
+  worker->seed ^= worker->seed >> 7;
+  worker->seed ^= worker->seed << 17;
+
+  const unsigned start = (unsigned)(worker->seed % pool->threads);
+  unsigned i;
+
+  for (i = 0; i < pool->threads; i++)
+  {
+    struct pool_worker *victim = &pool->workers[(start + i) % pool->threads];
+
+    if (victim == worker)
+    {
+      continue;
+    }
+
+    if (true == ws_deque_steal(victim->deque, task))
+    {
+      atomic_fetch_add_explicit(&worker->stolen, 1UL, memory_order_relaxed);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/**
+ * @brief The loop of a worker of a stealing pool: its own deque first, then
+ *        the injector, then the other workers. A batch taken from the
+ *        injector is spread over the deque so that it can be stolen. Tasks
+ *        travel by value, so none of this allocates.
+ */
+static void pool_stealing_loop(struct pool_worker *worker)
+{
+  struct pool *pool = worker->pool;
+  struct pool_task batch[POOL_BATCH];
+  struct pool_task task;
+  unsigned spins = 0;
+
+  while (false == atomic_load_explicit(&pool->stopping, memory_order_acquire))
+  {
+    bool found = ws_deque_pop(worker->deque, &task);
+
+    if (false == found)
+    {
+      const size_t n = bipartite_queue_dequeue_batch(pool->injector, batch, POOL_BATCH);
+
+      if (n != 0)
+      {
+        size_t i;
+        for (i = 1; i < n; i++)
+        {
+          ws_deque_push(worker->deque, &batch[i]);
+        }
+
+        spins = 0;
+        pool_run(worker, &batch[0]);
+        continue;
+      }
+
+      found = pool_steal(worker, &task);
+    }
+
+    if (false == found)
+    {
+      pool_idle(&spins);
+      continue;
+    }
+
+    spins = 0;
+    pool_run(worker, &task);
+  }
+}
+
+/**
+ * @brief The loop of a worker of a shared pool: batches from the injector.
+ */
+static void pool_shared_loop(struct pool_worker *worker)
+{
+  struct pool *pool = worker->pool;
+  struct pool_task batch[POOL_BATCH];
+  unsigned spins = 0;
+
+  while (false == atomic_load_explicit(&pool->stopping, memory_order_acquire))
+  {
+    const size_t n = bipartite_queue_dequeue_batch(pool->injector, batch, POOL_BATCH);
+
+    if (n == 0)
+    {
+      pool_idle(&spins);
+      continue;
+    }
+
+    size_t i;
+    for (i = 0; i < n; i++)
+    {
+      pool_run(worker, &batch[i]);
+    }
+
+    spins = 0;
+  }
+}
+
+static void *pool_worker_main(void *arg)
+{
+  struct pool_worker *worker = (struct pool_worker *)arg;
+
+  pool_current = worker;
+
+  if (worker->pool->kind == POOL_STEALING)
+  {
+    pool_stealing_loop(worker);
+  }
+  else
+  {
+    pool_shared_loop(worker);
+  }
+
+  pool_current = NULL;
+  return NULL;
+}
+
+/**
+ * @brief Allocate a new pool to the heap and start its workers.
+ * @note Do not implement your calls to the heap here. Instead, please use
+ *       the wrapper functions specified in common.h. These functions
+ *       deal with common problems like exception handling and fragmentation.
+ */
+pool_t *pool_new(const unsigned threads, const enum pool_kind kind, const size_t cap)
+{
+  if (threads == 0 || cap == 0)
+  {
+    die("a pool needs at least one thread and one slot");
+  }
+
+  pool_t *self = NULL;
+  self = (pool_t *)mallocx(sizeof(*self), (MALLOCX_ZERO | MALLOCX_ALIGN(64)));
+  if (self == NULL)
+  {
+    die("a memory error occurred");
+  }
+
+  self->kind = kind;
+  self->threads = threads;
+  self->injector = bipartite_queue_new((cap * sizeof(struct pool_task)), sizeof(struct pool_task));
+  self->workers = (struct pool_worker *)mallocx((threads * sizeof(*self->workers)), (MALLOCX_ZERO | MALLOCX_ALIGN(64)));
+  if (self->workers == NULL)
+  {
+    die("a memory error occurred");
+  }
+
+  atomic_init(&self->pending, 0UL);
+  atomic_init(&self->stopping, false);
+
+  unsigned i;
+  for (i = 0; i < threads; i++)
+  {
+    struct pool_worker *worker = &self->workers[i];
+
+    worker->pool = self;
+    worker->index = i;
+    worker->seed = 0x9e3779b97f4a7c15ULL * (i + 1);
+    worker->deque = (kind == POOL_STEALING) ? ws_deque_new(POOL_BATCH * 4, sizeof(struct pool_task)) : NULL;
+    atomic_init(&worker->executed, 0UL);
+    atomic_init(&worker->stolen, 0UL);
+  }
+
+  for (i = 0; i < threads; i++)
+  {
+    if (pthread_create(&self->workers[i].thread, NULL, &pool_worker_main, &self->workers[i]) != 0)
+    {
+      die("could not start a pool worker");
+    }
+  }
+
+  return self;
+}
+
+/**
+ * @brief Wait for every task, stop the workers and deallocate the pool.
+ * @param self A double pointer to the pool.
+ */
+void __pool_destroy(pool_t **self)
+{
+  if (self != NULL && *self != NULL)
+  {
+    pool_t *pool = *self;
+    unsigned i;
+
+    pool_wait(pool);
+    atomic_store(&pool->stopping, true);
+
+    for (i = 0; i < pool->threads; i++)
+    {
+      pthread_join(pool->workers[i].thread, NULL);
+      ws_deque_destroy(pool->workers[i].deque);
+    }
+
+    bipartite_queue_destroy(pool->injector);
+    ___free(pool->workers);
+    ___free(pool);
+    *self = NULL;
+  }
+}
+
+/**
+ * @brief Submit a task. The pending count is raised before the task can be
+ *        seen, so it cannot reach zero while a task that submits another
+ *        is still running.
+ * @param self A pointer to the pool.
+ * @param fn The function of the task.
+ * @param arg The argument passed to fn.
+ */
+void pool_submit(pool_t *self, pool_fn fn, void *arg)
+{
+  if (self == NULL || fn == NULL)
+  {
+    die("pool and task may not be null");
+  }
+
+  const struct pool_task task = { .fn = fn, .arg = arg };
+  struct pool_worker *worker = (pool_current != NULL && pool_current->pool == self) ? pool_current : NULL;
+
+  atomic_fetch_add_explicit(&self->pending, 1UL, memory_order_relaxed);
+
+  if (worker != NULL && self->kind == POOL_STEALING)
+  {
+    ws_deque_push(worker->deque, &task);
+    return;
+  }
+
+  unsigned spins = 0;
+
+  while (false == bipartite_queue_enqueue(self->injector, &task))
+  {
+    if (worker != NULL)
+    {
+      pool_run(worker, &task);
+      return;
+    }
+
+    pool_idle(&spins);
+  }
+}
+
+/**
+ * @brief Wait until every task submitted so far has run.
+ * @param self A pointer to the pool.
+ */
+void pool_wait(pool_t *self)
+{
+  if (self == NULL)
+  {
+    die("pool may not be null");
+  }
+
+  unsigned spins = 0;
+
+  while (0 != atomic_load_explicit(&self->pending, memory_order_acquire))
+  {
+    pool_idle(&spins);
+  }
+}
+
+/**
+ * @brief Sum the counters of the workers.
+ * @param self A pointer to the pool.
+ * @param stats Receives the totals.
+ */
+void pool_stats(pool_t *self, struct pool_stats *stats)
+{
+  if (self == NULL || stats == NULL)
+  {
+    return;
+  }
+
+  memset(stats, 0, sizeof(*stats));
+
+  unsigned i;
+  for (i = 0; i < self->threads; i++)
+  {
+    stats->executed += atomic_load_explicit(&self->workers[i].executed, memory_order_relaxed);
+    stats->stolen += atomic_load_explicit(&self->workers[i].stolen, memory_order_relaxed);
+  }
+}
@@ -1,4 +1,5 @@
 #include "common.h"
+#include "probes.h"
 #include "queue.h"
 
 #include <stdbool.h>
@@ -13,14 +14,41 @@
  *       the wrapper functions specified in common.h. These functions
  *       deal with common problems like exception handling and fragmentation.
  */
-static queue_t *queue_alloc(const size_t cap)
+static queue_t *queue_alloc(const size_t cap, const bool lazy)
 {
   queue_t *self = NULL;
   self = (queue_t *)_calloc(1, sizeof(*self));
-  self->data = (uint8_t *)_calloc(cap, sizeof(*self->data));
+
+  if (true == lazy)
+  {
+    self->data = (uint8_t *)_map(cap * sizeof(*self->data));
+    self->mapped = true;
+  }
+  else
+  {
+    self->data = (uint8_t *)_calloc(cap, sizeof(*self->data));
+  }
+
+  self->metrics = metrics_attach();
   return self;
 }
 
+/**
+ * @brief Attach the optional dwell-time instrumentation of the Queue once
+ *        its capacity and item length are known. The enqueue time of each
+ *        item is kept in a side array indexed by slot, so the layout of the
+ *        queue buffer does not change.
+ */
+static void queue_instrument(queue_t *self)
+{
+  self->latency = latency_attach();
+
+  if (self->latency != NULL)
+  {
+    self->stamps = (uint64_t *)_calloc(((self->cap / self->len) + 1), sizeof(*self->stamps));
+  }
+}
+
 /**
  * @brief Allocate a new Queue data structure to the heap. Do not allocate
  *        the queue properties here. Queue properties are allocated in
@@ -31,12 +59,83 @@ static queue_t *queue_alloc(const size_t cap)
 queue_t *queue_new(const size_t cap, const size_t len)
 {
   queue_t *self = NULL;
-  self = queue_alloc(cap);
+  self = queue_alloc(cap, false);
+  self->cap = cap;
+  self->len = len;
+  self->copy_in = copy_select(len, true);
+  self->copy_out = copy_select(len, false);
+  self->prefetch = QUEUE_PREFETCH;
+  queue_instrument(self);
+  return self;
+}
+
+/**
+ * @brief Allocate a new Queue data structure whose buffer is mapped rather
+ *        than allocated and zeroed. Creation is constant time in cap and
+ *        buffer pages are only committed when the Queue first writes them.
+ * @param cap The maximum capacity allow in the Queue data structure.
+ */
+queue_t *queue_new_lazy(const size_t cap, const size_t len)
+{
+  queue_t *self = NULL;
+  self = queue_alloc(cap, true);
   self->cap = cap;
   self->len = len;
+  self->copy_in = copy_select(len, true);
+  self->copy_out = copy_select(len, false);
+  self->prefetch = QUEUE_PREFETCH;
+  queue_instrument(self);
   return self;
 }
 
+/**
+ * @brief Set up a Queue data structure over memory owned by the caller.
+ *        Neither the container nor the buffer is allocated, so the Queue
+ *        may live in static, stack or arena memory of this process, and
+ *        the buffer may directly follow the container in one allocation.
+ *        It cannot be shared between processes: the buffer is referenced
+ *        by absolute address and the instrumentation lives on the heap.
+ * @param self A pointer to the uninitialized Queue container.
+ * @param buffer A buffer of at least cap bytes.
+ * @param cap The maximum capacity allow in the Queue data structure.
+ */
+void queue_init(queue_t *self, void *buffer, const size_t cap, const size_t len)
+{
+  if (self == NULL || buffer == NULL)
+  {
+    fprintf(stderr, "%s(): %s\n", __func__, "queue instance and buffer may not be null");
+    exit(EXIT_FAILURE);
+  }
+
+  memset(self, 0, sizeof(*self));
+  self->data = (uint8_t *)buffer;
+  self->cap = cap;
+  self->len = len;
+  self->copy_in = copy_select(len, true);
+  self->copy_out = copy_select(len, false);
+  self->prefetch = QUEUE_PREFETCH;
+  self->metrics = metrics_attach();
+  queue_instrument(self);
+}
+
+/**
+ * @brief Tear down a Queue set up by queue_init(). The container and the
+ *        buffer remain owned by the caller.
+ * @param self A pointer to the Queue container.
+ */
+void queue_fini(queue_t *self)
+{
+  if (self == NULL)
+  {
+    return;
+  }
+
+  metrics_destroy(self->metrics);
+  histogram_destroy(self->latency);
+  __free(self->stamps);
+  self->data = NULL;
+}
+
 /**
  * @brief Deallocate an existing Queue data structure from the heap.
  * @param self A double pointer to the Queue container.
@@ -45,7 +144,17 @@ void __queue_destroy(queue_t **self)
 {
   if (self != NULL && *self != NULL)
   {
-    __free((*self)->data);
+    if (true == (*self)->mapped)
+    {
+      _unmap((*self)->data, (*self)->cap);
+    }
+    else
+    {
+      __free((*self)->data);
+    }
+    metrics_destroy((*self)->metrics);
+    histogram_destroy((*self)->latency);
+    __free((*self)->stamps);
     ___free(*self);
     *self = NULL;
   }
@@ -92,6 +201,11 @@ static inline void always_inline __queue_try_switch_to_b(queue_t *self)
 {
   if ((self->cap - self->a_end) < (self->a_start - self->b_end))
   {
+    if (false == self->b_inuse)
+    {
+      TURNPIKE_PROBE3(queue_switch_to_b, self, __queue_used(self), self->len);
+    }
+
     self->b_inuse = true;
   }
 }
@@ -139,24 +253,76 @@ bool queue_enqueue(queue_t *self, const void *data)
 
   if (__queue_unused(self) < self->len)
   {
+    TURNPIKE_PROBE3(queue_enqueue_full, self, __queue_used(self), self->len);
+    metrics_record(self->metrics, METRICS_FULL, __queue_used(self));
+    recorder_record(self->recorder, RECORDER_FULL, self->len);
     return false;
   }
 
   if (true == self->b_inuse)
   {
-    memcpy((self->data + self->b_end), data, self->len * sizeof(*self->data));
+    self->copy_in((self->data + self->b_end), data, self->len);
+    latency_stamp(self->stamps, (self->b_end / self->len));
     self->b_end += self->len;
   }
   else
   {
-    memcpy((self->data + self->a_end), data, self->len * sizeof(*self->data));
+    self->copy_in((self->data + self->a_end), data, self->len);
+    latency_stamp(self->stamps, (self->a_end / self->len));
     self->a_end += self->len;
   }
 
   __queue_try_switch_to_b(self);
+
+  if (self->prefetch != 0)
+  {
+    const size_t ahead = ((true == self->b_inuse) ? self->b_end : self->a_end) + (self->prefetch * self->len);
+
+    if (ahead < self->cap)
+    {
+      __builtin_prefetch((self->data + ahead), 1, 3);
+    }
+  }
+
+  TURNPIKE_PROBE3(queue_enqueue, self, __queue_used(self), self->len);
+  metrics_record(self->metrics, METRICS_ENQUEUE, __queue_used(self));
+  recorder_record(self->recorder, RECORDER_ENQUEUE, self->len);
   return true;
 }
 
+/**
+ * @brief Copy the item at the front of a non-empty Queue out and remove it,
+ *        moving the read region over to B once A has been drained.
+ */
+static inline void always_inline __queue_take(queue_t *self, void *data)
+{
+  self->copy_out(data, (self->data + self->a_start), self->len);
+  latency_record(self->latency, self->stamps, (self->a_start / self->len));
+  self->a_start += self->len;
+
+  if (__queue_empty(self))
+  {
+    if (true == self->b_inuse)
+    {
+      self->a_start = 0;
+      self->a_end   = self->b_end;
+      self->b_end   = 0;
+      self->b_inuse = false;
+    }
+    else
+    {
+      self->a_start = 0;
+      self->a_end   = 0;
+    }
+  }
+
+  __queue_try_switch_to_b(self);
+
+  TURNPIKE_PROBE3(queue_dequeue, self, __queue_used(self), self->len);
+  metrics_record(self->metrics, METRICS_DEQUEUE, __queue_used(self));
+  recorder_record(self->recorder, RECORDER_DEQUEUE, self->len);
+}
+
 /**
  * @brief Remove an item from the Queue data structure.
  * @param self A pointer to the Queue container.
@@ -172,6 +338,7 @@ void *queue_dequeue(queue_t *self)
 
   if (__queue_empty(self))
   {
+    metrics_record(self->metrics, METRICS_EMPTY, 0);
     return NULL;
   }
 
@@ -183,27 +350,62 @@ void *queue_dequeue(queue_t *self)
   void *data = NULL;
   data = _calloc(self->len, sizeof(*self->data));
 
-  memcpy(data, (self->data + self->a_start), self->len * sizeof(*self->data));
-  self->a_start += self->len;
+  __queue_take(self, data);
 
-  if (__queue_empty(self))
+  if (trim_policy_tick(&self->trim, __queue_used(self)))
   {
-    if (true == self->b_inuse)
-    {
-      self->a_start = 0;
-      self->a_end   = self->b_end;
-      self->b_end   = 0;
-      self->b_inuse = false;
-    }
-    else
+    queue_trim(self);
+  }
+
+  return data;
+}
+
+/**
+ * @brief Remove up to max items from the front of the Queue data structure
+ *        into an array owned by the caller. With a prefetch distance set,
+ *        the consumer prefetches that many slots ahead while it copies, in
+ *        the hope of overlapping the misses of a backlog larger than the
+ *        cache.
+ * @param self A pointer to the Queue container.
+ * @param items An array of at least max items of len bytes.
+ * @param max The maximum number of items to remove.
+ * @return The number of items removed.
+ */
+size_t queue_dequeue_batch(queue_t *self, void *items, const size_t max)
+{
+  if (self == NULL || items == NULL)
+  {
+    fprintf(stderr, "%s(): %s\n", __func__, "queue instance and items may not be null");
+    exit(EXIT_FAILURE);
+  }
+
+  const size_t ahead = self->prefetch * self->len;
+  uint8_t *out = (uint8_t *)items;
+  size_t n = 0;
+
+  while (n < max && false == __queue_empty(self) && (self->a_start + self->len) <= self->cap)
+  {
+    if (ahead != 0 && (self->a_start + ahead) < self->a_end)
     {
-      self->a_start = 0;
-      self->a_end   = 0;
+      __builtin_prefetch((self->data + self->a_start + ahead), 0, 0);
     }
+
+    __queue_take(self, (out + (n * self->len)));
+    n++;
   }
 
-  __queue_try_switch_to_b(self);
-  return data;
+  if (n == 0)
+  {
+    metrics_record(self->metrics, METRICS_EMPTY, 0);
+    return 0;
+  }
+
+  if (trim_policy_tick(&self->trim, __queue_used(self)))
+  {
+    queue_trim(self);
+  }
+
+  return n;
 }
 
 /**
@@ -232,7 +434,7 @@ void *queue_peek(queue_t *self)
   void *data = NULL;
   data = _calloc(self->len, sizeof(*self->data));
 
-  memcpy(data, (self->data + self->a_start), self->len * sizeof(*self->data));
+  self->copy_out(data, (self->data + self->a_start), self->len);
 
   return data;
 }
@@ -252,3 +454,120 @@ size_t queue_size(queue_t *self)
 
   return __queue_used(self);
 }
+
+/**
+ * @brief Return the pages of the queue buffer that hold no items to the
+ *        operating system without reallocating the buffer. While region B
+ *        is in use the gap between B and A is free, otherwise everything
+ *        in front of A is free; the space behind A is free in both cases.
+ * @param self A pointer to the Queue container.
+ * @return The number of bytes released.
+ */
+size_t queue_trim(queue_t *self)
+{
+  if (self == NULL)
+  {
+    fprintf(stderr, "%s(): %s\n", __func__, "queue instance may not be null");
+    exit(EXIT_FAILURE);
+  }
+
+  size_t released = 0;
+
+  released += _release(self->data, ((true == self->b_inuse) ? self->b_end : 0), self->a_start);
+  released += _release(self->data, self->a_end, self->cap);
+
+  return released;
+}
+
+/**
+ * @brief Trim the Queue automatically once its occupancy has stayed at or
+ *        below a watermark for a number of consecutive dequeues.
+ * @param self A pointer to the Queue container.
+ * @param watermark The occupancy in bytes considered idle.
+ * @param period The number of idle dequeues before trimming, or zero to
+ *        disable automatic trimming.
+ */
+void queue_set_trim_policy(queue_t *self, const size_t watermark, const size_t period)
+{
+  if (self == NULL)
+  {
+    fprintf(stderr, "%s(): %s\n", __func__, "queue instance may not be null");
+    exit(EXIT_FAILURE);
+  }
+
+  self->trim.watermark = watermark;
+  self->trim.period    = period;
+  self->trim.ticks     = 0;
+  self->trim.armed     = false;
+}
+
+/**
+ * @brief Copy the metrics of the Queue into a snapshot. The Queue keeps
+ *        metrics only when the library is built with TURNPIKE_METRICS.
+ * @param self A pointer to the Queue container.
+ * @param snapshot Receives the metrics of the Queue.
+ * @return Whether or not the Queue collects metrics.
+ */
+bool queue_metrics(queue_t *self, metrics_snapshot_t *snapshot)
+{
+  if (self == NULL)
+  {
+    fprintf(stderr, "%s(): %s\n", __func__, "queue instance may not be null");
+    exit(EXIT_FAILURE);
+  }
+
+  return metrics_snapshot(self->metrics, snapshot);
+}
+
+/**
+ * @brief Summarize how long items stayed in the Queue before they were
+ *        dequeued. The Queue records dwell-times only when the library is
+ *        built with TURNPIKE_LATENCY.
+ * @param self A pointer to the Queue container.
+ * @param snapshot Receives the p50, p99 and p999 dwell-times.
+ * @return Whether or not the Queue records dwell-times.
+ */
+bool queue_latency(queue_t *self, latency_snapshot_t *snapshot)
+{
+  if (self == NULL)
+  {
+    fprintf(stderr, "%s(): %s\n", __func__, "queue instance may not be null");
+    exit(EXIT_FAILURE);
+  }
+
+  return histogram_latency(self->latency, snapshot);
+}
+
+/**
+ * @brief Record every enqueue, refused enqueue and dequeue of the Queue
+ *        to a recorder. The Queue does not take ownership of the recorder.
+ * @param self A pointer to the Queue container.
+ * @param recorder The recorder, or NULL to stop recording.
+ */
+void queue_set_recorder(queue_t *self, recorder_t *recorder)
+{
+  if (self == NULL)
+  {
+    fprintf(stderr, "%s(): %s\n", __func__, "queue instance may not be null");
+    exit(EXIT_FAILURE);
+  }
+
+  self->recorder = recorder;
+}
+
+/**
+ * @brief Set how many items ahead the batch consumer prefetches and the
+ *        producer prefetches for writing.
+ * @param self A pointer to the Queue container.
+ * @param items The prefetch distance in items, or zero to disable.
+ */
+void queue_set_prefetch(queue_t *self, const size_t items)
+{
+  if (self == NULL)
+  {
+    fprintf(stderr, "%s(): %s\n", __func__, "queue instance may not be null");
+    exit(EXIT_FAILURE);
+  }
+
+  self->prefetch = items;
+}
@@ -0,0 +1,263 @@
+#include "common.h"
+#include "histogram.h"
+#include "recorder.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RECORDER_MAGIC   "TPRC"
+#define RECORDER_VERSION 1
+
+/**
+ * @brief The longest encoding of one event: the operation and two 64-bit
+ *        varints.
+ */
+#define RECORDER_EVENT_MAX (1 + 10 + 10)
+
+/**
+ * @brief Allocate a new recorder to the heap and create its file.
+ * @note Do not implement your calls to the heap here. Instead, please use
+ *       the wrapper functions specified in common.h. These functions
+ *       deal with common problems like exception handling and fragmentation.
+ * @param path The path of the file, which is truncated.
+ * @return The recorder, or NULL when the file could not be created.
+ */
+recorder_t *recorder_new(const char *path)
+{
+  FILE *fp = NULL;
+
+  if (path == NULL || NULL == (fp = fopen(path, "wb")))
+  {
+    return NULL;
+  }
+
+  const uint8_t header[8] = { 'T', 'P', 'R', 'C', RECORDER_VERSION, 0, 0, 0 };
+
+  if (sizeof(header) != fwrite(header, 1, sizeof(header), fp))
+  {
+    fclose(fp);
+    return NULL;
+  }
+
+  recorder_t *self = NULL;
+  self = (recorder_t *)_calloc(1, sizeof(*self));
+
+  self->fp = fp;
+  self->start = histogram_now();
+  self->last = self->start;
+
+  return self;
+}
+
+/**
+ * @brief Flush and close the file of a recorder and deallocate it from the
+ *        heap. Detach it from its queue first.
+ * @param self A double pointer to the recorder.
+ */
+void __recorder_destroy(recorder_t **self)
+{
+  if (self != NULL && *self != NULL)
+  {
+    recorder_flush(*self);
+    fclose((*self)->fp);
+    ___free(*self);
+    *self = NULL;
+  }
+}
+
+/**
+ * @brief Write the buffered events of a recorder to its file.
+ * @return Whether or not every event was written.
+ */
+bool recorder_flush(recorder_t *self)
+{
+  if (self == NULL)
+  {
+    return false;
+  }
+
+  const size_t used = self->used;
+  self->used = 0;
+
+  if (used != fwrite(self->buffer, 1, used, self->fp))
+  {
+    return false;
+  }
+
+  return 0 == fflush(self->fp);
+}
+
+static size_t recorder_put_varint(uint8_t *buffer, uint64_t value)
+{
+  size_t n = 0;
+
+  while (value >= 0x80)
+  {
+    buffer[n++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+
+  buffer[n++] = (uint8_t)value;
+  return n;
+}
+
+/**
+ * @brief Append an event to a recorder. The time is stored relative to the
+ *        previous event.
+ * @param self A pointer to the recorder.
+ * @param op The operation that took place.
+ * @param size The size of the item in bytes.
+ */
+void recorder_log(recorder_t *self, const enum recorder_op op, const size_t size)
+{
+  if (self == NULL)
+  {
+    return;
+  }
+
+  if ((self->used + RECORDER_EVENT_MAX) > RECORDER_BUFFER)
+  {
+    recorder_flush(self);
+  }
+
+  const uint64_t now = histogram_now();
+  const uint64_t delta = (now > self->last) ? (now - self->last) : 0;
+
+  self->last = (now > self->last) ? now : self->last;
+
+  uint8_t *out = self->buffer + self->used;
+  size_t n = 0;
+
+  out[n++] = (uint8_t)op;
+  n += recorder_put_varint(out + n, delta);
+  n += recorder_put_varint(out + n, size);
+
+  self->used += n;
+  self->events++;
+}
+
+static bool recorder_get_varint(const uint8_t *buffer, const size_t size, size_t *at, uint64_t *value)
+{
+  unsigned shift = 0;
+  *value = 0;
+
+  while (*at < size && shift < 64)
+  {
+    const uint8_t byte = buffer[(*at)++];
+    *value |= (uint64_t)(byte & 0x7f) << shift;
+
+    if ((byte & 0x80) == 0)
+    {
+      return true;
+    }
+
+    shift += 7;
+  }
+
+  return false;
+}
+
+/**
+ * @brief Decode the events of a recording. When events is NULL they are
+ *        only counted.
+ * @return The number of events, or SIZE_MAX when the recording is corrupt.
+ */
+static size_t recorder_decode(const uint8_t *buffer, const size_t size, struct recorder_event *events)
+{
+  size_t at = 0;
+  size_t n = 0;
+  uint64_t time = 0;
+  uint64_t delta = 0;
+  uint64_t length = 0;
+
+  while (at < size)
+  {
+    const uint8_t op = buffer[at++];
+
+    if (op >= RECORDER_OPS
+      || false == recorder_get_varint(buffer, size, &at, &delta)
+      || false == recorder_get_varint(buffer, size, &at, &length))
+    {
+      return SIZE_MAX;
+    }
+
+    time += delta;
+
+    if (events != NULL)
+    {
+      events[n].time = time;
+      events[n].size = (uint32_t)length;
+      events[n].op = op;
+    }
+
+    n++;
+  }
+
+  return n;
+}
+
+/**
+ * @brief Read every event of a recording into memory.
+ * @param path The path of the file.
+ * @param count Receives the number of events.
+ * @return An array of events to be released with recorder_events_free(),
+ *         or NULL when the file could not be read or is not a recording.
+ */
+struct recorder_event *recorder_load(const char *path, size_t *count)
+{
+  struct recorder_event *events = NULL;
+  uint8_t *buffer = NULL;
+  uint8_t header[8];
+  FILE *fp = NULL;
+  long size = 0;
+
+  if (path == NULL || count == NULL || NULL == (fp = fopen(path, "rb")))
+  {
+    return NULL;
+  }
+
+  if (sizeof(header) != fread(header, 1, sizeof(header), fp)
+    || 0 != memcmp(header, RECORDER_MAGIC, 4)
+    || header[4] != RECORDER_VERSION
+    || 0 != fseek(fp, 0, SEEK_END)
+    || 0 > (size = ftell(fp) - (long)sizeof(header))
+    || 0 != fseek(fp, (long)sizeof(header), SEEK_SET))
+  {
+    fclose(fp);
+    return NULL;
+  }
+
+  buffer = (uint8_t *)_calloc((size_t)size + 1, sizeof(*buffer));
+
+  if ((size_t)size == fread(buffer, 1, (size_t)size, fp))
+  {
+    const size_t n = recorder_decode(buffer, (size_t)size, NULL);
+
+    if (n != SIZE_MAX)
+    {
+      events = (struct recorder_event *)_calloc(n + 1, sizeof(*events));
+      recorder_decode(buffer, (size_t)size, events);
+      *count = n;
+    }
+  }
+
+  __free(buffer);
+  fclose(fp);
+
+  return events;
+}
+
+/**
+ * @brief Release the events returned by recorder_load().
+ * @param events The array of events, or NULL.
+ */
+void recorder_events_free(struct recorder_event *events)
+{
+  if (events != NULL)
+  {
+    ___free(events);
+  }
+}
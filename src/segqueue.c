@@ -0,0 +1,307 @@
+#include "common.h"
+#include "segqueue.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Take a segment from the free list or, when the free list is
+ *        empty, allocate a new one to the heap.
+ * @note Do not implement your calls to the heap here. Instead, please use
+ *       the wrapper functions specified in common.h. These functions
+ *       deal with common problems like exception handling and fragmentation.
+ */
+static struct segment *segment_acquire(seg_queue_t *self)
+{
+  struct segment *segment = NULL;
+
+  if (self->spare != NULL)
+  {
+    segment = self->spare;
+    self->spare = segment->next;
+    self->nspare--;
+  }
+  else
+  {
+    segment = (struct segment *)_calloc(1, sizeof(*segment) + self->cap);
+  }
+
+  segment->next = NULL;
+  segment->r = 0;
+  segment->w = 0;
+
+  return segment;
+}
+
+/**
+ * @brief Put a drained segment back on the free list, or return it to the
+ *        heap when the free list is already at its limit.
+ */
+static void segment_release(seg_queue_t *self, struct segment *segment)
+{
+  if (self->nspare >= self->max_spare)
+  {
+    ___free(segment);
+    return;
+  }
+
+  segment->next = self->spare;
+  self->spare = segment;
+  self->nspare++;
+}
+
+/**
+ * @brief Deallocate every segment in a singly linked segment list.
+ */
+static void segment_free_list(struct segment *segment)
+{
+  struct segment *next = NULL;
+
+  while (segment != NULL)
+  {
+    next = segment->next;
+    ___free(segment);
+    segment = next;
+  }
+}
+
+static inline void always_inline __seg_queue_lock(seg_queue_t *self)
+{
+  if (pthread_mutex_lock(&self->lock) != 0)
+  {
+    die("could not lock mutex");
+  }
+}
+
+static inline void always_inline __seg_queue_unlock(seg_queue_t *self)
+{
+  if (pthread_mutex_unlock(&self->lock) != 0)
+  {
+    die("could not unlock mutex");
+  }
+}
+
+/**
+ * @brief Allocate a new Queue data structure to the heap. The capacity of
+ *        every segment is rounded down to a whole number of items.
+ * @param cap The capacity in bytes of every segment in the Queue.
+ * @param len The length in bytes of every item in the Queue.
+ */
+seg_queue_t *seg_queue_new(const size_t cap, const size_t len)
+{
+  if (len == 0 || cap < len)
+  {
+    die("segment capacity must hold at least one item");
+  }
+
+  seg_queue_t *self = NULL;
+  self = (seg_queue_t *)_calloc(1, sizeof(*self));
+
+  if (pthread_mutex_init(&self->lock, NULL) != 0)
+  {
+    die("could not init mutex lock");
+  }
+
+  self->cap = (cap / len) * len;
+  self->len = len;
+  self->max_spare = SEG_QUEUE_SPARE_SEGMENTS;
+
+  self->head = segment_acquire(self);
+  self->tail = self->head;
+
+  return self;
+}
+
+/**
+ * @brief Deallocate an existing Queue data structure from the heap.
+ * @param self A double pointer to the Queue container.
+ */
+void __seg_queue_destroy(seg_queue_t **self)
+{
+  if (self != NULL && *self != NULL)
+  {
+    segment_free_list((*self)->head);
+    segment_free_list((*self)->spare);
+    pthread_mutex_destroy(&(*self)->lock);
+    ___free(*self);
+    *self = NULL;
+  }
+}
+
+/**
+ * @brief Add an item to the Queue data structure. The Queue grows by one
+ *        segment whenever the tail segment is full; running out of memory
+ *        for a segment exits the process like every other allocation in
+ *        turnpike, so this call never fails.
+ * @param self A pointer to the Queue container.
+ * @param data The item to be added to the Queue data structure.
+ * @return Always true. The return type matches the other Queues so that
+ *         callers can swap them.
+ */
+bool seg_queue_enqueue(seg_queue_t *self, const void *data)
+{
+  if (self == NULL)
+  {
+    die("queue instance may not be null");
+  }
+
+  __seg_queue_lock(self);
+
+  struct segment *tail = self->tail;
+
+  if ((tail->w + self->len) > self->cap)
+  {
+    tail->next = segment_acquire(self);
+    tail = tail->next;
+    self->tail = tail;
+  }
+
+  memcpy((tail->data + tail->w), data, self->len * sizeof(*tail->data));
+  tail->w += self->len;
+  self->size += self->len;
+
+  __seg_queue_unlock(self);
+  return true;
+}
+
+/**
+ * @brief Remove an item from the Queue data structure. A head segment that
+ *        has been completely written and read is recycled.
+ * @param self A pointer to the Queue container.
+ * @return The item currently removed from the front of the Queue.
+ */
+void *seg_queue_dequeue(seg_queue_t *self)
+{
+  if (self == NULL)
+  {
+    die("queue instance may not be null");
+  }
+
+  __seg_queue_lock(self);
+
+  struct segment *head = self->head;
+
+  if (head->r == head->w)
+  {
+    __seg_queue_unlock(self);
+    return NULL;
+  }
+
+  void *item = NULL;
+  item = calloc(self->len, sizeof(*head->data));
+
+  memcpy(item, (head->data + head->r), self->len * sizeof(*head->data));
+  head->r += self->len;
+  self->size -= self->len;
+
+  if (head->r == head->w)
+  {
+    if (head->next != NULL)
+    {
+      self->head = head->next;
+      segment_release(self, head);
+    }
+    else
+    {
+      // The only segment has been drained, so rewind it in place rather
+      // than cycling it through the free list.
+      head->r = 0;
+      head->w = 0;
+    }
+  }
+
+  __seg_queue_unlock(self);
+  return item;
+}
+
+/**
+ * @brief Return the item at the front of the Queue data structure.
+ * @param self A pointer to the Queue container.
+ * @return A copy of the item currently at the front of the Queue.
+ */
+void *seg_queue_peek(seg_queue_t *self)
+{
+  if (self == NULL)
+  {
+    die("queue instance may not be null");
+  }
+
+  __seg_queue_lock(self);
+
+  struct segment *head = self->head;
+
+  if (head->r == head->w)
+  {
+    __seg_queue_unlock(self);
+    return NULL;
+  }
+
+  void *item = NULL;
+  item = calloc(self->len, sizeof(*head->data));
+
+  memcpy(item, (head->data + head->r), self->len * sizeof(*head->data));
+
+  __seg_queue_unlock(self);
+  return item;
+}
+
+/**
+ * @brief Return the number of bytes currently in the Queue data structure.
+ * @param self A pointer to the Queue container.
+ * @return The current size of the Queue data structure.
+ */
+size_t seg_queue_size(seg_queue_t *self)
+{
+  if (self == NULL)
+  {
+    die("queue instance may not be null");
+  }
+
+  __seg_queue_lock(self);
+  const size_t size = self->size;
+  __seg_queue_unlock(self);
+
+  return size;
+}
+
+/**
+ * @brief Determine of the Queue data structure is empty.
+ * @param self A pointer to the Queue container.
+ * @return Whether or not the Queue data structure is empty.
+ */
+bool seg_queue_empty(seg_queue_t *self)
+{
+  return 0UL == seg_queue_size(self);
+}
+
+/**
+ * @brief Change the number of drained segments kept on the free list.
+ *        Segments beyond this limit are returned to the allocator.
+ * @param self A pointer to the Queue container.
+ * @param max_spare The maximum number of recycled segments to keep.
+ */
+void seg_queue_set_spare(seg_queue_t *self, const size_t max_spare)
+{
+  if (self == NULL)
+  {
+    die("queue instance may not be null");
+  }
+
+  __seg_queue_lock(self);
+
+  self->max_spare = max_spare;
+
+  while (self->nspare > self->max_spare)
+  {
+    struct segment *segment = self->spare;
+    self->spare = segment->next;
+    self->nspare--;
+    ___free(segment);
+  }
+
+  __seg_queue_unlock(self);
+}
@@ -0,0 +1,319 @@
+#include "common.h"
+#include "sharded.h"
+#include "spsc.h"
+
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * @brief The number of queues created so far, which names every queue, and
+ *        the number of consumer threads that have swept one so far.
+ */
+static atomic_uint_least64_t sharded_queues = 0;
+static atomic_size_t sharded_consumers = 0;
+
+/**
+ * @brief The lanes the calling thread was given, by the name of the queue,
+ *        and the lane its sweep starts from next.
+ */
+static _Thread_local struct
+{
+  uint64_t id;
+  size_t lane;
+} sharded_owned[SHARDED_QUEUE_CACHE];
+
+static _Thread_local size_t sharded_cursor = SIZE_MAX;
+
+/**
+ * @brief Return the lane of the calling thread in a queue, handing it the
+ *        next one on its first enqueue.
+ */
+static inline size_t always_inline sharded_producer_lane(sharded_queue_t *self)
+{
+  const size_t entry = (size_t)(self->id % SHARDED_QUEUE_CACHE);
+
+  if (sharded_owned[entry].id != self->id)
+  {
+    sharded_owned[entry].id = self->id;
+    sharded_owned[entry].lane = atomic_fetch_add_explicit(&self->producers, 1, memory_order_relaxed) % self->lanes;
+  }
+
+  return sharded_owned[entry].lane;
+}
+
+/**
+ * @brief Return the lane the sweep of the calling consumer starts from.
+ *        Consumers start spread out, without taking a producer lane.
+ */
+static inline size_t always_inline sharded_consumer_cursor(void)
+{
+  if (sharded_cursor == SIZE_MAX)
+  {
+    sharded_cursor = atomic_fetch_add_explicit(&sharded_consumers, 1, memory_order_relaxed);
+  }
+
+  return sharded_cursor;
+}
+
+static inline void always_inline sharded_lane_lock(atomic_bool *flag)
+{
+  while (true == atomic_exchange_explicit(flag, true, memory_order_acquire))
+  {
+    while (true == atomic_load_explicit(flag, memory_order_relaxed))
+    {
+      sched_yield();
+    }
+  }
+}
+
+static inline bool always_inline sharded_lane_trylock(atomic_bool *flag)
+{
+  return false == atomic_load_explicit(flag, memory_order_relaxed) &&
+         false == atomic_exchange_explicit(flag, true, memory_order_acquire);
+}
+
+static inline void always_inline sharded_lane_unlock(atomic_bool *flag)
+{
+  atomic_store_explicit(flag, false, memory_order_release);
+}
+
+/**
+ * @brief Allocate a new Queue data structure to the heap with one lane per
+ *        online CPU, or fewer when the capacity cannot give every lane an
+ *        item.
+ */
+sharded_queue_t *sharded_queue_new(const size_t cap, const size_t len)
+{
+  const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t lanes = (cpus > 0) ? (size_t)cpus : 1;
+
+  if (lanes > SHARDED_QUEUE_LANES)
+  {
+    lanes = SHARDED_QUEUE_LANES;
+  }
+
+  if (len != 0 && lanes > (cap / len))
+  {
+    lanes = (cap / len) ? (cap / len) : 1;
+  }
+
+  return sharded_queue_new_lanes(cap, len, lanes);
+}
+
+/**
+ * @brief Allocate a new Queue data structure to the heap. Every lane gets
+ *        an equal share of the capacity.
+ * @note Do not implement your calls to the heap here. Instead, please use
+ *       the wrapper functions specified in common.h. These functions
+ *       deal with common problems like exception handling and fragmentation.
+ */
+sharded_queue_t *sharded_queue_new_lanes(const size_t cap, const size_t len, const size_t lanes)
+{
+  if (lanes == 0 || lanes > SHARDED_QUEUE_LANES)
+  {
+    die("lanes must be between one and SHARDED_QUEUE_LANES");
+  }
+
+  if (len == 0 || (cap / lanes) < len)
+  {
+    die("capacity must hold at least one item per lane");
+  }
+
+  sharded_queue_t *self = NULL;
+  self = (sharded_queue_t *)_calloc(1, sizeof(*self));
+
+  self->lane = (struct sharded_lane *)mallocx((lanes * sizeof(*self->lane)), (MALLOCX_ZERO | MALLOCX_ALIGN(64)));
+  if (self->lane == NULL)
+  {
+    die("a memory error occurred");
+  }
+
+  self->cap = cap;
+  self->len = len;
+  self->lanes = lanes;
+  self->id = atomic_fetch_add_explicit(&sharded_queues, 1, memory_order_relaxed) + 1;
+  atomic_init(&self->producers, 0);
+
+  size_t i;
+  for (i = 0; i < lanes; i++)
+  {
+    atomic_init(&self->lane[i].producing, false);
+    atomic_init(&self->lane[i].consuming, false);
+    self->lane[i].ring = spsc_queue_new(cap / lanes, len);
+  }
+
+  return self;
+}
+
+/**
+ * @brief Deallocate an existing Queue data structure from the heap.
+ * @param self A double pointer to the Queue container.
+ */
+void __sharded_queue_destroy(sharded_queue_t **self)
+{
+  if (self != NULL && *self != NULL)
+  {
+    size_t i;
+    for (i = 0; i < (*self)->lanes; i++)
+    {
+      spsc_queue_destroy((*self)->lane[i].ring);
+    }
+
+    ___free((*self)->lane);
+    ___free(*self);
+    *self = NULL;
+  }
+}
+
+/**
+ * @brief Add an item to the lane of the calling thread.
+ * @param self A pointer to the Queue container.
+ * @param data The item to be added to the Queue data structure.
+ * @return Whether or not the item was added.
+ */
+bool sharded_queue_enqueue(sharded_queue_t *self, const void *data)
+{
+  return 1 == sharded_queue_enqueue_batch(self, data, 1);
+}
+
+/**
+ * @brief Add up to count items to the lane of the calling thread under a
+ *        single acquisition of its flag.
+ * @param self A pointer to the Queue container.
+ * @param items An array of count items of len bytes.
+ * @param count The number of items to add.
+ * @return The number of items added, from the front of items.
+ */
+size_t sharded_queue_enqueue_batch(sharded_queue_t *self, const void *items, const size_t count)
+{
+  if (self == NULL || items == NULL)
+  {
+    die("queue and items may not be null");
+  }
+
+  struct sharded_lane *lane = &self->lane[sharded_producer_lane(self)];
+  const uint8_t *item = (const uint8_t *)items;
+  size_t n;
+
+  sharded_lane_lock(&lane->producing);
+
+  for (n = 0; n < count; n++)
+  {
+    if (false == spsc_queue_enqueue(lane->ring, item + (n * self->len)))
+    {
+      break;
+    }
+  }
+
+  sharded_lane_unlock(&lane->producing);
+  return n;
+}
+
+/**
+ * @brief Remove an item from the next lane that has one.
+ * @param self A pointer to the Queue container.
+ * @return A copy of the item removed, or NULL when none was found.
+ */
+void *sharded_queue_dequeue(sharded_queue_t *self)
+{
+  if (self == NULL)
+  {
+    die("queue instance may not be null");
+  }
+
+  void *data = NULL;
+  data = _calloc(1, self->len);
+
+  if (0 == sharded_queue_dequeue_batch(self, data, 1))
+  {
+    __free(data);
+  }
+
+  return data;
+}
+
+/**
+ * @brief Remove up to max items into an array owned by the caller. The
+ *        sweep starts at the lane after the one this consumer last took
+ *        from, so every lane is served in turn however uneven the load.
+ * @param self A pointer to the Queue container.
+ * @param items An array of at least max items of len bytes.
+ * @param max The maximum number of items to remove.
+ * @return The number of items removed.
+ */
+size_t sharded_queue_dequeue_batch(sharded_queue_t *self, void *items, const size_t max)
+{
+  if (self == NULL || items == NULL)
+  {
+    die("queue and items may not be null");
+  }
+
+  uint8_t *item = (uint8_t *)items;
+  const size_t start = sharded_consumer_cursor();
+  size_t n = 0;
+  size_t visited;
+
+  for (visited = 0; visited < self->lanes && n < max; visited++)
+  {
+    const size_t index = (start + visited) % self->lanes;
+    struct sharded_lane *lane = &self->lane[index];
+
+    if (true == spsc_queue_empty(lane->ring) || false == sharded_lane_trylock(&lane->consuming))
+    {
+      continue;
+    }
+
+    const size_t before = n;
+
+    while (n < max && true == spsc_queue_pop(lane->ring, item + (n * self->len)))
+    {
+      n++;
+    }
+
+    sharded_lane_unlock(&lane->consuming);
+
+    if (n != before)
+    {
+      sharded_cursor = index + 1;
+    }
+  }
+
+  return n;
+}
+
+/**
+ * @brief Return the number of bytes currently in the Queue data structure.
+ * @param self A pointer to the Queue container.
+ */
+size_t sharded_queue_size(sharded_queue_t *self)
+{
+  if (self == NULL)
+  {
+    die("queue instance may not be null");
+  }
+
+  size_t size = 0;
+  size_t i;
+
+  for (i = 0; i < self->lanes; i++)
+  {
+    size += spsc_queue_size(self->lane[i].ring);
+  }
+
+  return size;
+}
+
+/**
+ * @brief Determine of the Queue data structure is empty.
+ * @param self A pointer to the Queue container.
+ */
+bool sharded_queue_empty(sharded_queue_t *self)
+{
+  return 0UL == sharded_queue_size(self);
+}
@@ -0,0 +1,192 @@
+#include "common.h"
+#include "spsc.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Allocate the Queue container and the queue buffer to the heap.
+ *        The container is aligned so that the head and the tail really do
+ *        sit on cache lines of their own.
+ * @note Do not implement your calls to the heap here. Instead, please use
+ *       the wrapper functions specified in common.h. These functions
+ *       deal with common problems like exception handling and fragmentation.
+ */
+static spsc_queue_t *spsc_queue_alloc(const size_t cap)
+{
+  spsc_queue_t *self = NULL;
+  self = (spsc_queue_t *)mallocx(sizeof(*self), (MALLOCX_ZERO | MALLOCX_ALIGN(64)));
+  if (self == NULL)
+  {
+    die("a memory error occurred");
+  }
+  self->data = (uint8_t *)_calloc(cap, sizeof(*self->data));
+  return self;
+}
+
+/**
+ * @brief Allocate a new Queue data structure to the heap. The capacity is
+ *        divided into whole slots of len bytes.
+ * @param cap The maximum capacity allow in the Queue data structure.
+ * @param len The length in bytes of every item in the Queue.
+ */
+spsc_queue_t *spsc_queue_new(const size_t cap, const size_t len)
+{
+  if (len == 0 || cap < len)
+  {
+    die("capacity must hold at least one item");
+  }
+
+  spsc_queue_t *self = NULL;
+  self = spsc_queue_alloc(cap);
+
+  atomic_init(&self->head, 0);
+  atomic_init(&self->tail, 0);
+
+  self->cap = cap;
+  self->len = len;
+  self->slots = cap / len;
+  self->copy_in = copy_select(len, true);
+  self->copy_out = copy_select(len, false);
+
+  return self;
+}
+
+/**
+ * @brief Deallocate an existing Queue data structure from the heap.
+ * @param self A double pointer to the Queue container.
+ */
+void __spsc_queue_destroy(spsc_queue_t **self)
+{
+  if (self != NULL && *self != NULL)
+  {
+    __free((*self)->data);
+    ___free(*self);
+    *self = NULL;
+  }
+}
+
+/**
+ * @brief Add an item to the Queue data structure. Producer only. The head
+ *        is re-read only when the cached copy says the Queue is full.
+ * @param self A pointer to the Queue container.
+ * @param data The item to be added to the Queue data structure.
+ * @return Whether or not the item was added.
+ */
+bool spsc_queue_enqueue(spsc_queue_t *self, const void *data)
+{
+  if (self == NULL)
+  {
+    die("queue instance may not be null");
+  }
+
+  const size_t tail = atomic_load_explicit(&self->tail, memory_order_relaxed);
+
+  if ((tail - self->head_cache) == self->slots)
+  {
+    self->head_cache = atomic_load_explicit(&self->head, memory_order_acquire);
+
+    if ((tail - self->head_cache) == self->slots)
+    {
+      return false;
+    }
+  }
+
+  self->copy_in((self->data + ((tail % self->slots) * self->len)), data, self->len);
+  atomic_store_explicit(&self->tail, tail + 1, memory_order_release);
+
+  return true;
+}
+
+/**
+ * @brief Remove the item at the front of the Queue data structure into a
+ *        buffer owned by the caller. Consumer only. The tail is re-read
+ *        only when the cached copy says the Queue is empty.
+ * @param self A pointer to the Queue container.
+ * @param data Receives the len bytes of the item.
+ * @return Whether or not an item was removed.
+ */
+bool spsc_queue_pop(spsc_queue_t *self, void *data)
+{
+  if (self == NULL)
+  {
+    die("queue instance may not be null");
+  }
+
+  const size_t head = atomic_load_explicit(&self->head, memory_order_relaxed);
+
+  if (head == self->tail_cache)
+  {
+    self->tail_cache = atomic_load_explicit(&self->tail, memory_order_acquire);
+
+    if (head == self->tail_cache)
+    {
+      return false;
+    }
+  }
+
+  self->copy_out(data, (self->data + ((head % self->slots) * self->len)), self->len);
+  atomic_store_explicit(&self->head, head + 1, memory_order_release);
+
+  return true;
+}
+
+/**
+ * @brief Remove the item at the front of the Queue data structure.
+ *        Consumer only.
+ * @param self A pointer to the Queue container.
+ * @return A copy of the item removed from the front of the Queue, or NULL
+ *         when the Queue is empty.
+ */
+void *spsc_queue_dequeue(spsc_queue_t *self)
+{
+  if (self == NULL)
+  {
+    die("queue instance may not be null");
+  }
+
+  if (true == spsc_queue_empty(self))
+  {
+    return NULL;
+  }
+
+  void *data = NULL;
+  data = _calloc(self->len, sizeof(*self->data));
+
+  spsc_queue_pop(self, data);
+  return data;
+}
+
+/**
+ * @brief Return the number of bytes currently in the Queue data structure.
+ *        Either side may call this; the answer may be stale by the time it
+ *        is returned.
+ * @param self A pointer to the Queue container.
+ * @return The current size of the Queue data structure.
+ */
+size_t spsc_queue_size(spsc_queue_t *self)
+{
+  if (self == NULL)
+  {
+    die("queue instance may not be null");
+  }
+
+  const size_t head = atomic_load_explicit(&self->head, memory_order_acquire);
+  const size_t tail = atomic_load_explicit(&self->tail, memory_order_acquire);
+
+  return (tail - head) * self->len;
+}
+
+/**
+ * @brief Determine of the Queue data structure is empty.
+ * @param self A pointer to the Queue container.
+ * @return Whether or not the Queue data structure is empty.
+ */
+bool spsc_queue_empty(spsc_queue_t *self)
+{
+  return 0UL == spsc_queue_size(self);
+}
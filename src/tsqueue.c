@@ -12,26 +12,30 @@
  *       the wrapper functions specified in common.h. These functions
  *       deal with common problems like exception handling and fragmentation.
  */
-static ts_queue_t *ts_queue_alloc(const size_t cap)
+static ts_queue_t *ts_queue_alloc(const size_t cap, const bool lazy)
 {
   ts_queue_t *self = NULL;
   self = (ts_queue_t *)_calloc(1, sizeof(*self));
-  self->data = (uint8_t *)_calloc(cap, sizeof(*self->data));
+
+  if (true == lazy)
+  {
+    self->data = (uint8_t *)_map(cap * sizeof(*self->data));
+    self->mapped = true;
+  }
+  else
+  {
+    self->data = (uint8_t *)_calloc(cap, sizeof(*self->data));
+  }
+
   return self;
 }
 
 /**
- * @brief Allocate a new Queue data structure to the heap. Do not allocate
- *        the queue properties here. Queue properties are allocated in
- *        queue_alloc() refer to it for more information. With that, this
- *        function sets up the Queue for usage.
+ * @brief Set up the properties of a Queue whose buffer is already in place.
  * @param cap The maximum capacity allow in the Queue data structure.
  */
-ts_queue_t *ts_queue_new(const size_t cap, const size_t len)
+static void ts_queue_setup(ts_queue_t *self, const size_t cap, const size_t len)
 {
-  ts_queue_t *self = NULL;
-  self = ts_queue_alloc(cap);
-
   atomic_init(&self->a_start, 0UL);
   atomic_init(&self->a_end,   0UL);
   atomic_init(&self->b_end,   0UL);
@@ -39,7 +43,37 @@ ts_queue_t *ts_queue_new(const size_t cap, const size_t len)
 
   self->cap = cap;
   self->len = len;
+  self->copy_in = copy_select(len, true);
+  self->copy_out = copy_select(len, false);
+  self->metrics = metrics_attach();
+}
 
+/**
+ * @brief Allocate a new Queue data structure to the heap. Do not allocate
+ *        the queue properties here. Queue properties are allocated in
+ *        queue_alloc() refer to it for more information. With that, this
+ *        function sets up the Queue for usage.
+ * @param cap The maximum capacity allow in the Queue data structure.
+ */
+ts_queue_t *ts_queue_new(const size_t cap, const size_t len)
+{
+  ts_queue_t *self = NULL;
+  self = ts_queue_alloc(cap, false);
+  ts_queue_setup(self, cap, len);
+  return self;
+}
+
+/**
+ * @brief Allocate a new Queue data structure whose buffer is mapped rather
+ *        than allocated and zeroed. Creation is constant time in cap and
+ *        buffer pages are only committed when the Queue first writes them.
+ * @param cap The maximum capacity allow in the Queue data structure.
+ */
+ts_queue_t *ts_queue_new_lazy(const size_t cap, const size_t len)
+{
+  ts_queue_t *self = NULL;
+  self = ts_queue_alloc(cap, true);
+  ts_queue_setup(self, cap, len);
   return self;
 }
 
@@ -51,7 +85,15 @@ void __ts_queue_destroy(ts_queue_t **self)
 {
   if (self != NULL && *self != NULL)
   {
-    __free((*self)->data);
+    if (true == (*self)->mapped)
+    {
+      _unmap((*self)->data, (*self)->cap);
+    }
+    else
+    {
+      __free((*self)->data);
+    }
+    metrics_destroy((*self)->metrics);
     ___free(*self);
     *self = NULL;
   }
@@ -163,6 +205,7 @@ bool ts_queue_enqueue(ts_queue_t *self, const void *data)
     atomic_exchange(&self->b_end,   b_end);
     atomic_exchange(&self->b_inuse, b_inuse);
 
+    metrics_record(self->metrics, METRICS_FULL, __ts_queue_used(self));
     return false;
   }
 
@@ -175,8 +218,9 @@ bool ts_queue_enqueue(ts_queue_t *self, const void *data)
     atomic_exchange(&self->b_end, b_end);
   }
 
-  memcpy((self->data + ((true == b_inuse) ? b_end : a_end)), data, self->len * sizeof(*self->data));
+  self->copy_in((self->data + ((true == b_inuse) ? b_end : a_end)), data, self->len);
 
+  metrics_record(self->metrics, METRICS_ENQUEUE, __ts_queue_used(self));
   return true;
 }
 
@@ -202,15 +246,18 @@ void *ts_queue_dequeue(ts_queue_t *self)
   if ((a_start == a_end) || (self->cap < (a_start + self->len)))
   {
     atomic_exchange(&self->a_start, a_start);
+    metrics_record(self->metrics, METRICS_EMPTY, 0);
     return NULL;
   }
 
   void *data = NULL;
   data = _calloc(self->len, sizeof(*self->data));
 
-  memcpy(data, (self->data + a_start), self->len * sizeof(*self->data));
+  self->copy_out(data, (self->data + a_start), self->len);
 
-  if (a_start == a_end)
+  // The item just removed was the last one in region A: rewind, making
+  // region B the new region A if it is in use.
+  if ((a_start + self->len) == a_end)
   {
     if (true == b_inuse)
     {
@@ -225,12 +272,12 @@ void *ts_queue_dequeue(ts_queue_t *self)
       atomic_store(&self->a_end,   0UL);
     }
   }
-
-  if ((self->cap - a_end) < (a_start - b_end))
+  else if ((self->cap - a_end) < (a_start - b_end))
   {
     atomic_store(&self->b_inuse, true);
   }
 
+  metrics_record(self->metrics, METRICS_DEQUEUE, __ts_queue_used(self));
   return data;
 }
 
@@ -259,7 +306,7 @@ void *ts_queue_peek(ts_queue_t *self)
   void *data = NULL;
   data = _calloc(self->len, sizeof(*self->data));
 
-  memcpy(data, (self->data + atomic_load(&self->a_start)), self->len * sizeof(*self->data));
+  self->copy_out(data, (self->data + atomic_load(&self->a_start)), self->len);
 
   return data;
 }
@@ -278,3 +325,20 @@ size_t ts_queue_size(ts_queue_t *self)
 
   return __ts_queue_used(self);
 }
+
+/**
+ * @brief Copy the metrics of the Queue into a snapshot. The Queue keeps
+ *        metrics only when the library is built with TURNPIKE_METRICS.
+ * @param self A pointer to the Queue container.
+ * @param snapshot Receives the metrics of the Queue.
+ * @return Whether or not the Queue collects metrics.
+ */
+bool ts_queue_metrics(ts_queue_t *self, metrics_snapshot_t *snapshot)
+{
+  if (self == NULL)
+  {
+    return false;
+  }
+
+  return metrics_snapshot(self->metrics, snapshot);
+}
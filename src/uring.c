@@ -0,0 +1,431 @@
+#include "bipbuf.h"
+#include "common.h"
+#include "uring.h"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+static int uring_setup(const unsigned entries, struct io_uring_params *params)
+{
+  return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uring_enter(const int ring, const unsigned submit, const unsigned complete, const unsigned flags)
+{
+  return (int)syscall(__NR_io_uring_enter, ring, submit, complete, flags, NULL, 0);
+}
+
+static int uring_register(const int ring, const unsigned opcode, void *arg, const unsigned count)
+{
+  return (int)syscall(__NR_io_uring_register, ring, opcode, arg, count);
+}
+
+/**
+ * @brief Unmap the rings and close the io_uring instance, which also
+ *        unregisters the buffer.
+ */
+static void uring_sink_close(uring_sink_t *self)
+{
+  if (self->sqes != NULL)
+  {
+    munmap(self->sqes, self->sqes_size);
+  }
+
+  if (self->cq_ring != NULL && self->cq_ring != self->sq_ring)
+  {
+    munmap(self->cq_ring, self->cq_ring_size);
+  }
+
+  if (self->sq_ring != NULL)
+  {
+    munmap(self->sq_ring, self->sq_ring_size);
+  }
+
+  if (self->ring >= 0)
+  {
+    close(self->ring);
+  }
+
+  __free(self->writes);
+  ___free(self);
+}
+
+/**
+ * @brief Map the submission and completion rings of a new io_uring
+ *        instance. Kernels with IORING_FEAT_SINGLE_MMAP share one mapping.
+ * @return Whether or not every ring could be mapped.
+ */
+static bool uring_sink_map(uring_sink_t *self, const struct io_uring_params *params)
+{
+  self->sq_ring_size = params->sq_off.array + (params->sq_entries * sizeof(unsigned));
+  self->cq_ring_size = params->cq_off.cqes + (params->cq_entries * sizeof(struct io_uring_cqe));
+  self->sqes_size = params->sq_entries * sizeof(struct io_uring_sqe);
+
+  if (params->features & IORING_FEAT_SINGLE_MMAP)
+  {
+    if (self->cq_ring_size > self->sq_ring_size)
+    {
+      self->sq_ring_size = self->cq_ring_size;
+    }
+    self->cq_ring_size = self->sq_ring_size;
+  }
+
+  void *sq = mmap(NULL, self->sq_ring_size, (PROT_READ | PROT_WRITE), (MAP_SHARED | MAP_POPULATE), self->ring, IORING_OFF_SQ_RING);
+  if (sq == MAP_FAILED)
+  {
+    return false;
+  }
+  self->sq_ring = sq;
+
+  if (params->features & IORING_FEAT_SINGLE_MMAP)
+  {
+    self->cq_ring = sq;
+  }
+  else
+  {
+    void *cq = mmap(NULL, self->cq_ring_size, (PROT_READ | PROT_WRITE), (MAP_SHARED | MAP_POPULATE), self->ring, IORING_OFF_CQ_RING);
+    if (cq == MAP_FAILED)
+    {
+      return false;
+    }
+    self->cq_ring = cq;
+  }
+
+  void *sqes = mmap(NULL, self->sqes_size, (PROT_READ | PROT_WRITE), (MAP_SHARED | MAP_POPULATE), self->ring, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED)
+  {
+    return false;
+  }
+  self->sqes = sqes;
+
+  uint8_t *sqr = (uint8_t *)self->sq_ring;
+  uint8_t *cqr = (uint8_t *)self->cq_ring;
+
+  self->sq_head  = (unsigned *)(sqr + params->sq_off.head);
+  self->sq_tail  = (unsigned *)(sqr + params->sq_off.tail);
+  self->sq_mask  = (unsigned *)(sqr + params->sq_off.ring_mask);
+  self->sq_array = (unsigned *)(sqr + params->sq_off.array);
+  self->cq_head  = (unsigned *)(cqr + params->cq_off.head);
+  self->cq_tail  = (unsigned *)(cqr + params->cq_off.tail);
+  self->cq_mask  = (unsigned *)(cqr + params->cq_off.ring_mask);
+  self->cqes     = (void *)(cqr + params->cq_off.cqes);
+
+  return true;
+}
+
+/**
+ * @brief Set up an io_uring sink that drains a buffer into a file.
+ * @note Do not implement your calls to the heap here. Instead, please use
+ *       the wrapper functions specified in common.h. These functions
+ *       deal with common problems like exception handling and fragmentation.
+ */
+uring_sink_t *uring_sink_new(bipbuf_t *buffer, const int fd, const uint64_t offset, const unsigned depth)
+{
+  if (buffer == NULL || fd < 0)
+  {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  unsigned entries = 1;
+  while (entries < ((depth == 0) ? URING_SINK_DEPTH : depth))
+  {
+    entries <<= 1;
+  }
+
+  uring_sink_t *self = NULL;
+  self = (uring_sink_t *)_calloc(1, sizeof(*self));
+  self->writes = (struct uring_write *)_calloc(entries, sizeof(*self->writes));
+  self->buffer = buffer;
+  self->fd = fd;
+  self->offset = offset;
+  self->chunk = URING_SINK_CHUNK;
+  self->depth = entries;
+
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+
+  if ((self->ring = uring_setup(entries, &params)) < 0)
+  {
+    const int error = errno;
+    uring_sink_close(self);
+    errno = error;
+    return NULL;
+  }
+
+  struct iovec iov = { .iov_base = buffer->data, .iov_len = buffer->cap };
+
+  if (false == uring_sink_map(self, &params) || uring_register(self->ring, IORING_REGISTER_BUFFERS, &iov, 1) < 0)
+  {
+    const int error = errno;
+    uring_sink_close(self);
+    errno = error;
+    return NULL;
+  }
+
+  bipbuf_set_trim_policy(buffer, 0, 0);
+
+  return self;
+}
+
+/**
+ * @brief Put a write, or what is left of it after a short write, on the
+ *        submission ring. Every write in flight holds exactly one entry,
+ *        so the ring cannot overflow.
+ */
+static void uring_sink_prep(uring_sink_t *self, const uint64_t seq)
+{
+  const struct uring_write *write = &self->writes[seq & (self->depth - 1)];
+  const unsigned tail = *self->sq_tail;
+  const unsigned index = tail & *self->sq_mask;
+  struct io_uring_sqe *sqe = &((struct io_uring_sqe *)self->sqes)[index];
+
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = IORING_OP_WRITE_FIXED;
+  sqe->fd = self->fd;
+  sqe->addr = (uint64_t)(uintptr_t)(write->data + write->done);
+  sqe->len = write->len - write->done;
+  sqe->off = write->offset + write->done;
+  sqe->buf_index = 0;
+  sqe->user_data = seq;
+
+  self->sq_array[index] = index;
+  __atomic_store_n(self->sq_tail, (tail + 1), __ATOMIC_RELEASE);
+
+  self->outstanding++;
+  self->unsubmitted++;
+}
+
+/**
+ * @brief Turn the completions that have arrived into progress: a short
+ *        write is put back on the ring for its remainder, and the writes
+ *        at the front that are done release their bytes, in order.
+ * @return The number of bytes released.
+ */
+static size_t uring_sink_reap(uring_sink_t *self)
+{
+  unsigned head = *self->cq_head;
+  const unsigned tail = __atomic_load_n(self->cq_tail, __ATOMIC_ACQUIRE);
+
+  while (head != tail)
+  {
+    const struct io_uring_cqe *cqe = &((struct io_uring_cqe *)self->cqes)[head & *self->cq_mask];
+    const uint64_t seq = cqe->user_data;
+    const int res = cqe->res;
+    struct uring_write *write = &self->writes[seq & (self->depth - 1)];
+
+    head++;
+    self->outstanding--;
+
+    if (res == -EAGAIN || res == -EINTR)
+    {
+      uring_sink_prep(self, seq);
+    }
+    else if (res < 0)
+    {
+      self->error = -res;
+    }
+    else if (res == 0)
+    {
+      self->error = EIO;
+    }
+    else if ((write->done += (uint32_t)res) < write->len)
+    {
+      uring_sink_prep(self, seq);
+    }
+  }
+
+  __atomic_store_n(self->cq_head, head, __ATOMIC_RELEASE);
+
+  size_t released = 0;
+
+  while (self->error == 0 && self->head != self->tail)
+  {
+    const struct uring_write *write = &self->writes[self->head & (self->depth - 1)];
+
+    if (write->done != write->len)
+    {
+      break;
+    }
+
+    released += write->len;
+    self->head++;
+  }
+
+  if (released != 0)
+  {
+    self->inflight -= released;
+    bipbuf_release(self->buffer, released);
+  }
+
+  return released;
+}
+
+/**
+ * @brief Start writes for the readable bytes that are not in flight yet,
+ *        at most one chunk each, while there is room for them.
+ */
+static void uring_sink_queue(uring_sink_t *self)
+{
+  while ((self->tail - self->head) < self->depth)
+  {
+    uint8_t *data = NULL;
+    size_t len = bipbuf_contiguous(self->buffer, self->inflight, &data);
+
+    if (len == 0)
+    {
+      break;
+    }
+
+    len = (len > self->chunk) ? self->chunk : len;
+
+    struct uring_write *write = &self->writes[self->tail & (self->depth - 1)];
+
+    write->data = data;
+    write->offset = self->offset;
+    write->len = (uint32_t)len;
+    write->done = 0;
+
+    uring_sink_prep(self, self->tail);
+
+    self->offset += len;
+    self->inflight += len;
+    self->tail++;
+  }
+}
+
+/**
+ * @brief Hand the entries on the submission ring to the kernel and,
+ *        optionally, wait for one completion.
+ * @return Whether or not the kernel accepted the call.
+ */
+static bool uring_sink_enter(uring_sink_t *self, const bool wait)
+{
+  const unsigned complete = (true == wait && self->outstanding != 0) ? 1 : 0;
+
+  if (self->unsubmitted == 0 && complete == 0)
+  {
+    return true;
+  }
+
+  const int submitted = uring_enter(self->ring, self->unsubmitted, complete, ((complete != 0) ? IORING_ENTER_GETEVENTS : 0));
+
+  if (submitted < 0)
+  {
+    if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+    {
+      return true;
+    }
+
+    self->error = errno;
+    return false;
+  }
+
+  self->unsubmitted -= (unsigned)submitted;
+  return true;
+}
+
+/**
+ * @brief Wait for the writes in flight and tear the sink down. Bytes whose
+ *        write completed are released from the buffer.
+ * @param self A double pointer to the sink.
+ */
+void __uring_sink_destroy(uring_sink_t **self)
+{
+  if (self != NULL && *self != NULL)
+  {
+    while ((*self)->outstanding != 0 && true == uring_sink_enter(*self, true))
+    {
+      uring_sink_reap(*self);
+    }
+
+    uring_sink_close(*self);
+    *self = NULL;
+  }
+}
+
+/**
+ * @brief Set the size in bytes of the largest single write. Smaller writes
+ *        let the kernel start on the front of a large backlog sooner and
+ *        release it sooner.
+ */
+void uring_sink_set_chunk(uring_sink_t *self, const size_t chunk)
+{
+  if (self == NULL || chunk == 0)
+  {
+    return;
+  }
+
+  self->chunk = (chunk > UINT32_MAX) ? UINT32_MAX : chunk;
+}
+
+/**
+ * @brief Reap, queue and submit, with at most one system call.
+ * @param self A pointer to the sink.
+ * @param wait Whether to block until at least one write completes when
+ *        any are in flight.
+ * @return The number of bytes released, or -1 with errno set when a write
+ *         failed.
+ */
+ssize_t uring_sink_submit(uring_sink_t *self, const bool wait)
+{
+  if (self == NULL)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  size_t released = 0;
+
+  if (self->error == 0)
+  {
+    released += uring_sink_reap(self);
+    uring_sink_queue(self);
+
+    if (true == uring_sink_enter(self, wait))
+    {
+      released += uring_sink_reap(self);
+    }
+  }
+
+  if (self->error != 0)
+  {
+    errno = self->error;
+    return -1;
+  }
+
+  return (ssize_t)released;
+}
+
+/**
+ * @brief Submit everything readable and wait until it is all written.
+ * @param self A pointer to the sink.
+ * @return Zero on success, or -1 with errno set when a write failed.
+ */
+int uring_sink_flush(uring_sink_t *self)
+{
+  if (self == NULL)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  while (false == bipbuf_empty(self->buffer))
+  {
+    if (uring_sink_submit(self, true) < 0)
+    {
+      return -1;
+    }
+  }
+
+  return 0;
+}
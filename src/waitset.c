@@ -0,0 +1,356 @@
+#include "bipartite.h"
+#include "common.h"
+#include "histogram.h"
+#include "waitset.h"
+
+#include <linux/futex.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * @brief Sleep on the futex word while it still holds an expected value.
+ * @param timeout The longest time to sleep in nanoseconds, or zero to sleep
+ *        until woken.
+ */
+static void waitset_sleep(atomic_uint *word, const unsigned expected, const uint64_t timeout)
+{
+  struct timespec ts = { (time_t)(timeout / 1000000000UL), (long)(timeout % 1000000000UL) };
+
+  syscall(SYS_futex, (uint32_t *)word, FUTEX_WAIT_PRIVATE, expected, ((timeout == 0) ? NULL : &ts), NULL, 0);
+}
+
+/**
+ * @brief Wake the consumer sleeping on the futex word.
+ */
+static void waitset_wake(atomic_uint *word)
+{
+  syscall(SYS_futex, (uint32_t *)word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+/**
+ * @brief Allocate a new, empty wait set to the heap.
+ * @param cap The greatest number of queues in the set, at most WAITSET_MAX.
+ * @note Do not implement your calls to the heap here. Instead, please use
+ *       the wrapper functions specified in common.h. These functions
+ *       deal with common problems like exception handling and fragmentation.
+ */
+waitset_t *waitset_new(const size_t cap)
+{
+  if (cap == 0 || cap > WAITSET_MAX)
+  {
+    die("capacity must be between one and WAITSET_MAX");
+  }
+
+  waitset_t *self = NULL;
+  self = (waitset_t *)mallocx(sizeof(*self), (MALLOCX_ZERO | MALLOCX_ALIGN(64)));
+  if (self == NULL)
+  {
+    die("a memory error occurred");
+  }
+
+  self->cap = cap;
+  self->ready = (atomic_ulong *)_calloc(((cap + WAITSET_WORD - 1) / WAITSET_WORD), sizeof(*self->ready));
+  self->members = (struct bipartite_queue **)_calloc(cap, sizeof(*self->members));
+
+  atomic_init(&self->summary, 0UL);
+  atomic_init(&self->seq, 0U);
+  atomic_init(&self->sleepers, 0U);
+
+  if (pthread_mutex_init(&self->lock, NULL) != 0)
+  {
+    die("could not initialize mutex");
+  }
+
+  return self;
+}
+
+/**
+ * @brief Deallocate an existing wait set from the heap. Members still in
+ *        the set are detached so that they stop signalling it.
+ * @param self A double pointer to the wait set.
+ */
+void __waitset_destroy(waitset_t **self)
+{
+  if (self != NULL && *self != NULL)
+  {
+    size_t slot;
+    for (slot = 0; slot < (*self)->cap; slot++)
+    {
+      if ((*self)->members[slot] != NULL)
+      {
+        waitset_remove(*self, (*self)->members[slot]);
+      }
+    }
+
+    pthread_mutex_destroy(&(*self)->lock);
+    __free((*self)->ready);
+    __free((*self)->members);
+    ___free(*self);
+    *self = NULL;
+  }
+}
+
+/**
+ * @brief Add a Queue to the wait set in the first free slot. The Queue
+ *        learns its slot under its own lock, so every enqueue that follows
+ *        signals the set; an item enqueued before that is caught by
+ *        checking the Queue once it has joined.
+ * @param self A pointer to the wait set.
+ * @param queue A pointer to the Queue container.
+ * @return Whether or not the Queue was added.
+ */
+bool waitset_add(waitset_t *self, struct bipartite_queue *queue)
+{
+  if (self == NULL || queue == NULL)
+  {
+    die("wait set and queue may not be null");
+  }
+
+  pthread_mutex_lock(&self->lock);
+
+  size_t slot;
+  for (slot = 0; slot < self->cap && self->members[slot] != NULL; slot++);
+
+  if (slot == self->cap)
+  {
+    pthread_mutex_unlock(&self->lock);
+    return false;
+  }
+
+  pthread_mutex_lock(&queue->lock);
+
+  if (queue->waitset != NULL)
+  {
+    pthread_mutex_unlock(&queue->lock);
+    pthread_mutex_unlock(&self->lock);
+    return false;
+  }
+
+  self->members[slot] = queue;
+  queue->waitset = self;
+  queue->slot = slot;
+
+  if (atomic_load(&queue->w) > atomic_load(&queue->r))
+  {
+    waitset_signal(self, slot);
+  }
+
+  pthread_mutex_unlock(&queue->lock);
+  pthread_mutex_unlock(&self->lock);
+
+  return true;
+}
+
+/**
+ * @brief Remove a Queue from the wait set and clear its ready bit.
+ *        Producers signal the set under the lock of the Queue, which is
+ *        taken here to detach it, so no signal for the Queue reaches the
+ *        set once this returns.
+ * @param self A pointer to the wait set.
+ * @param queue A pointer to the Queue container.
+ * @return Whether or not the Queue was a member.
+ */
+bool waitset_remove(waitset_t *self, struct bipartite_queue *queue)
+{
+  if (self == NULL || queue == NULL)
+  {
+    die("wait set and queue may not be null");
+  }
+
+  pthread_mutex_lock(&self->lock);
+  pthread_mutex_lock(&queue->lock);
+
+  if (queue->waitset != self)
+  {
+    pthread_mutex_unlock(&queue->lock);
+    pthread_mutex_unlock(&self->lock);
+    return false;
+  }
+
+  const size_t slot = queue->slot;
+
+  queue->waitset = NULL;
+  queue->slot = 0;
+
+  pthread_mutex_unlock(&queue->lock);
+
+  self->members[slot] = NULL;
+  atomic_fetch_and(&self->ready[slot / WAITSET_WORD], ~(1UL << (slot % WAITSET_WORD)));
+
+  pthread_mutex_unlock(&self->lock);
+  return true;
+}
+
+/**
+ * @brief Mark a member as ready. The first producer to mark a word also
+ *        marks the word in the summary, and only a producer that turned a
+ *        bit on bumps the futex word; the futex is woken only when the
+ *        consumer is asleep. The marks are set before the sleepers are
+ *        counted here and the sleepers are counted before the marks are
+ *        checked in waitset_wait(), so one side always sees the other.
+ * @param self A pointer to the wait set.
+ * @param slot The slot of the member.
+ */
+void waitset_signal(waitset_t *self, const size_t slot)
+{
+  const size_t word = slot / WAITSET_WORD;
+  const unsigned long bit = 1UL << (slot % WAITSET_WORD);
+
+  if ((atomic_load(&self->ready[word]) & bit) != 0)
+  {
+    return;
+  }
+
+  const unsigned long prior = atomic_fetch_or(&self->ready[word], bit);
+
+  if ((prior & bit) != 0)
+  {
+    return;
+  }
+
+  if (prior == 0)
+  {
+    atomic_fetch_or(&self->summary, (1UL << word));
+  }
+
+  atomic_fetch_add(&self->seq, 1U);
+
+  if (atomic_load(&self->sleepers) != 0)
+  {
+    waitset_wake(&self->seq);
+  }
+}
+
+/**
+ * @brief Take the ready members of a group of words. When ready fills up,
+ *        the marks that were not returned are put back.
+ * @param words The words to visit, as a mask of the summary.
+ * @return The number of Queues written to ready.
+ */
+static size_t waitset_take(waitset_t *self, unsigned long words, struct bipartite_queue **ready, size_t count, const size_t max)
+{
+  while (words != 0)
+  {
+    const size_t word = (size_t)__builtin_ctzl(words);
+
+    if (count == max)
+    {
+      atomic_fetch_or(&self->summary, words);
+      return count;
+    }
+
+    words &= (words - 1);
+
+    unsigned long bits = atomic_exchange(&self->ready[word], 0UL);
+
+    while (bits != 0 && count < max)
+    {
+      struct bipartite_queue *queue = self->members[(word * WAITSET_WORD) + (size_t)__builtin_ctzl(bits)];
+
+      bits &= (bits - 1);
+
+      if (queue != NULL)
+      {
+        ready[count++] = queue;
+      }
+    }
+
+    if (bits != 0)
+    {
+      atomic_fetch_or(&self->ready[word], bits);
+      atomic_fetch_or(&self->summary, (1UL << word));
+    }
+
+    self->next = (word + 1) % WAITSET_WORD;
+  }
+
+  return count;
+}
+
+/**
+ * @brief Take up to max ready members. Only the words marked in the
+ *        summary are visited, starting after the last word visited, so
+ *        that a few busy queues cannot starve the rest of the set.
+ * @return The number of Queues written to ready.
+ */
+static size_t waitset_collect(waitset_t *self, struct bipartite_queue **ready, const size_t max)
+{
+  if (atomic_load(&self->summary) == 0)
+  {
+    return 0;
+  }
+
+  const unsigned long summary = atomic_exchange(&self->summary, 0UL);
+  const unsigned long after = ~0UL << self->next;
+  size_t count = 0;
+
+  pthread_mutex_lock(&self->lock);
+
+  count = waitset_take(self, (summary & after), ready, count, max);
+  count = waitset_take(self, (summary & ~after), ready, count, max);
+
+  pthread_mutex_unlock(&self->lock);
+
+  return count;
+}
+
+/**
+ * @brief Block until at least one member is ready, then return the ready
+ *        members. Only one thread may wait on a set at a time.
+ * @param self A pointer to the wait set.
+ * @param ready Receives up to max ready Queues.
+ * @param max The capacity of ready.
+ * @param timeout The longest time to block in milliseconds, zero to poll
+ *        or negative to block indefinitely.
+ * @return The number of Queues written to ready, zero on timeout.
+ */
+size_t waitset_wait(waitset_t *self, struct bipartite_queue **ready, const size_t max, const int timeout)
+{
+  if (self == NULL || ready == NULL)
+  {
+    die("wait set and ready list may not be null");
+  }
+
+  const uint64_t deadline = (timeout > 0) ? (histogram_now() + ((uint64_t)timeout * 1000000UL)) : 0;
+
+  while (true)
+  {
+    const unsigned seq = atomic_load(&self->seq);
+    const size_t count = waitset_collect(self, ready, max);
+
+    if (count != 0 || timeout == 0)
+    {
+      return count;
+    }
+
+    uint64_t remaining = 0;
+
+    if (timeout > 0)
+    {
+      const uint64_t now = histogram_now();
+
+      if (now >= deadline)
+      {
+        return 0;
+      }
+
+      remaining = deadline - now;
+    }
+
+    atomic_fetch_add(&self->sleepers, 1U);
+
+    if (atomic_load(&self->summary) == 0)
+    {
+      waitset_sleep(&self->seq, seq, remaining);
+    }
+
+    atomic_fetch_sub(&self->sleepers, 1U);
+  }
+}
@@ -6,10 +6,13 @@
 
 #include "bipartite.h"
 
+#include <poll.h>
 #include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #ifndef unused
 #define unused __attribute__ ((unused))
@@ -27,6 +30,52 @@ static void bipartite_queue_new_test(void unused **state)
   assert_null(queue);
 }
 
+static void bipartite_queue_new_lazy_test(void unused **state)
+{
+  const size_t cap = 1024 * 1024 * 1024;
+  bipartite_queue_t *queue = NULL;
+
+  queue = bipartite_queue_new_lazy(cap, sizeof(int));
+  assert_non_null(queue);
+  assert_true(queue->mapped);
+
+  assert_true(bipartite_queue_empty(queue));
+  assert_true(bipartite_queue_enqueue(queue, &(int){1}));
+
+  const int *item = bipartite_queue_dequeue(queue);
+  assert_non_null(item);
+  assert_int_equal(*item, 1);
+  free((void *)item);
+  item = NULL;
+
+  bipartite_queue_destroy(queue);
+  assert_null(queue);
+}
+
+static void bipartite_queue_init_test(void unused **state)
+{
+  // Co-locate the Queue container with its buffer in one stack object.
+  struct
+  {
+    bipartite_queue_t queue;
+    uint8_t buffer[10 * sizeof(int)];
+  } owner;
+
+  bipartite_queue_init(&owner.queue, owner.buffer, sizeof(owner.buffer), sizeof(int));
+  assert_ptr_equal(owner.queue.data, owner.buffer);
+  assert_true(bipartite_queue_empty(&owner.queue));
+
+  assert_true(bipartite_queue_enqueue(&owner.queue, &(int){1}));
+  const int *item = bipartite_queue_dequeue(&owner.queue);
+  assert_non_null(item);
+  assert_int_equal(*item, 1);
+  free((void *)item);
+  item = NULL;
+
+  bipartite_queue_fini(&owner.queue);
+  assert_null(owner.queue.data);
+}
+
 static void bipartite_queue_enqueue_test(void unused **state)
 {
   const size_t cap = 10;
@@ -114,6 +163,191 @@ static void bipartite_queue_empty_test(void unused **state)
   assert_null(queue);
 }
 
+static void bipartite_queue_dequeue_batch_test(void unused **state)
+{
+  const size_t cap = 8 * sizeof(int);
+  bipartite_queue_t *queue = NULL;
+  int items[8] = { 0 };
+  int next = 0;
+  int expected = 0;
+  int i;
+
+  queue = bipartite_queue_new(cap, sizeof(int));
+  assert_non_null(queue);
+
+  bipartite_queue_set_prefetch(queue, 2);
+  assert_int_equal(bipartite_queue_dequeue_batch(queue, items, 8), 0);
+
+  for (i = 0; i < 8; i++, next++)
+  {
+    assert_true(bipartite_queue_enqueue(queue, &next));
+  }
+
+  assert_int_equal(bipartite_queue_dequeue_batch(queue, items, 5), 5);
+  for (i = 0; i < 5; i++, expected++)
+  {
+    assert_int_equal(items[i], expected);
+  }
+
+  // Refill across the end of the ring and drain it in one call.
+  for (i = 0; i < 5; i++, next++)
+  {
+    assert_true(bipartite_queue_enqueue(queue, &next));
+  }
+
+  assert_int_equal(bipartite_queue_dequeue_batch(queue, items, 8), 8);
+  for (i = 0; i < 8; i++, expected++)
+  {
+    assert_int_equal(items[i], expected);
+  }
+
+  assert_true(bipartite_queue_empty(queue));
+
+  bipartite_queue_destroy(queue);
+  assert_null(queue);
+}
+
+static bool readable(const int fd)
+{
+  struct pollfd pfd = { .fd = fd, .events = POLLIN };
+  return (poll(&pfd, 1, 0) == 1) && (pfd.revents & POLLIN);
+}
+
+static void bipartite_queue_enqueue_batch_test(void unused **state)
+{
+  const size_t cap = 8 * sizeof(int);
+  bipartite_queue_t *queue = NULL;
+  int items[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+  int out[8] = { 0 };
+  int i;
+
+  queue = bipartite_queue_new(cap, sizeof(int));
+  assert_non_null(queue);
+
+  assert_int_equal(bipartite_queue_enqueue_batch(queue, items, 5), 5);
+  assert_int_equal(bipartite_queue_dequeue_batch(queue, out, 3), 3);
+
+  // Only the items that fit are added, across the end of the ring.
+  assert_int_equal(bipartite_queue_enqueue_batch(queue, items, 8), 6);
+  assert_int_equal(bipartite_queue_enqueue_batch(queue, items, 1), 0);
+  assert_int_equal(bipartite_queue_size(queue), cap);
+
+  assert_int_equal(bipartite_queue_dequeue_batch(queue, out, 8), 8);
+  assert_int_equal(out[0], 3);
+  assert_int_equal(out[1], 4);
+  for (i = 2; i < 8; i++)
+  {
+    assert_int_equal(out[i], (i - 2));
+  }
+
+  bipartite_queue_destroy(queue);
+}
+
+static void bipartite_queue_fd_test(void unused **state)
+{
+  const size_t cap = 8 * sizeof(int);
+  bipartite_queue_t *queue = NULL;
+  uint64_t count = 0;
+  int item = 7;
+  int *out = NULL;
+
+  queue = bipartite_queue_new(cap, sizeof(int));
+  assert_non_null(queue);
+
+  const int fd = bipartite_queue_fd(queue);
+  assert_true(fd >= 0);
+  assert_int_equal(bipartite_queue_fd(queue), fd);
+  assert_false(readable(fd));
+
+  // Unarmed, a producer does not touch the descriptor.
+  assert_true(bipartite_queue_enqueue(queue, &item));
+  assert_false(readable(fd));
+
+  // Armed with items present, the consumer is told to dequeue instead.
+  assert_false(bipartite_queue_arm(queue));
+  out = bipartite_queue_dequeue(queue);
+  assert_int_equal(*out, 7);
+  free(out);
+
+  // Armed on an empty queue, a burst of enqueues signals exactly once.
+  assert_true(bipartite_queue_arm(queue));
+  assert_false(readable(fd));
+  assert_true(bipartite_queue_enqueue(queue, &item));
+  assert_true(bipartite_queue_enqueue(queue, &item));
+  assert_true(bipartite_queue_enqueue(queue, &item));
+  assert_true(readable(fd));
+  assert_int_equal(read(fd, &count, sizeof(count)), sizeof(count));
+  assert_int_equal(count, 1);
+
+  bipartite_queue_destroy(queue);
+  assert_null(queue);
+}
+
+static void bipartite_queue_latency_test(void unused **state)
+{
+  const size_t cap = 10 * sizeof(int);
+  latency_snapshot_t snapshot;
+  bipartite_queue_t *queue = NULL;
+  int i;
+
+  queue = bipartite_queue_new(cap, sizeof(int));
+  assert_non_null(queue);
+
+  for (i = 0; i < 20; i++)
+  {
+    assert_true(bipartite_queue_enqueue(queue, &i));
+    free(bipartite_queue_dequeue(queue));
+  }
+
+  // Dwell-times are only recorded when the library is built with them.
+  if (bipartite_queue_latency(queue, &snapshot))
+  {
+    assert_int_equal(snapshot.count, 20);
+    assert_true(snapshot.p50 <= snapshot.p99);
+    assert_true(snapshot.p99 <= snapshot.p999);
+  }
+  else
+  {
+    assert_int_equal(snapshot.count, 0);
+  }
+
+  bipartite_queue_destroy(queue);
+  assert_null(queue);
+}
+
+static void bipartite_queue_lock_profile_test(void unused **state)
+{
+  const size_t cap = 10 * sizeof(int);
+  lock_profile_t profile;
+  bipartite_queue_t *queue = NULL;
+
+  queue = bipartite_queue_new(cap, sizeof(int));
+  assert_non_null(queue);
+
+  assert_true(bipartite_queue_enqueue(queue, &(int){1}));
+  free(bipartite_queue_peek(queue));
+  free(bipartite_queue_dequeue(queue));
+  assert_int_equal(bipartite_queue_size(queue), 0);
+  assert_true(bipartite_queue_empty(queue));
+
+  // Lock profiles are only recorded when the library is built with them.
+  if (bipartite_queue_lock_profile(queue, &profile))
+  {
+    int op;
+    for (op = 0; op < LOCK_PROFILE_OPS; op++)
+    {
+      assert_int_equal((profile.op[op].uncontended + profile.op[op].contended), 1);
+    }
+  }
+  else
+  {
+    assert_int_equal(profile.op[LOCK_PROFILE_ENQUEUE].uncontended, 0);
+  }
+
+  bipartite_queue_destroy(queue);
+  assert_null(queue);
+}
+
 static bipartite_queue_t *target = NULL;
 
 static void *proca(void *arg)
@@ -191,11 +425,18 @@ int main(void)
 {
   const struct CMUnitTest tests[] = {
     cmocka_unit_test(bipartite_queue_new_test),
+    cmocka_unit_test(bipartite_queue_new_lazy_test),
+    cmocka_unit_test(bipartite_queue_init_test),
     cmocka_unit_test(bipartite_queue_enqueue_test),
     cmocka_unit_test(bipartite_queue_dequeue_test),
     cmocka_unit_test(bipartite_queue_peek_test),
     cmocka_unit_test(bipartite_queue_size_test),
     cmocka_unit_test(bipartite_queue_empty_test),
+    cmocka_unit_test(bipartite_queue_dequeue_batch_test),
+    cmocka_unit_test(bipartite_queue_enqueue_batch_test),
+    cmocka_unit_test(bipartite_queue_fd_test),
+    cmocka_unit_test(bipartite_queue_latency_test),
+    cmocka_unit_test(bipartite_queue_lock_profile_test),
     cmocka_unit_test(bipartite_queue_thread_safety_test),
   };
 
@@ -0,0 +1,187 @@
+#define _GNU_SOURCE
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+
+#include <cmocka/cmocka.h>
+
+#include "bipbuf.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifndef unused
+#define unused __attribute__ ((unused))
+#endif/*unused*/
+
+static void bipbuf_offer_poll_test(void unused **state)
+{
+  bipbuf_t *buffer = bipbuf_new(8);
+  uint8_t *data = NULL;
+
+  assert_non_null(buffer);
+  assert_true(bipbuf_empty(buffer));
+
+  assert_true(bipbuf_offer(buffer, "abcdef", 6));
+  assert_false(bipbuf_offer(buffer, "ghi", 3));
+
+  data = bipbuf_poll(buffer, 4);
+  assert_memory_equal(data, "abcd", 4);
+  free(data);
+
+  // Region A has 2 bytes left at the end, so the next offer goes to B.
+  assert_true(bipbuf_offer(buffer, "ghi", 3));
+  assert_true(buffer->b_inuse);
+
+  data = bipbuf_poll(buffer, 2);
+  assert_memory_equal(data, "ef", 2);
+  free(data);
+
+  data = bipbuf_poll(buffer, 3);
+  assert_memory_equal(data, "ghi", 3);
+  free(data);
+
+  assert_true(bipbuf_empty(buffer));
+
+  bipbuf_destroy(buffer);
+  assert_null(buffer);
+}
+
+static void bipbuf_write_test(void unused **state)
+{
+  bipbuf_t *buffer = bipbuf_new(8);
+  char out[16] = { 0 };
+  uint8_t *data = NULL;
+  int fds[2];
+
+  assert_int_equal(pipe(fds), 0);
+  assert_int_equal(bipbuf_write(buffer, fds[1]), 0);
+
+  // Both regions leave in one call, in order.
+  assert_true(bipbuf_offer(buffer, "abcdef", 6));
+  data = bipbuf_poll(buffer, 4);
+  free(data);
+  assert_true(bipbuf_offer(buffer, "ghi", 3));
+  assert_true(buffer->b_inuse);
+
+  assert_int_equal(bipbuf_write(buffer, fds[1]), 5);
+  assert_true(bipbuf_empty(buffer));
+  assert_false(buffer->b_inuse);
+  assert_int_equal(read(fds[0], out, sizeof(out)), 5);
+  assert_memory_equal(out, "efghi", 5);
+
+  close(fds[0]);
+  close(fds[1]);
+  bipbuf_destroy(buffer);
+}
+
+static void bipbuf_write_partial_test(void unused **state)
+{
+  const size_t cap = 4 * 4096;
+  bipbuf_t *buffer = bipbuf_new(cap);
+  uint8_t *in = malloc(cap);
+  uint8_t *out = malloc(cap);
+  size_t received = 0;
+  size_t i;
+  int fds[2];
+
+  for (i = 0; i < cap; i++)
+  {
+    in[i] = (uint8_t)(i * 31);
+  }
+
+  assert_int_equal(pipe2(fds, O_NONBLOCK), 0);
+  assert_true(fcntl(fds[1], F_SETPIPE_SZ, 4096) >= 4096);
+  const size_t pipe_size = (size_t)fcntl(fds[1], F_GETPIPE_SZ);
+
+  assert_true(bipbuf_offer(buffer, in, cap));
+
+  // The kernel takes what fits, and only that is released.
+  const ssize_t first = bipbuf_write(buffer, fds[1]);
+  assert_int_equal(first, pipe_size);
+  assert_int_equal(buffer->a_start, pipe_size);
+  assert_int_equal(bipbuf_write(buffer, fds[1]), -1);
+  assert_int_equal(errno, EAGAIN);
+
+  while (received < cap)
+  {
+    const ssize_t n = read(fds[0], (out + received), (cap - received));
+    assert_true(n > 0);
+    received += (size_t)n;
+    bipbuf_write(buffer, fds[1]);
+  }
+
+  assert_true(bipbuf_empty(buffer));
+  assert_memory_equal(in, out, cap);
+
+  close(fds[0]);
+  close(fds[1]);
+  free(in);
+  free(out);
+  bipbuf_destroy(buffer);
+}
+
+static void bipbuf_read_test(void unused **state)
+{
+  bipbuf_t *buffer = bipbuf_new(8);
+  char out[16] = { 0 };
+  uint8_t *data = NULL;
+  int in[2];
+  int fds[2];
+
+  assert_int_equal(pipe2(in, O_NONBLOCK), 0);
+  assert_int_equal(pipe(fds), 0);
+
+  assert_int_equal(bipbuf_read(buffer, in[0]), -1);
+  assert_int_equal(errno, EAGAIN);
+
+  assert_int_equal(write(in[1], "abc", 3), 3);
+  assert_int_equal(bipbuf_read(buffer, in[0]), 3);
+  data = bipbuf_poll(buffer, 2);
+  assert_memory_equal(data, "ab", 2);
+  free(data);
+
+  // The read fills the end of the buffer and spills into region B.
+  assert_int_equal(write(in[1], "defghijk", 8), 8);
+  assert_int_equal(bipbuf_read(buffer, in[0]), 7);
+  assert_true(buffer->b_inuse);
+  assert_int_equal(buffer->b_end, 2);
+
+  // A full buffer reads nothing and leaves the rest in the fd.
+  assert_int_equal(bipbuf_read(buffer, in[0]), -1);
+  assert_int_equal(errno, ENOBUFS);
+
+  assert_int_equal(bipbuf_write(buffer, fds[1]), 8);
+  assert_int_equal(read(fds[0], out, sizeof(out)), 8);
+  assert_memory_equal(out, "cdefghij", 8);
+
+  assert_int_equal(bipbuf_read(buffer, in[0]), 1);
+  close(in[1]);
+  assert_int_equal(bipbuf_read(buffer, in[0]), 0);
+
+  data = bipbuf_poll(buffer, 1);
+  assert_memory_equal(data, "k", 1);
+  free(data);
+
+  close(in[0]);
+  close(fds[0]);
+  close(fds[1]);
+  bipbuf_destroy(buffer);
+}
+
+int main(void)
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(bipbuf_offer_poll_test),
+    cmocka_unit_test(bipbuf_write_test),
+    cmocka_unit_test(bipbuf_write_partial_test),
+    cmocka_unit_test(bipbuf_read_test),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
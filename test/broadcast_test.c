@@ -0,0 +1,167 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+
+#include <cmocka/cmocka.h>
+
+#include "broadcast.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef unused
+#define unused __attribute__ ((unused))
+#endif/*unused*/
+
+#define CONSUMERS 3
+#define ITEMS     1000000
+
+static broadcast_t *ring = NULL;
+
+struct reader
+{
+  int id;
+  long sum;
+};
+
+static void broadcast_new_test(void unused **state)
+{
+  broadcast_t *target = broadcast_new(4 * sizeof(int), sizeof(int));
+
+  assert_non_null(target);
+  assert_int_equal(target->slots, 4);
+  assert_int_equal(((uintptr_t)&target->cursor[1] - (uintptr_t)&target->cursor[0]) % 64, 0);
+  assert_int_equal(((uintptr_t)&target->cursor[0] - (uintptr_t)&target->tail) % 64, 0);
+
+  broadcast_destroy(target);
+  assert_null(target);
+}
+
+static void broadcast_gate_test(void unused **state)
+{
+  broadcast_t *target = broadcast_new(4 * sizeof(int), sizeof(int));
+  const void *items[8] = { NULL };
+  int i;
+
+  // Without consumers nothing holds the producer back.
+  for (i = 0; i < 8; i++)
+  {
+    assert_true(broadcast_publish(target, &i));
+  }
+
+  const int fast = broadcast_subscribe(target);
+  const int slow = broadcast_subscribe(target);
+  assert_int_not_equal(fast, slow);
+
+  for (i = 0; i < 4; i++)
+  {
+    assert_true(broadcast_publish(target, &i));
+  }
+  assert_false(broadcast_publish(target, &i));
+
+  // Both see every item, in place.
+  assert_int_equal(broadcast_peek(target, fast, items, 8), 4);
+  for (i = 0; i < 4; i++)
+  {
+    assert_int_equal(*(const int *)items[i], i);
+  }
+  assert_int_equal(broadcast_peek(target, slow, items, 2), 2);
+  assert_ptr_equal(items[0], target->data);
+
+  // The slowest consumer gates the producer.
+  broadcast_release(target, fast, 4);
+  assert_false(broadcast_publish(target, &i));
+  assert_int_equal(broadcast_backlog(target, fast), 0);
+  assert_int_equal(broadcast_backlog(target, slow), 4);
+
+  broadcast_release(target, slow, 1);
+  assert_true(broadcast_publish(target, &i));
+  assert_false(broadcast_publish(target, &i));
+
+  // A consumer that leaves no longer gates it.
+  broadcast_unsubscribe(target, slow);
+  for (i = 0; i < 3; i++)
+  {
+    assert_true(broadcast_publish(target, &i));
+  }
+  assert_false(broadcast_publish(target, &i));
+
+  broadcast_destroy(target);
+}
+
+static void *consumer(void *arg)
+{
+  struct reader *reader = (struct reader *)arg;
+  const int id = reader->id;
+  const void *items[16] = { NULL };
+  long sum = 0;
+  int seen = 0;
+
+  while (seen < ITEMS)
+  {
+    const size_t n = broadcast_peek(ring, id, items, 16);
+    size_t i;
+
+    for (i = 0; i < n; i++, seen++)
+    {
+      assert_int_equal(*(const int *)items[i], seen);
+      sum += *(const int *)items[i];
+    }
+
+    if (n == 0)
+    {
+      sched_yield();
+    }
+
+    broadcast_release(ring, id, n);
+  }
+
+  reader->sum = sum;
+  return NULL;
+}
+
+static void broadcast_thread_safety_test(void unused **state)
+{
+  pthread_t threads[CONSUMERS];
+  struct reader readers[CONSUMERS];
+  int i;
+
+  ring = broadcast_new(64 * sizeof(int), sizeof(int));
+
+  for (i = 0; i < CONSUMERS; i++)
+  {
+    readers[i].id = broadcast_subscribe(ring);
+    readers[i].sum = 0;
+    assert_true(pthread_create(&threads[i], NULL, &consumer, &readers[i]) == 0);
+  }
+
+  for (i = 0; i < ITEMS; i++)
+  {
+    while (false == broadcast_publish(ring, &i))
+    {
+      sched_yield();
+    }
+  }
+
+  for (i = 0; i < CONSUMERS; i++)
+  {
+    assert_true(pthread_join(threads[i], NULL) == 0);
+    assert_int_equal(readers[i].sum, ((long)ITEMS * (ITEMS - 1)) / 2);
+  }
+
+  broadcast_destroy(ring);
+}
+
+int main(void)
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(broadcast_new_test),
+    cmocka_unit_test(broadcast_gate_test),
+    cmocka_unit_test(broadcast_thread_safety_test),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
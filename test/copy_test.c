@@ -0,0 +1,140 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+
+#include <cmocka/cmocka.h>
+
+#include "copy.h"
+#include "lossy.h"
+#include "queue.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef unused
+#define unused __attribute__ ((unused))
+#endif/*unused*/
+
+static void copy_select_test(void unused **state)
+{
+  assert_string_equal(copy_name(copy_select(8, false)), "fixed8");
+  assert_string_equal(copy_name(copy_select(16, true)), "fixed16");
+  assert_string_equal(copy_name(copy_select(32, false)), "fixed32");
+  assert_string_equal(copy_name(copy_select(64, true)), "fixed64");
+  assert_string_equal(copy_name(copy_select(4, false)), "memcpy");
+  assert_string_not_equal(copy_name(copy_select(4096, false)), "unknown");
+}
+
+/**
+ * @brief Copy with the kernel selected for a length, between unaligned
+ *        buffers, and make sure every byte arrives and none past the end
+ *        of the destination is touched.
+ */
+static void copy_check(const size_t len, const bool stream, const size_t offset)
+{
+  const size_t guard = 64;
+  uint8_t *src = malloc(len + offset);
+  uint8_t *dst = malloc(len + offset + guard);
+  size_t i;
+
+  for (i = 0; i < (len + offset); i++)
+  {
+    src[i] = (uint8_t)((i * 131) + 7);
+  }
+
+  memset(dst, 0xa5, len + offset + guard);
+
+  copy_select(len, stream)(dst + offset, src + offset, len);
+
+  assert_memory_equal(dst + offset, src + offset, len);
+
+  for (i = 0; i < guard; i++)
+  {
+    assert_int_equal(dst[offset + len + i], 0xa5);
+  }
+
+  for (i = 0; i < offset; i++)
+  {
+    assert_int_equal(dst[i], 0xa5);
+  }
+
+  free(src);
+  free(dst);
+}
+
+static void copy_kernel_test(void unused **state)
+{
+  const size_t large[] = { 4096, 16 * 1024, (16 * 1024) + 13, 100 * 1000 };
+  size_t len, offset, i;
+
+  for (len = 1; len <= 300; len++)
+  {
+    for (offset = 0; offset < 4; offset++)
+    {
+      copy_check(len, false, offset);
+      copy_check(len, true, offset);
+    }
+  }
+
+  for (i = 0; i < (sizeof(large) / sizeof(large[0])); i++)
+  {
+    for (offset = 0; offset < 20; offset += 3)
+    {
+      copy_check(large[i], false, offset);
+      copy_check(large[i], true, offset);
+    }
+  }
+}
+
+static void copy_queue_test(void unused **state)
+{
+  const size_t len = 20 * 1024;
+  queue_t *queue = NULL;
+  uint8_t *item = malloc(len);
+  size_t i;
+
+  for (i = 0; i < len; i++)
+  {
+    item[i] = (uint8_t)i;
+  }
+
+  queue = queue_new(4 * len, len);
+  assert_non_null(queue->copy_in);
+  assert_non_null(queue->copy_out);
+
+  assert_true(queue_enqueue(queue, item));
+
+  uint8_t *data = queue_dequeue(queue);
+  assert_non_null(data);
+  assert_memory_equal(data, item, len);
+  free(data);
+
+  // The lossy Queue streams large items in the same way.
+  lossy_queue_t *lossy = lossy_queue_new(2 * len, len);
+  assert_ptr_equal(lossy->copy_in, copy_select(len, true));
+  assert_ptr_equal(lossy->copy_out, copy_select(len, false));
+
+  lossy_queue_enqueue(lossy, item);
+
+  data = lossy_queue_dequeue(lossy, NULL);
+  assert_non_null(data);
+  assert_memory_equal(data, item, len);
+  free(data);
+
+  free(item);
+  queue_destroy(queue);
+  lossy_queue_destroy(lossy);
+}
+
+int main(void)
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(copy_select_test),
+    cmocka_unit_test(copy_kernel_test),
+    cmocka_unit_test(copy_queue_test),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
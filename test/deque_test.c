@@ -0,0 +1,183 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+
+#include <cmocka/cmocka.h>
+
+#include "deque.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef unused
+#define unused __attribute__ ((unused))
+#endif/*unused*/
+
+#define THIEVES 3
+#define ITEMS   200000
+
+static ws_deque_t *deque = NULL;
+static atomic_bool finished;
+static unsigned char *taken;
+
+static void ws_deque_new_test(void unused **state)
+{
+  ws_deque_t *target = ws_deque_new(5, sizeof(uintptr_t));
+  uintptr_t item;
+
+  assert_non_null(target);
+  assert_int_equal(atomic_load(&target->array)->size, 8);
+  assert_int_equal(target->len, sizeof(uintptr_t));
+  assert_int_equal(((uintptr_t)&target->bottom - (uintptr_t)&target->top) % 64, 0);
+  assert_int_equal(ws_deque_size(target), 0);
+  assert_false(ws_deque_pop(target, &item));
+  assert_false(ws_deque_steal(target, &item));
+
+  ws_deque_destroy(target);
+  assert_null(target);
+}
+
+static void ws_deque_order_test(void unused **state)
+{
+  ws_deque_t *target = ws_deque_new(2, sizeof(uintptr_t));
+  uintptr_t item;
+  uintptr_t i;
+
+  // The owner pops the newest item and a thief steals the oldest; the
+  // array grows past its initial two slots without losing either end.
+  for (i = 1; i <= 10; i++)
+  {
+    ws_deque_push(target, &i);
+  }
+
+  assert_int_equal(ws_deque_size(target), 10);
+  assert_true(atomic_load(&target->array)->size >= 16);
+  assert_true(ws_deque_pop(target, &item));
+  assert_int_equal(item, 10);
+  assert_true(ws_deque_steal(target, &item));
+  assert_int_equal(item, 1);
+  assert_true(ws_deque_steal(target, &item));
+  assert_int_equal(item, 2);
+  assert_true(ws_deque_pop(target, &item));
+  assert_int_equal(item, 9);
+
+  for (i = 8; i >= 3; i--)
+  {
+    assert_true(ws_deque_pop(target, &item));
+    assert_int_equal(item, i);
+  }
+
+  assert_false(ws_deque_pop(target, &item));
+  assert_false(ws_deque_steal(target, &item));
+  assert_int_equal(ws_deque_size(target), 0);
+
+  // The indices keep counting up after the deque empties.
+  ws_deque_push(target, &i);
+  assert_true(ws_deque_steal(target, &item));
+  assert_int_equal(item, i);
+
+  ws_deque_destroy(target);
+}
+
+static void *thief(void unused *arg)
+{
+  size_t count = 0;
+
+  while (true)
+  {
+    uintptr_t item;
+
+    if (true == ws_deque_steal(deque, &item))
+    {
+      taken[item - 1]++;
+      count++;
+      continue;
+    }
+
+    if (true == atomic_load(&finished) && ws_deque_size(deque) == 0)
+    {
+      break;
+    }
+
+    sched_yield();
+  }
+
+  return (void *)count;
+}
+
+static void ws_deque_steal_test(void unused **state)
+{
+  pthread_t threads[THIEVES];
+  size_t popped = 0;
+  size_t stolen = 0;
+  uintptr_t i;
+
+  deque = ws_deque_new(16, sizeof(uintptr_t));
+  taken = calloc(ITEMS, 1);
+  atomic_init(&finished, false);
+
+  for (i = 0; i < THIEVES; i++)
+  {
+    assert_int_equal(pthread_create(&threads[i], NULL, &thief, NULL), 0);
+  }
+
+  // The owner pushes in bursts and pops some of every burst back, so that
+  // it races the thieves for the last item again and again.
+  for (i = 1; i <= ITEMS; i++)
+  {
+    ws_deque_push(deque, &i);
+
+    if (i % 4 == 0)
+    {
+      uintptr_t item;
+
+      if (true == ws_deque_pop(deque, &item))
+      {
+        taken[item - 1]++;
+        popped++;
+      }
+    }
+  }
+
+  uintptr_t item;
+  while (true == ws_deque_pop(deque, &item))
+  {
+    taken[item - 1]++;
+    popped++;
+  }
+
+  atomic_store(&finished, true);
+
+  for (i = 0; i < THIEVES; i++)
+  {
+    void *count;
+    pthread_join(threads[i], &count);
+    stolen += (size_t)count;
+  }
+
+  assert_int_equal(popped + stolen, ITEMS);
+
+  for (i = 0; i < ITEMS; i++)
+  {
+    assert_int_equal(taken[i], 1);
+  }
+
+  free(taken);
+  ws_deque_destroy(deque);
+}
+
+int main(void)
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(ws_deque_new_test),
+    cmocka_unit_test(ws_deque_order_test),
+    cmocka_unit_test(ws_deque_steal_test),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,121 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+
+#include <cmocka/cmocka.h>
+
+#include "histogram.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef unused
+#define unused __attribute__ ((unused))
+#endif/*unused*/
+
+static void histogram_new_test(void unused **state)
+{
+  struct histogram *histogram = NULL;
+
+  histogram = histogram_new();
+  assert_non_null(histogram);
+  assert_int_equal(histogram_percentile(histogram, 0.5), 0);
+
+  histogram_destroy(histogram);
+  assert_null(histogram);
+}
+
+static void histogram_bucket_test(void unused **state)
+{
+  // Small values are exact and buckets are monotonic and in range.
+  assert_int_equal(histogram_bucket(0), 0);
+  assert_int_equal(histogram_bucket(31), 31);
+  assert_int_equal(histogram_bucket(32), 32);
+  assert_int_equal(histogram_bucket(33), 32);
+  assert_int_equal(histogram_bucket(34), 33);
+  assert_true(histogram_bucket(UINT64_MAX) < HISTOGRAM_BUCKETS);
+  assert_true(histogram_bucket(1000) < histogram_bucket(1100));
+}
+
+static void histogram_percentile_test(void unused **state)
+{
+  struct histogram *histogram = NULL;
+  uint64_t i;
+
+  histogram = histogram_new();
+  assert_non_null(histogram);
+
+  for (i = 1; i <= 100000; i++)
+  {
+    histogram_record(histogram, i);
+  }
+
+  // Every reported value is within one sub-bucket above the true value.
+  const uint64_t p50 = histogram_percentile(histogram, 0.50);
+  const uint64_t p99 = histogram_percentile(histogram, 0.99);
+  const uint64_t p999 = histogram_percentile(histogram, 0.999);
+
+  assert_in_range(p50, 50000, 50000 + (50000 / HISTOGRAM_SUB));
+  assert_in_range(p99, 99000, 99000 + (99000 / HISTOGRAM_SUB));
+  assert_in_range(p999, 99900, 99900 + (99900 / HISTOGRAM_SUB));
+
+  latency_snapshot_t snapshot;
+  assert_true(histogram_latency(histogram, &snapshot));
+  assert_int_equal(snapshot.count, 100000);
+  assert_int_equal(snapshot.p50, p50);
+  assert_true(snapshot.max >= 100000);
+
+  assert_false(histogram_latency(NULL, &snapshot));
+  assert_int_equal(snapshot.count, 0);
+
+  histogram_destroy(histogram);
+  assert_null(histogram);
+}
+
+static struct histogram *target = NULL;
+
+static void *proca(void *arg)
+{
+  int i;
+
+  for (i = 0; i < 1000000; i++)
+  {
+    histogram_record(target, 100);
+  }
+
+  return NULL;
+}
+
+static void histogram_thread_safety_test(void unused **state)
+{
+  latency_snapshot_t snapshot;
+  pthread_t t1;
+  pthread_t t2;
+
+  target = histogram_new();
+
+  assert_true(pthread_create(&t1, NULL, &proca, NULL) == 0);
+  assert_true(pthread_create(&t2, NULL, &proca, NULL) == 0);
+
+  assert_true(pthread_join(t1, NULL) == 0);
+  assert_true(pthread_join(t2, NULL) == 0);
+
+  assert_true(histogram_latency(target, &snapshot));
+  assert_int_equal(snapshot.count, 2000000);
+
+  histogram_destroy(target);
+}
+
+int main(void)
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(histogram_new_test),
+    cmocka_unit_test(histogram_bucket_test),
+    cmocka_unit_test(histogram_percentile_test),
+    cmocka_unit_test(histogram_thread_safety_test),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
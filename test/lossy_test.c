@@ -0,0 +1,382 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+
+#include <cmocka/cmocka.h>
+
+#include "lossy.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef unused
+#define unused __attribute__ ((unused))
+#endif/*unused*/
+
+static void lossy_queue_new_test(void unused **state)
+{
+  const size_t cap = 4 * sizeof(int);
+  lossy_queue_t *queue = NULL;
+
+  queue = lossy_queue_new(cap, sizeof(int));
+  assert_non_null(queue);
+  assert_int_equal(queue->slots, 4);
+
+  lossy_queue_destroy(queue);
+  assert_null(queue);
+}
+
+static void lossy_queue_dequeue_test(void unused **state)
+{
+  const size_t cap = 4 * sizeof(int);
+  lossy_queue_t *queue = NULL;
+  uint64_t seq = 0;
+
+  queue = lossy_queue_new(cap, sizeof(int));
+  assert_non_null(queue);
+
+  assert_null(lossy_queue_dequeue(queue, &seq));
+  assert_true(lossy_queue_empty(queue));
+
+  assert_int_equal(lossy_queue_enqueue(queue, &(int){1}), 0);
+  assert_int_equal(lossy_queue_enqueue(queue, &(int){2}), 1);
+  assert_int_equal(lossy_queue_size(queue), 2 * sizeof(int));
+
+  int *item = lossy_queue_dequeue(queue, &seq);
+  assert_non_null(item);
+  assert_int_equal(*item, 1);
+  assert_int_equal(seq, 0);
+  free(item);
+
+  item = lossy_queue_dequeue(queue, &seq);
+  assert_non_null(item);
+  assert_int_equal(*item, 2);
+  assert_int_equal(seq, 1);
+  free(item);
+
+  assert_null(lossy_queue_dequeue(queue, NULL));
+  assert_int_equal(lossy_queue_dropped(queue), 0);
+
+  lossy_queue_destroy(queue);
+  assert_null(queue);
+}
+
+static void lossy_queue_overwrite_test(void unused **state)
+{
+  const size_t cap = 4 * sizeof(int);
+  lossy_queue_t *queue = NULL;
+  uint64_t seq = 0;
+  int i;
+
+  queue = lossy_queue_new(cap, sizeof(int));
+  assert_non_null(queue);
+
+  // Ten items into four slots: the producer never fails and the first six
+  // items are overwritten.
+  for (i = 0; i < 10; i++)
+  {
+    lossy_queue_enqueue(queue, &i);
+  }
+  assert_int_equal(lossy_queue_size(queue), cap);
+
+  for (i = 6; i < 10; i++)
+  {
+    int *item = lossy_queue_dequeue(queue, &seq);
+    assert_non_null(item);
+    assert_int_equal(*item, i);
+    assert_int_equal(seq, i);
+    free(item);
+  }
+
+  assert_null(lossy_queue_dequeue(queue, &seq));
+  assert_int_equal(lossy_queue_dropped(queue), 6);
+
+  lossy_queue_destroy(queue);
+  assert_null(queue);
+}
+
+static void lossy_queue_late_producer_test(void unused **state)
+{
+  lossy_queue_t *queue = NULL;
+  uint64_t seq = 0;
+  int *item = NULL;
+
+  queue = lossy_queue_new(2 * sizeof(int), sizeof(int));
+
+  // Producers of items 0 and 1 took their sequence numbers and stalled;
+  // items 2 and 3 lap them and are published.
+  atomic_store(&queue->w, 2UL);
+  assert_int_equal(lossy_queue_enqueue(queue, &(int){2}), 2);
+  assert_int_equal(lossy_queue_enqueue(queue, &(int){3}), 3);
+
+  // The producer of item 0 resumes. Its slot already holds item 2, so it
+  // must drop its item rather than write over item 2.
+  atomic_store(&queue->w, 0UL);
+  assert_int_equal(lossy_queue_enqueue(queue, &(int){0}), 0);
+  atomic_store(&queue->w, 4UL);
+
+  item = lossy_queue_dequeue(queue, &seq);
+  assert_non_null(item);
+  assert_int_equal(*item, 2);
+  assert_int_equal(seq, 2);
+  free(item);
+
+  item = lossy_queue_dequeue(queue, &seq);
+  assert_non_null(item);
+  assert_int_equal(*item, 3);
+  assert_int_equal(seq, 3);
+  free(item);
+
+  assert_null(lossy_queue_dequeue(queue, &seq));
+  assert_int_equal(lossy_queue_dropped(queue), 2);
+
+  // Eight more items took their sequence numbers and none claimed a slot:
+  // the slots still hold an older lap, so all eight are gaps.
+  atomic_store(&queue->w, 12UL);
+  assert_null(lossy_queue_dequeue(queue, &seq));
+  assert_int_equal(lossy_queue_dropped(queue), 10);
+
+  lossy_queue_destroy(queue);
+}
+
+#define PARKED_ITEMS 200UL
+
+static atomic_bool parked_done;
+
+static void *parked_producer(void *arg)
+{
+  lossy_queue_t *queue = (lossy_queue_t *)arg;
+  uint64_t i;
+
+  for (i = 1; i <= PARKED_ITEMS; i++)
+  {
+    lossy_queue_enqueue(queue, &(int){(int)i});
+  }
+
+  atomic_store(&parked_done, true);
+  return NULL;
+}
+
+static void lossy_queue_parked_copier_test(void unused **state)
+{
+  const struct timespec pause = { 0, 1000000L };
+  lossy_queue_t *queue = NULL;
+  pthread_t thread;
+  uint64_t seq = 0;
+  int *item = NULL;
+  int waited;
+
+  queue = lossy_queue_new(2 * sizeof(int), sizeof(int));
+  atomic_init(&parked_done, false);
+
+  // The producer of item 0 claimed slot 0 and was parked in the middle of
+  // its copy.
+  atomic_store(&queue->w, 1UL);
+  atomic_store(&queue->seq[0], 1UL);
+
+  // Every other producer that lands on slot 0 gives its item up instead of
+  // waiting for the parked copy, so the producers finish without it.
+  assert_true(pthread_create(&thread, NULL, &parked_producer, queue) == 0);
+
+  for (waited = 0; waited < 5000 && false == atomic_load(&parked_done); waited++)
+  {
+    nanosleep(&pause, NULL);
+  }
+
+  assert_true(atomic_load(&parked_done));
+  assert_true(pthread_join(thread, NULL) == 0);
+
+  // Only the newest item of slot 1 survives; everything else was lapped
+  // or given up.
+  item = lossy_queue_dequeue(queue, &seq);
+  assert_non_null(item);
+  assert_int_equal(*item, 199);
+  assert_int_equal(seq, 199);
+  free(item);
+
+  assert_null(lossy_queue_dequeue(queue, &seq));
+  assert_int_equal(lossy_queue_dropped(queue), PARKED_ITEMS);
+
+  // Once the parked copy completes the slot is claimed normally again.
+  atomic_store(&queue->seq[0], 2UL);
+  assert_int_equal(lossy_queue_enqueue(queue, &(int){201}), 201);
+  assert_int_equal(lossy_queue_enqueue(queue, &(int){202}), 202);
+
+  item = lossy_queue_dequeue(queue, &seq);
+  assert_non_null(item);
+  assert_int_equal(*item, 201);
+  free(item);
+
+  item = lossy_queue_dequeue(queue, &seq);
+  assert_non_null(item);
+  assert_int_equal(*item, 202);
+  free(item);
+
+  lossy_queue_destroy(queue);
+}
+
+#define ITEMS 2000000UL
+
+static lossy_queue_t *target = NULL;
+
+static void *proca(void *arg)
+{
+  uint64_t i;
+
+  for (i = 0; i < ITEMS; i++)
+  {
+    lossy_queue_enqueue(target, &i);
+  }
+
+  return NULL;
+}
+
+static void lossy_queue_thread_safety_test(void unused **state)
+{
+  const size_t cap = 1024 * sizeof(uint64_t);
+  uint64_t received = 0;
+  uint64_t seq = 0;
+  uint64_t last = 0;
+  uint64_t *item = NULL;
+
+  pthread_t t1;
+
+  target = lossy_queue_new(cap, sizeof(uint64_t));
+
+  assert_true(pthread_create(&t1, NULL, &proca, NULL) == 0);
+
+  while ((received + lossy_queue_dropped(target)) < ITEMS)
+  {
+    if (NULL == (item = lossy_queue_dequeue(target, &seq)))
+    {
+      continue;
+    }
+
+    // Every item must be intact and items must arrive in order.
+    assert_int_equal(*item, seq);
+    assert_true(received == 0 || seq > last);
+    last = seq;
+    received++;
+    free(item);
+  }
+
+  assert_true(pthread_join(t1, NULL) == 0);
+
+  assert_int_equal((received + lossy_queue_dropped(target)), ITEMS);
+
+  lossy_queue_destroy(target);
+}
+
+#define LAPPERS      8
+#define LAPPER_ITEMS 50000UL
+#define WORDS        512
+
+struct record
+{
+  uint64_t word[WORDS];
+};
+
+static void *lapper(void *arg)
+{
+  const uint64_t id = (uint64_t)(uintptr_t)arg;
+  struct record *record = calloc(1, sizeof(*record));
+  uint64_t i;
+  size_t k;
+
+  for (i = 0; i < LAPPER_ITEMS; i++)
+  {
+    for (k = 0; k < WORDS; k++)
+    {
+      record->word[k] = (id << 32) | i;
+    }
+
+    lossy_queue_enqueue(target, record);
+  }
+
+  free(record);
+
+  return NULL;
+}
+
+static void check_record(const struct record *record, const uint64_t seq, uint64_t *last, uint64_t *received)
+{
+  size_t k;
+
+  // A torn item would mix the words of two producers. Items are large so
+  // that producers are often preempted in the middle of a copy.
+  for (k = 1; k < WORDS; k++)
+  {
+    assert_int_equal(record->word[0], record->word[k]);
+  }
+
+  assert_true(*received == 0 || seq > *last);
+
+  *last = seq;
+  (*received)++;
+}
+
+static void lossy_queue_lapped_test(void unused **state)
+{
+  pthread_t threads[LAPPERS];
+  struct record *item = NULL;
+  uint64_t received = 0;
+  uint64_t last = 0;
+  uint64_t seq = 0;
+  uintptr_t i;
+
+  // Two slots and eight producers, so that producers lap each other all
+  // the time, including while one of them is still copying.
+  target = lossy_queue_new(2 * sizeof(struct record), sizeof(struct record));
+
+  for (i = 0; i < LAPPERS; i++)
+  {
+    assert_true(pthread_create(&threads[i], NULL, &lapper, (void *)i) == 0);
+  }
+
+  while (atomic_load(&target->w) < (LAPPERS * LAPPER_ITEMS))
+  {
+    if (NULL != (item = lossy_queue_dequeue(target, &seq)))
+    {
+      check_record(item, seq, &last, &received);
+      free(item);
+    }
+  }
+
+  for (i = 0; i < LAPPERS; i++)
+  {
+    assert_true(pthread_join(threads[i], NULL) == 0);
+  }
+
+  while (NULL != (item = lossy_queue_dequeue(target, &seq)))
+  {
+    check_record(item, seq, &last, &received);
+    free(item);
+  }
+
+  // Every sequence number was either received or counted as dropped,
+  // and the consumer did not stall short of the last one.
+  assert_int_equal((received + lossy_queue_dropped(target)), LAPPERS * LAPPER_ITEMS);
+  assert_true(received > 0);
+
+  lossy_queue_destroy(target);
+}
+
+int main(void)
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(lossy_queue_new_test),
+    cmocka_unit_test(lossy_queue_dequeue_test),
+    cmocka_unit_test(lossy_queue_overwrite_test),
+    cmocka_unit_test(lossy_queue_late_producer_test),
+    cmocka_unit_test(lossy_queue_parked_copier_test),
+    cmocka_unit_test(lossy_queue_thread_safety_test),
+    cmocka_unit_test(lossy_queue_lapped_test),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,109 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+
+#include <cmocka/cmocka.h>
+
+// Exercise the recording path regardless of how the library was built.
+#define TURNPIKE_METRICS
+
+#include "metrics.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef unused
+#define unused __attribute__ ((unused))
+#endif/*unused*/
+
+static void metrics_new_test(void unused **state)
+{
+  struct metrics *metrics = NULL;
+
+  metrics = metrics_new();
+  assert_non_null(metrics);
+  assert_int_equal(((uintptr_t)metrics) % 64, 0);
+
+  metrics_destroy(metrics);
+  assert_null(metrics);
+}
+
+static void metrics_snapshot_test(void unused **state)
+{
+  struct metrics *metrics = NULL;
+  metrics_snapshot_t snapshot;
+
+  assert_false(metrics_snapshot(NULL, &snapshot));
+  assert_int_equal(snapshot.enqueued, 0);
+
+  metrics = metrics_new();
+  assert_non_null(metrics);
+
+  metrics_record(metrics, METRICS_ENQUEUE, 4);
+  metrics_record(metrics, METRICS_ENQUEUE, 8);
+  metrics_record(metrics, METRICS_DEQUEUE, 4);
+  metrics_record(metrics, METRICS_FULL, 8);
+  metrics_record(metrics, METRICS_EMPTY, 0);
+
+  assert_true(metrics_snapshot(metrics, &snapshot));
+  assert_int_equal(snapshot.enqueued, 2);
+  assert_int_equal(snapshot.dequeued, 1);
+  assert_int_equal(snapshot.full, 1);
+  assert_int_equal(snapshot.empty, 1);
+  assert_int_equal(snapshot.high_water, 8);
+
+  metrics_destroy(metrics);
+  assert_null(metrics);
+}
+
+static struct metrics *target = NULL;
+
+static void *proca(void *arg)
+{
+  int i;
+
+  for (i = 0; i < 1000000; i++)
+  {
+    metrics_record(target, METRICS_ENQUEUE, (size_t)(uintptr_t)arg);
+  }
+
+  return NULL;
+}
+
+static void metrics_thread_safety_test(void unused **state)
+{
+  metrics_snapshot_t snapshot;
+  pthread_t t[4];
+  size_t i;
+
+  target = metrics_new();
+
+  for (i = 0; i < 4; i++)
+  {
+    assert_true(pthread_create(&t[i], NULL, &proca, (void *)(uintptr_t)(i + 1)) == 0);
+  }
+
+  for (i = 0; i < 4; i++)
+  {
+    assert_true(pthread_join(t[i], NULL) == 0);
+  }
+
+  assert_true(metrics_snapshot(target, &snapshot));
+  assert_int_equal(snapshot.enqueued, 4000000);
+  assert_int_equal(snapshot.high_water, 4);
+
+  metrics_destroy(target);
+}
+
+int main(void)
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(metrics_new_test),
+    cmocka_unit_test(metrics_snapshot_test),
+    cmocka_unit_test(metrics_thread_safety_test),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,193 @@
+#define _GNU_SOURCE
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+
+#include <cmocka/cmocka.h>
+
+#include "percpu.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifndef unused
+#define unused __attribute__ ((unused))
+#endif/*unused*/
+
+#define PRODUCERS 4
+#define CONSUMERS 2
+#define ITEMS     200000
+
+static percpu_queue_t *queue = NULL;
+static atomic_long consumed;
+static atomic_long total;
+
+static void percpu_queue_new_test(void unused **state)
+{
+  percpu_queue_t *target = percpu_queue_new(100, 8);
+
+  assert_non_null(target);
+  assert_int_equal(target->slots, 8);
+  assert_int_equal(target->mask, 7);
+  assert_int_equal(target->cpus, (size_t)sysconf(_SC_NPROCESSORS_CONF));
+  assert_int_equal(((uintptr_t)&target->ring[1] - (uintptr_t)&target->ring[0]) % 64, 0);
+  assert_int_equal(((uintptr_t)&target->ring[0].head - (uintptr_t)&target->ring[0].tail) % 64, 0);
+  assert_true(percpu_queue_empty(target));
+
+  percpu_queue_destroy(target);
+  assert_null(target);
+}
+
+static void run_dequeue(const bool rseq)
+{
+  cpu_set_t cpus;
+  long items[8];
+  long i;
+
+  // Stay on one CPU so that every item lands on the same ring.
+  CPU_ZERO(&cpus);
+  CPU_SET(sched_getcpu(), &cpus);
+  assert_int_equal(pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus), 0);
+
+  queue = percpu_queue_new(4 * sizeof(long), sizeof(long));
+  queue->rseq = queue->rseq && rseq;
+
+  assert_null(percpu_queue_dequeue(queue));
+
+  for (i = 0; i < 4; i++)
+  {
+    assert_true(percpu_queue_enqueue(queue, &i));
+  }
+
+  assert_false(percpu_queue_enqueue(queue, &i));
+  assert_int_equal(percpu_queue_size(queue), 4 * sizeof(long));
+
+  long *item = percpu_queue_dequeue(queue);
+  assert_non_null(item);
+  assert_int_equal(*item, 0);
+  free(item);
+
+  // The slot freed by the dequeue is reused across the wrap.
+  assert_true(percpu_queue_enqueue(queue, &(long){ 4 }));
+  assert_int_equal(percpu_queue_dequeue_batch(queue, items, 8), 4);
+
+  for (i = 0; i < 4; i++)
+  {
+    assert_int_equal(items[i], i + 1);
+  }
+
+  assert_true(percpu_queue_empty(queue));
+  percpu_queue_destroy(queue);
+
+  CPU_ZERO(&cpus);
+  for (i = 0; i < sysconf(_SC_NPROCESSORS_ONLN); i++)
+  {
+    CPU_SET(i, &cpus);
+  }
+  pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+}
+
+static void percpu_queue_dequeue_test(void unused **state)
+{
+  run_dequeue(true);
+  run_dequeue(false);
+}
+
+static void *producer(void unused *arg)
+{
+  long i;
+
+  for (i = 1; i <= ITEMS; i++)
+  {
+    while (false == percpu_queue_enqueue(queue, &i))
+    {
+      sched_yield();
+    }
+  }
+
+  return NULL;
+}
+
+static void *consumer(void unused *arg)
+{
+  long items[16];
+
+  while (atomic_load(&consumed) < ((long)PRODUCERS * ITEMS))
+  {
+    const size_t n = percpu_queue_dequeue_batch(queue, items, 16);
+    size_t i;
+
+    if (n == 0)
+    {
+      sched_yield();
+      continue;
+    }
+
+    for (i = 0; i < n; i++)
+    {
+      atomic_fetch_add(&total, items[i]);
+    }
+
+    atomic_fetch_add(&consumed, (long)n);
+  }
+
+  return NULL;
+}
+
+static void run_threads(const bool rseq)
+{
+  pthread_t threads[PRODUCERS + CONSUMERS];
+  int i;
+
+  // A small ring keeps the producers running into a full ring and into
+  // preemption in the middle of an enqueue.
+  queue = percpu_queue_new(64 * sizeof(long), sizeof(long));
+  queue->rseq = queue->rseq && rseq;
+  atomic_init(&consumed, 0);
+  atomic_init(&total, 0);
+
+  for (i = 0; i < PRODUCERS; i++)
+  {
+    assert_int_equal(pthread_create(&threads[i], NULL, &producer, NULL), 0);
+  }
+
+  for (i = 0; i < CONSUMERS; i++)
+  {
+    assert_int_equal(pthread_create(&threads[PRODUCERS + i], NULL, &consumer, NULL), 0);
+  }
+
+  for (i = 0; i < (PRODUCERS + CONSUMERS); i++)
+  {
+    pthread_join(threads[i], NULL);
+  }
+
+  assert_int_equal(atomic_load(&consumed), (long)PRODUCERS * ITEMS);
+  assert_int_equal(atomic_load(&total), (long)PRODUCERS * (((long)ITEMS * (ITEMS + 1)) / 2));
+  assert_true(percpu_queue_empty(queue));
+
+  percpu_queue_destroy(queue);
+}
+
+static void percpu_queue_threads_test(void unused **state)
+{
+  run_threads(true);
+  run_threads(false);
+}
+
+int main(void)
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(percpu_queue_new_test),
+    cmocka_unit_test(percpu_queue_dequeue_test),
+    cmocka_unit_test(percpu_queue_threads_test),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
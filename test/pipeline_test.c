@@ -0,0 +1,156 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+
+#include <cmocka/cmocka.h>
+
+#include "pipeline.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef unused
+#define unused __attribute__ ((unused))
+#endif/*unused*/
+
+#define ITEMS 200000
+
+struct record
+{
+  long value;
+  long square;
+};
+
+static atomic_long next;
+static atomic_long total;
+static long sunk;
+static long count;
+
+static enum pipeline_result produce(void unused *ctx, const void unused *in, void *out)
+{
+  const long value = atomic_fetch_add(&next, 1);
+
+  if (value >= ITEMS)
+  {
+    return PIPELINE_DONE;
+  }
+
+  *(long *)out = value;
+  return PIPELINE_EMIT;
+}
+
+static enum pipeline_result parse(void unused *ctx, const void *in, void *out)
+{
+  const long value = *(const long *)in;
+
+  if (value % 3 == 0)
+  {
+    return PIPELINE_DROP;
+  }
+
+  ((struct record *)out)->value = value;
+  ((struct record *)out)->square = value * value;
+  return PIPELINE_EMIT;
+}
+
+static enum pipeline_result enrich(void unused *ctx, const void *in, void *out)
+{
+  const struct record *record = (const struct record *)in;
+
+  atomic_fetch_add(&total, record->value);
+  *(long *)out = record->square - (record->value * record->value) + record->value;
+  return PIPELINE_EMIT;
+}
+
+static enum pipeline_result sink(void unused *ctx, const void *in, void unused *out)
+{
+  sunk += *(const long *)in;
+  count++;
+  return PIPELINE_EMIT;
+}
+
+static void pipeline_add_test(void unused **state)
+{
+  pipeline_t *target = pipeline_new(64);
+
+  assert_non_null(target);
+
+  // A pipeline needs a source and a sink.
+  assert_true(pipeline_add(target, "source", &produce, NULL, 1, sizeof(long), PIPELINE_BIPARTITE));
+  assert_false(pipeline_start(target));
+  assert_false(pipeline_add(target, "bad", &sink, NULL, 0, 0, PIPELINE_BIPARTITE));
+
+  // An SPSC ring may not feed several threads.
+  assert_true(pipeline_add(target, "parse", &parse, NULL, 2, sizeof(struct record), PIPELINE_SPSC));
+  assert_true(pipeline_add(target, "sink", &sink, NULL, 1, 0, PIPELINE_BIPARTITE));
+  assert_false(pipeline_start(target));
+
+  pipeline_destroy(target);
+  assert_null(target);
+}
+
+static void pipeline_run_test(void unused **state)
+{
+  pipeline_t *target = pipeline_new(256);
+  pipeline_stats_t stats;
+  long expected = 0;
+  long kept = 0;
+  long i;
+
+  atomic_init(&next, 0);
+  atomic_init(&total, 0);
+  sunk = 0;
+  count = 0;
+
+  assert_true(pipeline_add(target, "source", &produce, NULL, 2, sizeof(long), PIPELINE_BIPARTITE));
+  assert_true(pipeline_add(target, "parse", &parse, NULL, 3, sizeof(struct record), PIPELINE_BIPARTITE));
+  assert_true(pipeline_add(target, "enrich", &enrich, NULL, 1, sizeof(long), PIPELINE_SPSC));
+  assert_true(pipeline_add(target, "sink", &sink, NULL, 1, 0, PIPELINE_BIPARTITE));
+
+  assert_true(pipeline_start(target));
+  assert_false(pipeline_start(target));
+  pipeline_wait(target);
+
+  for (i = 0; i < ITEMS; i++)
+  {
+    if (i % 3 != 0)
+    {
+      expected += i;
+      kept++;
+    }
+  }
+
+  assert_int_equal(count, kept);
+  assert_int_equal(sunk, expected);
+  assert_int_equal(atomic_load(&total), expected);
+
+  assert_true(pipeline_stats(target, 0, &stats));
+  assert_int_equal(stats.out, ITEMS);
+  assert_true(stats.batches >= (ITEMS / 32));
+
+  assert_true(pipeline_stats(target, 1, &stats));
+  assert_int_equal(stats.in, ITEMS);
+  assert_int_equal(stats.out, kept);
+
+  assert_true(pipeline_stats(target, 3, &stats));
+  assert_int_equal(stats.in, kept);
+  assert_int_equal(stats.backlog, 0);
+  assert_true(stats.elapsed_ns > 0);
+  assert_true(stats.rate > 0.0);
+
+  assert_false(pipeline_stats(target, 4, &stats));
+
+  pipeline_destroy(target);
+}
+
+int main(void)
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(pipeline_add_test),
+    cmocka_unit_test(pipeline_run_test),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,123 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+
+#include <cmocka/cmocka.h>
+
+#include "pool.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef unused
+#define unused __attribute__ ((unused))
+#endif/*unused*/
+
+#define DEPTH 14
+#define FLAT  50000
+
+static pool_t *pool = NULL;
+static atomic_ulong leaves;
+static atomic_ulong sum;
+
+static void leaf(void *arg)
+{
+  atomic_fetch_add(&sum, (uintptr_t)arg);
+}
+
+static void node(void *arg)
+{
+  const uintptr_t depth = (uintptr_t)arg;
+
+  if (depth == 0)
+  {
+    atomic_fetch_add(&leaves, 1UL);
+    return;
+  }
+
+  pool_submit(pool, &node, (void *)(depth - 1));
+  pool_submit(pool, &node, (void *)(depth - 1));
+}
+
+static void run_tree(const enum pool_kind kind, const unsigned threads, const size_t cap)
+{
+  struct pool_stats stats;
+  int round;
+
+  pool = pool_new(threads, kind, cap);
+  assert_non_null(pool);
+
+  for (round = 0; round < 3; round++)
+  {
+    atomic_store(&leaves, 0UL);
+    pool_submit(pool, &node, (void *)(uintptr_t)DEPTH);
+    pool_wait(pool);
+    assert_int_equal(atomic_load(&leaves), 1UL << DEPTH);
+  }
+
+  pool_stats(pool, &stats);
+  assert_int_equal(stats.executed, 3 * ((2UL << DEPTH) - 1));
+
+  if (kind == POOL_SHARED)
+  {
+    assert_int_equal(stats.stolen, 0);
+  }
+
+  pool_destroy(pool);
+  assert_null(pool);
+}
+
+static void pool_stealing_test(void unused **state)
+{
+  run_tree(POOL_STEALING, 4, 1024);
+  run_tree(POOL_STEALING, 1, 1);
+}
+
+static void pool_shared_test(void unused **state)
+{
+  // A tiny injector makes the workers run their own submissions inline.
+  run_tree(POOL_SHARED, 4, 1024);
+  run_tree(POOL_SHARED, 3, 4);
+}
+
+static void pool_flat_test(void unused **state)
+{
+  const enum pool_kind kinds[] = { POOL_STEALING, POOL_SHARED };
+  struct pool_stats stats;
+  uintptr_t i;
+  size_t k;
+
+  for (k = 0; k < 2; k++)
+  {
+    atomic_store(&sum, 0UL);
+    pool = pool_new(3, kinds[k], 64);
+
+    // The main thread outruns the injector and waits for room.
+    for (i = 1; i <= FLAT; i++)
+    {
+      pool_submit(pool, &leaf, (void *)i);
+    }
+
+    pool_wait(pool);
+    assert_int_equal(atomic_load(&sum), ((unsigned long)FLAT * (FLAT + 1)) / 2);
+
+    pool_stats(pool, &stats);
+    assert_int_equal(stats.executed, FLAT);
+
+    pool_destroy(pool);
+  }
+}
+
+int main(void)
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(pool_stealing_test),
+    cmocka_unit_test(pool_shared_test),
+    cmocka_unit_test(pool_flat_test),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
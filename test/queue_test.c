@@ -27,6 +27,52 @@ static void queue_new_test(void unused **state)
   assert_null(queue);
 }
 
+static void queue_new_lazy_test(void unused **state)
+{
+  const size_t cap = 1024 * 1024 * 1024;
+  queue_t *queue = NULL;
+
+  queue = queue_new_lazy(cap, sizeof(int));
+  assert_non_null(queue);
+  assert_true(queue->mapped);
+
+  assert_true(queue_empty(queue));
+  assert_true(queue_enqueue(queue, &(int){1}));
+
+  const int *item = queue_dequeue(queue);
+  assert_non_null(item);
+  assert_int_equal(*item, 1);
+  free((void *)item);
+  item = NULL;
+
+  queue_destroy(queue);
+  assert_null(queue);
+}
+
+static void queue_init_test(void unused **state)
+{
+  static uint8_t buffer[10];
+  queue_t queue;
+
+  queue_init(&queue, buffer, sizeof(buffer), sizeof(int));
+  assert_ptr_equal(queue.data, buffer);
+  assert_true(queue_empty(&queue));
+
+  assert_true(queue_enqueue(&queue, &(int){1}));
+  int x = 0;
+  memcpy(&x, buffer, sizeof(int));
+  assert_int_equal(x, 1);
+
+  const int *item = queue_dequeue(&queue);
+  assert_non_null(item);
+  assert_int_equal(*item, 1);
+  free((void *)item);
+  item = NULL;
+
+  queue_fini(&queue);
+  assert_null(queue.data);
+}
+
 static void queue_enqueue_test(void unused **state)
 {
   const size_t cap = 10;
@@ -114,6 +160,153 @@ static void queue_empty_test(void unused **state)
   assert_null(queue);
 }
 
+static void queue_dequeue_batch_test(void unused **state)
+{
+  const size_t cap = 8 * sizeof(int);
+  queue_t *queue = NULL;
+  int items[8] = { 0 };
+  int next = 0;
+  int expected = 0;
+  int i;
+
+  queue = queue_new(cap, sizeof(int));
+  assert_non_null(queue);
+
+  queue_set_prefetch(queue, 2);
+  assert_int_equal(queue_dequeue_batch(queue, items, 8), 0);
+
+  // Fill, drain part of the front and refill so that items wrap into
+  // region B, then drain everything in batches across the wrap.
+  for (i = 0; i < 8; i++, next++)
+  {
+    assert_true(queue_enqueue(queue, &next));
+  }
+
+  assert_int_equal(queue_dequeue_batch(queue, items, 5), 5);
+  for (i = 0; i < 5; i++, expected++)
+  {
+    assert_int_equal(items[i], expected);
+  }
+
+  for (i = 0; i < 5; i++, next++)
+  {
+    assert_true(queue_enqueue(queue, &next));
+  }
+
+  while (expected < next)
+  {
+    const size_t n = queue_dequeue_batch(queue, items, 3);
+    assert_true(n > 0);
+
+    for (i = 0; i < (int)n; i++, expected++)
+    {
+      assert_int_equal(items[i], expected);
+    }
+  }
+
+  assert_true(queue_empty(queue));
+  assert_int_equal(queue_dequeue_batch(queue, items, 8), 0);
+
+  queue_destroy(queue);
+  assert_null(queue);
+}
+
+static void queue_trim_test(void unused **state)
+{
+  const size_t cap = 64 * 4096;
+  const size_t len = 4096;
+  queue_t *queue = NULL;
+  int i;
+
+  queue = queue_new(cap, len);
+  assert_non_null(queue);
+
+  uint8_t *page = calloc(1, len);
+
+  for (i = 0; i < 64; i++)
+  {
+    assert_true(queue_enqueue(queue, page));
+  }
+
+  // Drain half of the Queue so that the front of the buffer is idle.
+  for (i = 0; i < 32; i++)
+  {
+    free(queue_dequeue(queue));
+  }
+
+  assert_true(queue_trim(queue) >= 31 * len);
+  assert_int_equal(queue_size(queue), 32 * len);
+
+  free(page);
+  queue_destroy(queue);
+  assert_null(queue);
+}
+
+static void queue_trim_policy_test(void unused **state)
+{
+  const size_t cap = 16 * sizeof(int);
+  queue_t *queue = NULL;
+  int i;
+
+  queue = queue_new(cap, sizeof(int));
+  assert_non_null(queue);
+
+  queue_set_trim_policy(queue, sizeof(int), 2);
+
+  for (i = 0; i < 4; i++)
+  {
+    assert_true(queue_enqueue(queue, &i));
+  }
+
+  free(queue_dequeue(queue));
+  assert_true(queue->trim.armed);
+
+  free(queue_dequeue(queue));
+  free(queue_dequeue(queue));
+  assert_true(queue->trim.armed);
+
+  // The second consecutive dequeue at or below the watermark fires it.
+  int *item = queue_dequeue(queue);
+  assert_non_null(item);
+  assert_int_equal(*item, 3);
+  free(item);
+  assert_false(queue->trim.armed);
+
+  queue_destroy(queue);
+  assert_null(queue);
+}
+
+static void queue_metrics_test(void unused **state)
+{
+  const size_t cap = 2 * sizeof(int);
+  metrics_snapshot_t snapshot;
+  queue_t *queue = NULL;
+
+  queue = queue_new(cap, sizeof(int));
+  assert_non_null(queue);
+
+  assert_true(queue_enqueue(queue, &(int){1}));
+  assert_true(queue_enqueue(queue, &(int){2}));
+  assert_false(queue_enqueue(queue, &(int){3}));
+  free(queue_dequeue(queue));
+
+  // Metrics are only collected when the library is built with them.
+  if (queue_metrics(queue, &snapshot))
+  {
+    assert_int_equal(snapshot.enqueued, 2);
+    assert_int_equal(snapshot.dequeued, 1);
+    assert_int_equal(snapshot.full, 1);
+    assert_int_equal(snapshot.high_water, cap);
+  }
+  else
+  {
+    assert_int_equal(snapshot.enqueued, 0);
+  }
+
+  queue_destroy(queue);
+  assert_null(queue);
+}
+
 queue_t *target = NULL;
 
 void *proca(void *arg)
@@ -196,11 +389,17 @@ int main(void)
 {
   const struct CMUnitTest tests[] = {
     cmocka_unit_test(queue_new_test),
+    cmocka_unit_test(queue_new_lazy_test),
+    cmocka_unit_test(queue_init_test),
     cmocka_unit_test(queue_enqueue_test),
     cmocka_unit_test(queue_dequeue_test),
     cmocka_unit_test(queue_peek_test),
     cmocka_unit_test(queue_size_test),
     cmocka_unit_test(queue_empty_test),
+    cmocka_unit_test(queue_dequeue_batch_test),
+    cmocka_unit_test(queue_trim_test),
+    cmocka_unit_test(queue_trim_policy_test),
+    cmocka_unit_test(queue_metrics_test),
     cmocka_unit_test(queue_thread_safety_test),
   };
 
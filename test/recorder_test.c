@@ -0,0 +1,183 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+
+#include <cmocka/cmocka.h>
+
+#include "bipartite.h"
+#include "bipbuf.h"
+#include "queue.h"
+#include "recorder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifndef unused
+#define unused __attribute__ ((unused))
+#endif/*unused*/
+
+static void recorder_new_test(void unused **state)
+{
+  recorder_t *recorder = NULL;
+  size_t count = 0;
+
+  assert_null(recorder_new("/nonexistent/directory/trace.rec"));
+  assert_null(recorder_load("/nonexistent/directory/trace.rec", &count));
+
+  char path[] = "/tmp/recorder_test_XXXXXX";
+  close(mkstemp(path));
+
+  recorder = recorder_new(path);
+  assert_non_null(recorder);
+
+  recorder_destroy(recorder);
+  assert_null(recorder);
+
+  struct recorder_event *events = recorder_load(path, &count);
+  assert_non_null(events);
+  assert_int_equal(count, 0);
+  recorder_events_free(events);
+
+  // A file without the header is not a recording.
+  FILE *fp = fopen(path, "wb");
+  fputs("not a recording", fp);
+  fclose(fp);
+
+  assert_null(recorder_load(path, &count));
+  unlink(path);
+}
+
+static void recorder_queue_test(void unused **state)
+{
+  const size_t cap = 2 * sizeof(int);
+  recorder_t *recorder = NULL;
+  queue_t *queue = NULL;
+  size_t count = 0;
+
+  char path[] = "/tmp/recorder_test_XXXXXX";
+  close(mkstemp(path));
+
+  recorder = recorder_new(path);
+  queue = queue_new(cap, sizeof(int));
+  queue_set_recorder(queue, recorder);
+
+  assert_true(queue_enqueue(queue, &(int){1}));
+  assert_true(queue_enqueue(queue, &(int){2}));
+  assert_false(queue_enqueue(queue, &(int){3}));
+  free(queue_dequeue(queue));
+
+  queue_set_recorder(queue, NULL);
+  free(queue_dequeue(queue));
+
+  queue_destroy(queue);
+  recorder_destroy(recorder);
+
+  struct recorder_event *events = recorder_load(path, &count);
+  assert_non_null(events);
+  assert_int_equal(count, 4);
+
+  assert_int_equal(events[0].op, RECORDER_ENQUEUE);
+  assert_int_equal(events[1].op, RECORDER_ENQUEUE);
+  assert_int_equal(events[2].op, RECORDER_FULL);
+  assert_int_equal(events[3].op, RECORDER_DEQUEUE);
+
+  size_t i;
+  for (i = 0; i < count; i++)
+  {
+    assert_int_equal(events[i].size, sizeof(int));
+    assert_true(i == 0 || events[i].time >= events[i - 1].time);
+  }
+
+  recorder_events_free(events);
+  unlink(path);
+}
+
+static void recorder_bipbuf_test(void unused **state)
+{
+  recorder_t *recorder = NULL;
+  bipbuf_t *bipbuf = NULL;
+  size_t count = 0;
+  size_t i;
+
+  char path[] = "/tmp/recorder_test_XXXXXX";
+  close(mkstemp(path));
+
+  recorder = recorder_new(path);
+  bipbuf = bipbuf_new(1024 * 1024);
+  bipbuf_set_recorder(bipbuf, recorder);
+
+  // Enough events to flush the recorder buffer more than once, with sizes
+  // that need multi-byte varints.
+  for (i = 0; i < 50000; i++)
+  {
+    const size_t size = 1 + (i % 300);
+    uint8_t item[300] = { 0 };
+
+    assert_true(bipbuf_offer(bipbuf, item, size));
+    free(bipbuf_poll(bipbuf, size));
+  }
+
+  bipbuf_destroy(bipbuf);
+  recorder_destroy(recorder);
+
+  struct recorder_event *events = recorder_load(path, &count);
+  assert_non_null(events);
+  assert_int_equal(count, 100000);
+
+  for (i = 0; i < count; i++)
+  {
+    assert_int_equal(events[i].op, ((i % 2) == 0) ? RECORDER_ENQUEUE : RECORDER_DEQUEUE);
+    assert_int_equal(events[i].size, 1 + ((i / 2) % 300));
+  }
+
+  recorder_events_free(events);
+  unlink(path);
+}
+
+static void recorder_bipartite_test(void unused **state)
+{
+  recorder_t *recorder = NULL;
+  bipartite_queue_t *queue = NULL;
+  size_t count = 0;
+
+  char path[] = "/tmp/recorder_test_XXXXXX";
+  close(mkstemp(path));
+
+  recorder = recorder_new(path);
+  queue = bipartite_queue_new(sizeof(long), sizeof(long));
+  bipartite_queue_set_recorder(queue, recorder);
+
+  assert_true(bipartite_queue_enqueue(queue, &(long){1}));
+  assert_false(bipartite_queue_enqueue(queue, &(long){2}));
+  free(bipartite_queue_dequeue(queue));
+  assert_null(bipartite_queue_dequeue(queue));
+
+  bipartite_queue_set_recorder(queue, NULL);
+  bipartite_queue_destroy(queue);
+  recorder_destroy(recorder);
+
+  struct recorder_event *events = recorder_load(path, &count);
+  assert_non_null(events);
+  assert_int_equal(count, 3);
+
+  assert_int_equal(events[0].op, RECORDER_ENQUEUE);
+  assert_int_equal(events[1].op, RECORDER_FULL);
+  assert_int_equal(events[2].op, RECORDER_DEQUEUE);
+
+  recorder_events_free(events);
+  unlink(path);
+}
+
+int main(void)
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(recorder_new_test),
+    cmocka_unit_test(recorder_queue_test),
+    cmocka_unit_test(recorder_bipbuf_test),
+    cmocka_unit_test(recorder_bipartite_test),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,256 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+
+#include <cmocka/cmocka.h>
+
+#include "segqueue.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef unused
+#define unused __attribute__ ((unused))
+#endif/*unused*/
+
+static void seg_queue_new_test(void unused **state)
+{
+  const size_t cap = 4 * sizeof(int);
+  seg_queue_t *queue = NULL;
+
+  queue = seg_queue_new(cap, sizeof(int));
+  assert_non_null(queue);
+  assert_non_null(queue->head);
+  assert_ptr_equal(queue->head, queue->tail);
+
+  seg_queue_destroy(queue);
+  assert_null(queue);
+}
+
+static void seg_queue_enqueue_test(void unused **state)
+{
+  const size_t cap = 4 * sizeof(int);
+  seg_queue_t *queue = NULL;
+
+  queue = seg_queue_new(cap, sizeof(int));
+  assert_non_null(queue);
+
+  assert_true(seg_queue_enqueue(queue, &(int){1}));
+  int x = 0;
+  memcpy(&x, queue->head->data, sizeof(int));
+  assert_int_equal(x, 1);
+
+  seg_queue_destroy(queue);
+  assert_null(queue);
+}
+
+static void seg_queue_dequeue_test(void unused **state)
+{
+  const size_t cap = 4 * sizeof(int);
+  seg_queue_t *queue = NULL;
+
+  queue = seg_queue_new(cap, sizeof(int));
+  assert_non_null(queue);
+
+  assert_null(seg_queue_dequeue(queue));
+
+  assert_true(seg_queue_enqueue(queue, &(int){1}));
+  const int *item = seg_queue_dequeue(queue);
+  assert_non_null(item);
+  assert_int_equal(*item, 1);
+  free((void *)item);
+  item = NULL;
+
+  seg_queue_destroy(queue);
+  assert_null(queue);
+}
+
+static void seg_queue_peek_test(void unused **state)
+{
+  const size_t cap = 4 * sizeof(int);
+  seg_queue_t *queue = NULL;
+
+  queue = seg_queue_new(cap, sizeof(int));
+  assert_non_null(queue);
+
+  assert_true(seg_queue_enqueue(queue, &(int){1}));
+  const int *item = seg_queue_peek(queue);
+  assert_non_null(item);
+  assert_int_equal(*item, 1);
+  free((void *)item);
+  item = NULL;
+
+  assert_int_equal(seg_queue_size(queue), sizeof(int));
+
+  seg_queue_destroy(queue);
+  assert_null(queue);
+}
+
+static void seg_queue_size_test(void unused **state)
+{
+  const size_t cap = 4 * sizeof(int);
+  seg_queue_t *queue = NULL;
+
+  queue = seg_queue_new(cap, sizeof(int));
+  assert_non_null(queue);
+
+  assert_true(seg_queue_enqueue(queue, &(int){1}));
+  assert_int_equal(seg_queue_size(queue), sizeof(int));
+
+  seg_queue_destroy(queue);
+  assert_null(queue);
+}
+
+static void seg_queue_empty_test(void unused **state)
+{
+  const size_t cap = 4 * sizeof(int);
+  seg_queue_t *queue = NULL;
+
+  queue = seg_queue_new(cap, sizeof(int));
+  assert_non_null(queue);
+
+  assert_true(seg_queue_empty(queue));
+
+  assert_true(seg_queue_enqueue(queue, &(int){1}));
+  assert_false(seg_queue_empty(queue));
+
+  seg_queue_destroy(queue);
+  assert_null(queue);
+}
+
+static void seg_queue_growth_test(void unused **state)
+{
+  const size_t cap = 4 * sizeof(int);
+  seg_queue_t *queue = NULL;
+  int i;
+
+  queue = seg_queue_new(cap, sizeof(int));
+  assert_non_null(queue);
+
+  // Ten items do not fit in one four item segment, so the Queue must grow.
+  for (i = 0; i < 10; i++)
+  {
+    assert_true(seg_queue_enqueue(queue, &i));
+  }
+  assert_true(queue->head != queue->tail);
+  assert_int_equal(seg_queue_size(queue), 10 * sizeof(int));
+
+  for (i = 0; i < 10; i++)
+  {
+    int *item = seg_queue_dequeue(queue);
+    assert_non_null(item);
+    assert_int_equal(*item, i);
+    free(item);
+  }
+  assert_true(seg_queue_empty(queue));
+
+  // The two segments drained ahead of the tail are kept for reuse.
+  assert_int_equal(queue->nspare, 2);
+
+  for (i = 0; i < 8; i++)
+  {
+    assert_true(seg_queue_enqueue(queue, &i));
+  }
+  assert_int_equal(queue->nspare, 1);
+
+  seg_queue_set_spare(queue, 0);
+  assert_null(queue->spare);
+
+  seg_queue_destroy(queue);
+  assert_null(queue);
+}
+
+static seg_queue_t *target = NULL;
+
+static void *proca(void *arg)
+{
+  int i;
+
+  for (i = 0; i < 5000000; i++)
+  {
+    if (false == seg_queue_enqueue(target, &(int){1}))
+    {
+      fprintf(stderr, "%s(): %s\n", __func__, "could not enqueue value");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  return NULL;
+}
+
+static unsigned long suma = 0;
+static unsigned long sumb = 0;
+
+static void *procb(void *arg)
+{
+  int *item = NULL;
+
+  while (NULL != (item = seg_queue_dequeue(target)))
+  {
+    suma += *item;
+    free(item);
+  }
+
+  return NULL;
+}
+
+static void *procc(void *arg)
+{
+  int *item = NULL;
+
+  while (NULL != (item = seg_queue_dequeue(target)))
+  {
+    sumb += *item;
+    free(item);
+  }
+
+  return NULL;
+}
+
+static void seg_queue_thread_safety_test(void unused **state)
+{
+  // A deliberately small segment so that the producers grow the Queue
+  // through many segments.
+  const size_t cap = 4096;
+
+  pthread_t t1;
+  pthread_t t2;
+  pthread_t t3;
+  pthread_t t4;
+
+  target = seg_queue_new(cap, sizeof(int));
+
+  assert_true(pthread_create(&t1, NULL, &proca, NULL) == 0);
+  assert_true(pthread_create(&t2, NULL, &proca, NULL) == 0);
+
+  assert_true(pthread_join(t1, NULL) == 0);
+  assert_true(pthread_join(t2, NULL) == 0);
+
+  assert_true(pthread_create(&t3, NULL, &procb, NULL) == 0);
+  assert_true(pthread_create(&t4, NULL, &procc, NULL) == 0);
+
+  assert_true(pthread_join(t3, NULL) == 0);
+  assert_true(pthread_join(t4, NULL) == 0);
+
+  seg_queue_destroy(target);
+
+  assert_int_equal((suma + sumb), 10000000);
+}
+
+int main(void)
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(seg_queue_new_test),
+    cmocka_unit_test(seg_queue_enqueue_test),
+    cmocka_unit_test(seg_queue_dequeue_test),
+    cmocka_unit_test(seg_queue_peek_test),
+    cmocka_unit_test(seg_queue_size_test),
+    cmocka_unit_test(seg_queue_empty_test),
+    cmocka_unit_test(seg_queue_growth_test),
+    cmocka_unit_test(seg_queue_thread_safety_test),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
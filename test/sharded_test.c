@@ -0,0 +1,225 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+
+#include <cmocka/cmocka.h>
+
+#include "sharded.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef unused
+#define unused __attribute__ ((unused))
+#endif/*unused*/
+
+#define PRODUCERS 4
+#define CONSUMERS 2
+#define ITEMS     100000
+
+static sharded_queue_t *queue = NULL;
+static atomic_long consumed;
+static atomic_long total;
+
+static void *produce_lane(void *arg)
+{
+  const int value = *(int *)arg;
+
+  assert_true(sharded_queue_enqueue(queue, &value));
+  return NULL;
+}
+
+static void *consume_lane(void *arg)
+{
+  int items[4];
+
+  assert_int_equal(sharded_queue_dequeue_batch((sharded_queue_t *)arg, items, 4), 0);
+  return NULL;
+}
+
+static void sharded_queue_lanes_test(void unused **state)
+{
+  sharded_queue_t *other = sharded_queue_new_lanes(4 * sizeof(int), sizeof(int), 2);
+  pthread_t thread;
+  int value;
+  size_t i;
+
+  queue = sharded_queue_new_lanes(4 * sizeof(int), sizeof(int), 2);
+
+  // Consumers of this queue and of another one start between the
+  // producers; each producer still gets a lane of its own.
+  for (i = 0; i < 2; i++)
+  {
+    assert_int_equal(pthread_create(&thread, NULL, &consume_lane, (i == 0) ? queue : other), 0);
+    pthread_join(thread, NULL);
+
+    value = (int)i;
+    assert_int_equal(pthread_create(&thread, NULL, &produce_lane, &value), 0);
+    pthread_join(thread, NULL);
+  }
+
+  for (i = 0; i < 2; i++)
+  {
+    assert_int_equal(spsc_queue_size(queue->lane[i].ring), sizeof(int));
+  }
+
+  sharded_queue_destroy(other);
+  sharded_queue_destroy(queue);
+}
+
+static void sharded_queue_new_test(void unused **state)
+{
+  sharded_queue_t *target = sharded_queue_new_lanes(8 * sizeof(int), sizeof(int), 4);
+
+  assert_non_null(target);
+  assert_int_equal(target->lanes, 4);
+  assert_int_equal(target->lane[0].ring->slots, 2);
+  assert_int_equal(((uintptr_t)&target->lane[0].consuming - (uintptr_t)&target->lane[0].producing) % 64, 0);
+  assert_true(sharded_queue_empty(target));
+
+  sharded_queue_destroy(target);
+  assert_null(target);
+
+  // The default never gives a lane less than one item.
+  target = sharded_queue_new(sizeof(int), sizeof(int));
+  assert_int_equal(target->lanes, 1);
+  sharded_queue_destroy(target);
+}
+
+static void sharded_queue_dequeue_test(void unused **state)
+{
+  int items[8];
+  int value;
+  int i;
+
+  queue = sharded_queue_new_lanes(4 * sizeof(int), sizeof(int), 2);
+
+  assert_null(sharded_queue_dequeue(queue));
+
+  // The lane of this thread holds two items; the third does not fit even
+  // though the other lane is empty.
+  for (i = 0; i < 2; i++)
+  {
+    assert_true(sharded_queue_enqueue(queue, &i));
+  }
+
+  assert_false(sharded_queue_enqueue(queue, &i));
+  assert_int_equal(sharded_queue_size(queue), 2 * sizeof(int));
+
+  // A second thread lands on the other lane.
+  value = 7;
+  pthread_t thread;
+  assert_int_equal(pthread_create(&thread, NULL, &produce_lane, &value), 0);
+  pthread_join(thread, NULL);
+  assert_int_equal(sharded_queue_size(queue), 3 * sizeof(int));
+
+  // Items of one lane come out in order and the sweep reaches both lanes.
+  assert_int_equal(sharded_queue_dequeue_batch(queue, items, 8), 3);
+  assert_true((items[0] == 0 && items[1] == 1 && items[2] == 7) || (items[0] == 7 && items[1] == 0 && items[2] == 1));
+  assert_true(sharded_queue_empty(queue));
+
+  for (i = 0; i < 2; i++)
+  {
+    assert_int_equal(sharded_queue_enqueue_batch(queue, (int []){ 10, 11, 12 }, 3), 2);
+
+    int *item = sharded_queue_dequeue(queue);
+    assert_non_null(item);
+    assert_int_equal(*item, 10);
+    free(item);
+
+    assert_int_equal(sharded_queue_dequeue_batch(queue, items, 8), 1);
+    assert_int_equal(items[0], 11);
+  }
+
+  sharded_queue_destroy(queue);
+}
+
+static void *producer(void unused *arg)
+{
+  long i;
+
+  for (i = 1; i <= ITEMS; i++)
+  {
+    while (false == sharded_queue_enqueue(queue, &i))
+    {
+      sched_yield();
+    }
+  }
+
+  return NULL;
+}
+
+static void *consumer(void unused *arg)
+{
+  long items[16];
+
+  while (atomic_load(&consumed) < ((long)PRODUCERS * ITEMS))
+  {
+    const size_t n = sharded_queue_dequeue_batch(queue, items, 16);
+    size_t i;
+
+    if (n == 0)
+    {
+      sched_yield();
+      continue;
+    }
+
+    for (i = 0; i < n; i++)
+    {
+      atomic_fetch_add(&total, items[i]);
+    }
+
+    atomic_fetch_add(&consumed, (long)n);
+  }
+
+  return NULL;
+}
+
+static void sharded_queue_threads_test(void unused **state)
+{
+  pthread_t threads[PRODUCERS + CONSUMERS];
+  int i;
+
+  // Fewer lanes than producers, so that two producers share every lane.
+  queue = sharded_queue_new_lanes(1024 * sizeof(long), sizeof(long), 2);
+  atomic_init(&consumed, 0);
+  atomic_init(&total, 0);
+
+  for (i = 0; i < PRODUCERS; i++)
+  {
+    assert_int_equal(pthread_create(&threads[i], NULL, &producer, NULL), 0);
+  }
+
+  for (i = 0; i < CONSUMERS; i++)
+  {
+    assert_int_equal(pthread_create(&threads[PRODUCERS + i], NULL, &consumer, NULL), 0);
+  }
+
+  for (i = 0; i < (PRODUCERS + CONSUMERS); i++)
+  {
+    pthread_join(threads[i], NULL);
+  }
+
+  assert_int_equal(atomic_load(&consumed), (long)PRODUCERS * ITEMS);
+  assert_int_equal(atomic_load(&total), (long)PRODUCERS * (((long)ITEMS * (ITEMS + 1)) / 2));
+  assert_true(sharded_queue_empty(queue));
+
+  sharded_queue_destroy(queue);
+}
+
+int main(void)
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(sharded_queue_new_test),
+    cmocka_unit_test(sharded_queue_dequeue_test),
+    cmocka_unit_test(sharded_queue_lanes_test),
+    cmocka_unit_test(sharded_queue_threads_test),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,130 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+
+#include <cmocka/cmocka.h>
+
+#include "spsc.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef unused
+#define unused __attribute__ ((unused))
+#endif/*unused*/
+
+static void spsc_queue_new_test(void unused **state)
+{
+  const size_t cap = 4 * sizeof(int);
+  spsc_queue_t *queue = NULL;
+
+  queue = spsc_queue_new(cap, sizeof(int));
+  assert_non_null(queue);
+  assert_int_equal(queue->slots, 4);
+  assert_int_equal(((uintptr_t)&queue->tail - (uintptr_t)&queue->head) % 64, 0);
+
+  spsc_queue_destroy(queue);
+  assert_null(queue);
+}
+
+static void spsc_queue_dequeue_test(void unused **state)
+{
+  const size_t cap = 4 * sizeof(int);
+  spsc_queue_t *queue = NULL;
+  int value = 0;
+  int i;
+
+  queue = spsc_queue_new(cap, sizeof(int));
+  assert_non_null(queue);
+
+  assert_null(spsc_queue_dequeue(queue));
+  assert_false(spsc_queue_pop(queue, &value));
+  assert_true(spsc_queue_empty(queue));
+
+  for (i = 0; i < 4; i++)
+  {
+    assert_true(spsc_queue_enqueue(queue, &i));
+  }
+
+  assert_false(spsc_queue_enqueue(queue, &i));
+  assert_int_equal(spsc_queue_size(queue), cap);
+
+  int *item = spsc_queue_dequeue(queue);
+  assert_non_null(item);
+  assert_int_equal(*item, 0);
+  free(item);
+
+  // The slot freed by the dequeue is reused across the wrap.
+  assert_true(spsc_queue_enqueue(queue, &(int){4}));
+
+  for (i = 1; i < 5; i++)
+  {
+    assert_true(spsc_queue_pop(queue, &value));
+    assert_int_equal(value, i);
+  }
+
+  assert_false(spsc_queue_pop(queue, &value));
+  assert_true(spsc_queue_empty(queue));
+
+  spsc_queue_destroy(queue);
+  assert_null(queue);
+}
+
+#define ITEMS 2000000UL
+
+static spsc_queue_t *target = NULL;
+
+static void *proca(void *arg)
+{
+  uint64_t i;
+
+  for (i = 0; i < ITEMS; i++)
+  {
+    while (false == spsc_queue_enqueue(target, &i));
+  }
+
+  return NULL;
+}
+
+static void spsc_queue_thread_safety_test(void unused **state)
+{
+  const size_t cap = 1024 * sizeof(uint64_t);
+  uint64_t expected = 0;
+  uint64_t item = 0;
+
+  pthread_t t1;
+
+  target = spsc_queue_new(cap, sizeof(uint64_t));
+
+  assert_true(pthread_create(&t1, NULL, &proca, NULL) == 0);
+
+  while (expected < ITEMS)
+  {
+    if (false == spsc_queue_pop(target, &item))
+    {
+      continue;
+    }
+
+    // Every item must arrive exactly once and in order.
+    assert_int_equal(item, expected);
+    expected++;
+  }
+
+  assert_true(pthread_join(t1, NULL) == 0);
+  assert_true(spsc_queue_empty(target));
+
+  spsc_queue_destroy(target);
+}
+
+int main(void)
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(spsc_queue_new_test),
+    cmocka_unit_test(spsc_queue_dequeue_test),
+    cmocka_unit_test(spsc_queue_thread_safety_test),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
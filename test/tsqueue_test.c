@@ -114,6 +114,80 @@ static void ts_queue_empty_test(void unused **state)
   assert_null(queue);
 }
 
+static void ts_queue_dequeue_int(ts_queue_t *queue, const int expected)
+{
+  int *item = ts_queue_dequeue(queue);
+
+  assert_non_null(item);
+  assert_int_equal(*item, expected);
+  free(item);
+}
+
+static void ts_queue_rewind_test(void unused **state)
+{
+  const size_t cap = 4 * sizeof(int);
+  ts_queue_t *queue = NULL;
+  int i;
+
+  queue = ts_queue_new(cap, sizeof(int));
+  assert_non_null(queue);
+
+  // Filled to capacity and drained, the Queue is empty and takes a full
+  // load again.
+  for (i = 0; i < 4; i++)
+  {
+    assert_true(ts_queue_enqueue(queue, &i));
+  }
+  assert_false(ts_queue_enqueue(queue, &i));
+
+  for (i = 0; i < 4; i++)
+  {
+    ts_queue_dequeue_int(queue, i);
+  }
+  assert_null(ts_queue_dequeue(queue));
+  assert_true(ts_queue_empty(queue));
+
+  for (i = 0; i < 4; i++)
+  {
+    assert_true(ts_queue_enqueue(queue, &i));
+  }
+  assert_false(ts_queue_enqueue(queue, &i));
+
+  // Freeing the front of region A puts region B in use: the next items go
+  // to the start of the buffer.
+  ts_queue_dequeue_int(queue, 0);
+  ts_queue_dequeue_int(queue, 1);
+  assert_true(atomic_load(&queue->b_inuse));
+
+  assert_true(ts_queue_enqueue(queue, &(int){4}));
+  assert_true(ts_queue_enqueue(queue, &(int){5}));
+  assert_false(ts_queue_enqueue(queue, &(int){6}));
+
+  // Draining region A makes region B the new region A, in order.
+  for (i = 2; i < 6; i++)
+  {
+    ts_queue_dequeue_int(queue, i);
+  }
+  assert_false(atomic_load(&queue->b_inuse));
+  assert_null(ts_queue_dequeue(queue));
+  assert_true(ts_queue_empty(queue));
+
+  for (i = 0; i < 4; i++)
+  {
+    assert_true(ts_queue_enqueue(queue, &i));
+  }
+  assert_false(ts_queue_enqueue(queue, &i));
+
+  for (i = 0; i < 4; i++)
+  {
+    ts_queue_dequeue_int(queue, i);
+  }
+  assert_true(ts_queue_empty(queue));
+
+  ts_queue_destroy(queue);
+  assert_null(queue);
+}
+
 static ts_queue_t *target = NULL;
 
 static void *proca(void *arg)
@@ -198,6 +272,7 @@ int main(void)
     cmocka_unit_test(ts_queue_peek_test),
     cmocka_unit_test(ts_queue_size_test),
     cmocka_unit_test(ts_queue_empty_test),
+    cmocka_unit_test(ts_queue_rewind_test),
     cmocka_unit_test(ts_queue_thread_safety_test),
   };
 
@@ -0,0 +1,126 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+
+#include <cmocka/cmocka.h>
+
+#include "bipbuf.h"
+#include "uring.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifndef unused
+#define unused __attribute__ ((unused))
+#endif/*unused*/
+
+#define TOTAL (1024 * 1024)
+#define BLOCK 3000
+
+static int temporary(void)
+{
+  char path[] = "/tmp/uring_test.XXXXXX";
+  const int fd = mkstemp(path);
+
+  assert_true(fd >= 0);
+  unlink(path);
+  return fd;
+}
+
+static void uring_sink_flush_test(void unused **state)
+{
+  bipbuf_t *buffer = bipbuf_new(64 * 1024);
+  uring_sink_t *sink = NULL;
+  uint8_t *in = malloc(TOTAL);
+  uint8_t *out = malloc(TOTAL);
+  size_t offered = 0;
+  size_t i;
+  const int fd = temporary();
+
+  for (i = 0; i < TOTAL; i++)
+  {
+    in[i] = (uint8_t)((i * 131) ^ (i >> 9));
+  }
+
+  if ((sink = uring_sink_new(buffer, fd, 0, 4)) == NULL)
+  {
+    close(fd);
+    bipbuf_destroy(buffer);
+    free(in);
+    free(out);
+    skip();
+  }
+
+  // Small writes, few in flight and a ring that wraps into region B.
+  uring_sink_set_chunk(sink, 5000);
+
+  while (offered < TOTAL)
+  {
+    const size_t n = ((TOTAL - offered) < BLOCK) ? (TOTAL - offered) : BLOCK;
+
+    if (true == bipbuf_offer(buffer, (in + offered), n))
+    {
+      offered += n;
+      assert_true(uring_sink_submit(sink, false) >= 0);
+    }
+    else
+    {
+      assert_true(uring_sink_submit(sink, true) >= 0);
+    }
+  }
+
+  assert_int_equal(uring_sink_flush(sink), 0);
+  assert_true(bipbuf_empty(buffer));
+  assert_int_equal(sink->outstanding, 0);
+
+  assert_int_equal(pread(fd, out, TOTAL, 0), TOTAL);
+  assert_memory_equal(in, out, TOTAL);
+
+  uring_sink_destroy(sink);
+  assert_null(sink);
+
+  close(fd);
+  bipbuf_destroy(buffer);
+  free(in);
+  free(out);
+}
+
+static void uring_sink_error_test(void unused **state)
+{
+  bipbuf_t *buffer = bipbuf_new(4096);
+  uring_sink_t *sink = NULL;
+  const int fd = open("/dev/null", O_RDONLY);
+
+  assert_true(fd >= 0);
+
+  if ((sink = uring_sink_new(buffer, fd, 0, 0)) == NULL)
+  {
+    close(fd);
+    bipbuf_destroy(buffer);
+    skip();
+  }
+
+  // A failed write is reported and its bytes stay in the buffer.
+  assert_true(bipbuf_offer(buffer, "abc", 3));
+  assert_int_equal(uring_sink_flush(sink), -1);
+  assert_int_equal(errno, EBADF);
+  assert_false(bipbuf_empty(buffer));
+
+  uring_sink_destroy(sink);
+  close(fd);
+  bipbuf_destroy(buffer);
+}
+
+int main(void)
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(uring_sink_flush_test),
+    cmocka_unit_test(uring_sink_error_test),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,208 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+
+#include <cmocka/cmocka.h>
+
+#include "bipartite.h"
+#include "waitset.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef unused
+#define unused __attribute__ ((unused))
+#endif/*unused*/
+
+#define QUEUES 100
+#define ITEMS  100000
+
+static bipartite_queue_t *queues[QUEUES];
+
+static void waitset_add_test(void unused **state)
+{
+  waitset_t *set = NULL;
+  bipartite_queue_t *a = bipartite_queue_new(4 * sizeof(int), sizeof(int));
+  bipartite_queue_t *b = bipartite_queue_new(4 * sizeof(int), sizeof(int));
+  bipartite_queue_t *ready[2] = { NULL };
+
+  set = waitset_new(1);
+  assert_non_null(set);
+
+  // An item enqueued before the Queue joined is reported.
+  assert_true(bipartite_queue_enqueue(a, &(int){1}));
+  assert_true(waitset_add(set, a));
+  assert_false(waitset_add(set, a));
+  assert_false(waitset_add(set, b));
+
+  assert_int_equal(waitset_wait(set, ready, 2, 0), 1);
+  assert_ptr_equal(ready[0], a);
+  assert_int_equal(waitset_wait(set, ready, 2, 0), 0);
+
+  // A removed Queue no longer signals, and frees its slot.
+  assert_true(waitset_remove(set, a));
+  assert_false(waitset_remove(set, a));
+  assert_true(bipartite_queue_enqueue(a, &(int){2}));
+  assert_int_equal(waitset_wait(set, ready, 2, 0), 0);
+  assert_true(waitset_add(set, b));
+
+  waitset_destroy(set);
+  assert_null(set);
+
+  bipartite_queue_destroy(a);
+  bipartite_queue_destroy(b);
+}
+
+static void waitset_destroy_test(void unused **state)
+{
+  waitset_t *set = waitset_new(1);
+  bipartite_queue_t *a = bipartite_queue_new(4 * sizeof(int), sizeof(int));
+  bipartite_queue_t *ready[1] = { NULL };
+  bipartite_queue_t b;
+  int buffer[4];
+
+  // A destroyed Queue leaves the set, ready bit and all.
+  assert_true(waitset_add(set, a));
+  assert_true(bipartite_queue_enqueue(a, &(int){1}));
+  bipartite_queue_destroy(a);
+  assert_int_equal(waitset_wait(set, ready, 1, 0), 0);
+
+  // So does a Queue torn down with bipartite_queue_fini().
+  bipartite_queue_init(&b, buffer, sizeof(buffer), sizeof(int));
+  assert_true(waitset_add(set, &b));
+  assert_true(bipartite_queue_enqueue(&b, &(int){2}));
+  bipartite_queue_fini(&b);
+  assert_int_equal(waitset_wait(set, ready, 1, 0), 0);
+
+  // A destroyed set lets go of its members, which go on working.
+  a = bipartite_queue_new(4 * sizeof(int), sizeof(int));
+  assert_true(waitset_add(set, a));
+  waitset_destroy(set);
+  assert_null(a->waitset);
+  assert_true(bipartite_queue_enqueue(a, &(int){3}));
+  bipartite_queue_destroy(a);
+}
+
+static void waitset_wait_test(void unused **state)
+{
+  waitset_t *set = NULL;
+  bipartite_queue_t *ready[QUEUES] = { NULL };
+  size_t i;
+
+  set = waitset_new(QUEUES);
+  assert_non_null(set);
+
+  for (i = 0; i < QUEUES; i++)
+  {
+    queues[i] = bipartite_queue_new(4 * sizeof(int), sizeof(int));
+    assert_true(waitset_add(set, queues[i]));
+  }
+
+  assert_int_equal(waitset_wait(set, ready, QUEUES, 0), 0);
+  assert_int_equal(waitset_wait(set, ready, QUEUES, 10), 0);
+
+  // Only the queues that turned ready are returned, once per wakeup.
+  assert_true(bipartite_queue_enqueue(queues[3], &(int){3}));
+  assert_true(bipartite_queue_enqueue(queues[3], &(int){3}));
+  assert_true(bipartite_queue_enqueue(queues[70], &(int){70}));
+  assert_true(bipartite_queue_enqueue(queues[99], &(int){99}));
+
+  assert_int_equal(waitset_wait(set, ready, QUEUES, -1), 3);
+  assert_ptr_equal(ready[0], queues[3]);
+  assert_ptr_equal(ready[1], queues[70]);
+  assert_ptr_equal(ready[2], queues[99]);
+  assert_int_equal(waitset_wait(set, ready, QUEUES, 0), 0);
+
+  // Members that do not fit stay ready for the next call.
+  assert_true(bipartite_queue_enqueue(queues[5], &(int){5}));
+  assert_true(bipartite_queue_enqueue(queues[6], &(int){6}));
+  assert_true(bipartite_queue_enqueue(queues[80], &(int){80}));
+
+  assert_int_equal(waitset_wait(set, ready, 2, 0), 2);
+  assert_int_equal(waitset_wait(set, ready, 2, 0), 1);
+  assert_int_equal(waitset_wait(set, ready, 2, 0), 0);
+
+  for (i = 0; i < QUEUES; i++)
+  {
+    assert_true(waitset_remove(set, queues[i]));
+    bipartite_queue_destroy(queues[i]);
+  }
+
+  waitset_destroy(set);
+}
+
+static void *producer(void unused *arg)
+{
+  int i;
+
+  for (i = 0; i < ITEMS; i++)
+  {
+    while (false == bipartite_queue_enqueue(queues[(i * 7) % QUEUES], &i))
+    {
+      sched_yield();
+    }
+  }
+
+  return NULL;
+}
+
+static void waitset_thread_safety_test(void unused **state)
+{
+  waitset_t *set = waitset_new(QUEUES);
+  bipartite_queue_t *ready[8] = { NULL };
+  pthread_t thread;
+  long sum = 0;
+  int count = 0;
+  size_t i;
+
+  for (i = 0; i < QUEUES; i++)
+  {
+    queues[i] = bipartite_queue_new(16 * sizeof(int), sizeof(int));
+    assert_true(waitset_add(set, queues[i]));
+  }
+
+  assert_true(pthread_create(&thread, NULL, &producer, NULL) == 0);
+
+  while (count < ITEMS)
+  {
+    const size_t n = waitset_wait(set, ready, 8, -1);
+
+    for (i = 0; i < n; i++)
+    {
+      int *item = NULL;
+
+      while ((item = bipartite_queue_dequeue(ready[i])) != NULL)
+      {
+        sum += *item;
+        count++;
+        free(item);
+      }
+    }
+  }
+
+  assert_true(pthread_join(thread, NULL) == 0);
+  assert_int_equal(sum, ((long)ITEMS * (ITEMS - 1)) / 2);
+
+  for (i = 0; i < QUEUES; i++)
+  {
+    waitset_remove(set, queues[i]);
+    bipartite_queue_destroy(queues[i]);
+  }
+
+  waitset_destroy(set);
+}
+
+int main(void)
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(waitset_add_test),
+    cmocka_unit_test(waitset_destroy_test),
+    cmocka_unit_test(waitset_wait_test),
+    cmocka_unit_test(waitset_thread_safety_test),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}